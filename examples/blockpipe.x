@@ -0,0 +1,67 @@
+| A three-stage pipeline that moves an array between processors as blocks
+| rather than one word at a time. The source fills [1..8] and sends it in one
+| block transfer; the doubler receives it, doubles each element and forwards it
+| as two four-word halves (with an empty block in between, which completes
+| without a rendezvous); the sink receives the halves, checks every element
+| and prints their sum, 72.
+
+val put = 1;
+val n = 8;
+array buf[n];
+
+proc putval(val c) is put(c, 0)
+
+proc source(chan out) is
+  var i;
+{ i := 0;
+  while i < n do
+  { buf[i] := i + 1;
+    i := i + 1
+  };
+  out ! buf[0] for n
+}
+
+proc doubler(chan in, chan out) is
+  var i;
+{ in ? buf[0] for n;
+  i := 0;
+  while i < n do
+  { buf[i] := buf[i] + buf[i];
+    i := i + 1
+  };
+  out ! buf[0] for 4;
+  out ! buf[4] for 0;
+  out ! buf[4] for 4
+}
+
+proc sink(chan in) is
+  var i;
+  var sum;
+  var tens;
+{ in ? buf[0] for 4;
+  in ? buf[4] for 0;
+  in ? buf[4] for 4;
+  i := 0;
+  sum := 0;
+  while i < n do
+  { if buf[i] ~= ((i + 1) + (i + 1)) then putval('!') else skip;
+    sum := sum + buf[i];
+    i := i + 1
+  };
+  tens := 0;
+  while sum >= 10 do
+  { sum := sum - 10;
+    tens := tens + 1
+  };
+  putval(tens + '0');
+  putval(sum + '0');
+  putval('\n')
+}
+
+proc main() is
+  chan a;
+  chan b;
+  par { source(a)
+      ; doubler(a, b)
+      ; sink(b)
+      }
@@ -0,0 +1,30 @@
+| printn.x using the extended OPR instructions: compile with xcmp --ext-opr |
+
+val put = 1;
+val get = 2;
+
+proc main() is
+  var n;
+{ n := get(0);
+  printn(n * n * n);
+  putval('\n');
+  printn(n << 20);
+  putval('\n')
+}
+
+proc putval(val c) is put(c, 0)
+
+proc printn(val n) is
+{ if n < 0
+  then
+  { putval('-');
+    printn(-n)
+  }
+  else
+  { if n > 9
+    then
+      printn(n / 10)
+    else skip;
+    putval((n - ((n / 10) * 10)) + '0')
+  }
+}
@@ -1,6 +1,7 @@
 
 val put            = 1;
 val get            = 2;
+val writes         = 3;
 ||
 val instream       = 0;
 val messagestream  = 0;
@@ -385,32 +386,7 @@ proc unpackstring(array s, array v) is
   }
 }
 
-proc prints(array s) is
-  var n;
-  var p;
-  var w;
-  var l;
-  var b;
-{ n := 1;
-  p := 0;
-  w := s[p];
-  l := rem(w, 256);
-  w := div(w, 256);
-  b := 1;
-  while (n <= l) do
-  { putval(rem(w, 256));
-    w := div(w, 256);
-    n := n + 1;
-    b := b + 1;
-    if (b = bytesperword)
-    then
-    { b := 0;
-      p := p + 1;
-      w := s[p]
-    }
-    else skip
-  }
-}
+proc prints(array s) is writes(s, outstream)
 
 proc printn(val n) is
 { if n < 0
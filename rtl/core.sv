@@ -41,15 +41,27 @@ module core
   hex_pkg::waddr_t  req_d_addr;
   hex_pkg::data_t   req_d_data;
   hex_pkg::data_t   res_d_data;
+  hex_pkg::data_t   res_sp_data;
+  // Data port as seen by the memory, shared with the link interface.
+  logic             mem_d_valid;
+  logic             mem_d_we;
+  hex_pkg::waddr_t  mem_d_addr;
+  hex_pkg::data_t   mem_d_data;
 
   // Processor <-> link interface.
   logic           op_out;
   logic           op_in;
+  logic           op_outn;
+  logic           op_inn;
   hex_pkg::slot_t chan_slot;
   hex_pkg::data_t chan_areg;
   logic           liu_busy;
   logic           liu_done;
   hex_pkg::data_t liu_in_word;
+  logic            liu_mem_valid;
+  logic            liu_mem_we;
+  hex_pkg::waddr_t liu_mem_addr;
+  hex_pkg::data_t  liu_mem_data;
 
   processor u_processor (
     .i_rst           (i_rst),
@@ -62,27 +74,38 @@ module core
     .o_d_addr        (req_d_addr),
     .o_d_data        (req_d_data),
     .i_d_data        (res_d_data),
+    .i_sp_data       (res_sp_data),
     .o_syscall_valid (o_syscall_valid),
     .o_syscall       (o_syscall),
     .o_op_out        (op_out),
     .o_op_in         (op_in),
+    .o_op_outn       (op_outn),
+    .o_op_inn        (op_inn),
     .o_chan_slot     (chan_slot),
     .o_chan_areg     (chan_areg),
     .i_liu_busy      (liu_busy),
     .i_liu_in_word   (liu_in_word)
   );
 
+  // The processor is stalled on an OPR while a block transfer uses the data
+  // port, so the link interface takes it over whenever it drives a request.
+  assign mem_d_valid = liu_mem_valid ? 1'b1         : req_d_valid;
+  assign mem_d_we    = liu_mem_valid ? liu_mem_we   : req_d_we;
+  assign mem_d_addr  = liu_mem_valid ? liu_mem_addr : req_d_addr;
+  assign mem_d_data  = liu_mem_valid ? liu_mem_data : req_d_data;
+
   memory u_memory (
     .i_rst     (i_rst),
     .i_clk     (i_clk),
     .i_f_valid (req_f_valid),
     .i_f_addr  (req_f_addr),
     .o_f_data  (res_f_data),
-    .i_d_valid (req_d_valid),
-    .i_d_addr  (req_d_addr),
-    .i_d_we    (req_d_we),
-    .i_d_data  (req_d_data),
-    .o_d_data  (res_d_data)
+    .i_d_valid (mem_d_valid),
+    .i_d_addr  (mem_d_addr),
+    .i_d_we    (mem_d_we),
+    .i_d_data  (mem_d_data),
+    .o_d_data  (res_d_data),
+    .o_sp_data (res_sp_data)
   );
 
   link_interface u_liu (
@@ -91,11 +114,19 @@ module core
     .i_core_id        (i_core_id),
     .i_op_out         (op_out),
     .i_op_in          (op_in),
+    .i_op_outn        (op_outn),
+    .i_op_inn         (op_inn),
     .i_slot           (chan_slot),
     .i_areg           (chan_areg),
     .o_busy           (liu_busy),
     .o_done           (liu_done),
     .o_in_word        (liu_in_word),
+    .i_sp_data        (res_sp_data),
+    .o_mem_valid      (liu_mem_valid),
+    .o_mem_we         (liu_mem_we),
+    .o_mem_addr       (liu_mem_addr),
+    .o_mem_data       (liu_mem_data),
+    .i_mem_data       (res_d_data),
     .i_cfg_we         (i_cfg_we),
     .i_cfg_slot       (i_cfg_slot),
     .i_cfg_dst_core   (i_cfg_dst_core),
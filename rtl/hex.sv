@@ -17,6 +17,7 @@ module hex
   hex_pkg::waddr_t  req_d_addr;
   hex_pkg::data_t   req_d_data;
   hex_pkg::data_t   res_d_data;
+  hex_pkg::data_t   res_sp_data;
 
   processor u_processor (
     .i_rst           (i_rst),
@@ -29,11 +30,14 @@ module hex
     .o_d_addr        (req_d_addr),
     .o_d_data        (req_d_data),
     .i_d_data        (res_d_data),
+    .i_sp_data       (res_sp_data),
     .o_syscall_valid (o_syscall_valid),
     .o_syscall       (o_syscall),
     // No channels in the single-core top: never stall, no received word.
     .o_op_out        (),
     .o_op_in         (),
+    .o_op_outn       (),
+    .o_op_inn        (),
     .o_chan_slot     (),
     .o_chan_areg     (),
     .i_liu_busy      (1'b0),
@@ -50,7 +54,8 @@ module hex
     .i_d_addr  (req_d_addr),
     .i_d_we    (req_d_we),
     .i_d_data  (req_d_data),
-    .o_d_data  (res_d_data)
+    .o_d_data  (res_d_data),
+    .o_sp_data (res_sp_data)
   );
 
   initial begin
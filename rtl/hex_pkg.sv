@@ -10,7 +10,7 @@ package hex_pkg;
   localparam INSTR_OPC_WIDTH = 4;
   localparam INSTR_OPR_WIDTH = 4;
   localparam INSTR_WIDTH = INSTR_OPC_WIDTH + INSTR_OPR_WIDTH;
-  localparam SYSCALL_OPC_WIDTH = 2;
+  localparam SYSCALL_OPC_WIDTH = 3;
 
   // Message passing: each core has NUM_LINKS logical channels (slots), and the
   // network connects up to NUM_CORES cores.
@@ -37,6 +37,7 @@ package hex_pkg;
     BR   = 'h9,
     BRZ  = 'hA,
     BRN  = 'hB,
+    SPI  = 'hC,
     OPR  = 'hD,
     PFIX = 'hE,
     NFIX = 'hF
@@ -48,13 +49,38 @@ package hex_pkg;
     SUB = 2,
     SVC = 3,
     IN  = 4,
-    OUT = 5
+    OUT = 5,
+    // Optional arithmetic and bitwise extensions.
+    MUL = 6,
+    DIV = 7,
+    LSH = 8,
+    RSH = 9,
+    AND = 10,
+    OR  = 11,
+    XOR = 12,
+    // Block channel transfers.
+    OUTN = 13,
+    INN  = 14
   } opr_opcode_t;
 
+  // SP-indexed memory access: the low operand bits select the access and the
+  // remaining (signed) bits are the word offset from the stack pointer.
+  localparam SPI_OPC_WIDTH = 2;
+
+  typedef enum logic [SPI_OPC_WIDTH-1:0] {
+    LDAS = 0,
+    LDBS = 1,
+    STAS = 2
+  } spi_opcode_t;
+
   typedef enum logic [SYSCALL_OPC_WIDTH-1:0] {
-    EXIT  = 0,
-    WRITE = 1,
-    READ  = 2
+    EXIT   = 0,
+    WRITE  = 1,
+    READ   = 2,
+    WRITES = 3,
+    READS  = 4,
+    WRITEN = 5,
+    READN  = 6
   } syscall_t;
 
   typedef struct packed {
@@ -5,11 +5,21 @@ module link_interface (
     // Processor side.
     input  logic               i_op_out,
     input  logic               i_op_in,
+    input  logic               i_op_outn,
+    input  logic               i_op_inn,
     input  hex_pkg::slot_t     i_slot,
     input  hex_pkg::data_t     i_areg,
     output logic               o_busy,
     output logic               o_done,
     output hex_pkg::data_t     o_in_word,
+    // Memory side, used by block transfers to read their arguments from the
+    // stack and to move the block itself.
+    input  hex_pkg::data_t     i_sp_data,
+    output logic               o_mem_valid,
+    output logic               o_mem_we,
+    output hex_pkg::waddr_t    o_mem_addr,
+    output hex_pkg::data_t     o_mem_data,
+    input  hex_pkg::data_t     i_mem_data,
     // Route table config (reset-time).
     input  logic               i_cfg_we,
     input  hex_pkg::slot_t     i_cfg_slot,
@@ -54,9 +64,25 @@ module link_interface (
   // (i_anet_flit carries no payload; only i_anet_valid is inspected.)
   assign o_anet_out_ready = 1'b1;
 
-  typedef enum logic [1:0] { IDLE, OUT_SEND, OUT_WAIT, IN_ACK } state_t;
+  // Block transfers (OUTN/INN) read the block address and word count from
+  // mem[SP+2] and mem[SP+3]. The sender streams the block as one DATA flit per
+  // word and the receiver writes each word into memory as it arrives. The
+  // receiver ACKs the first word, so the rest of the block only enters the
+  // network once both sides are engaged, and the last word, which completes
+  // the exchange. A one-word block has a single ACK. Both sides must give the
+  // same count, and a block operation must not be paired with a word one.
+  typedef enum logic [3:0] {
+    IDLE, OUT_SEND, OUT_WAIT, IN_ACK,
+    BLK_ADDR, BLK_COUNT, BOUT_SEND, BOUT_WAIT, BIN_RECV, BIN_ACK
+  } state_t;
   state_t st;
 
+  hex_pkg::waddr_t blk_addr;
+  hex_pkg::data_t  blk_count;
+  hex_pkg::data_t  blk_idx;
+  logic            blk_last;  // The word at blk_idx is the last of the block.
+  assign blk_last = blk_idx == blk_count - 1;
+
   // Combinational outputs.
   always_comb begin
     o_dnet_valid = 1'b0;
@@ -67,7 +93,11 @@ module link_interface (
     o_anet_flit  = '0;
     o_done       = 1'b0;
     o_in_word    = rx_word[i_slot];
-    o_busy       = (i_op_out || i_op_in);
+    o_busy       = (i_op_out || i_op_in || i_op_outn || i_op_inn);
+    o_mem_valid  = 1'b0;
+    o_mem_we     = 1'b0;
+    o_mem_addr   = '0;
+    o_mem_data   = '0;
     unique case (st)
       OUT_SEND: begin
         o_dnet_valid         = 1'b1;
@@ -86,6 +116,42 @@ module link_interface (
         o_anet_flit.dst_core = rx_src[i_slot];
         if (i_anet_in_ready) o_done = 1'b1;
       end
+      BLK_ADDR: begin
+        o_mem_valid = 1'b1;
+        o_mem_addr  = hex_pkg::waddr_t'(i_sp_data + 2);
+      end
+      BLK_COUNT: begin
+        o_mem_valid = 1'b1;
+        o_mem_addr  = hex_pkg::waddr_t'(i_sp_data + 3);
+        if (i_mem_data == '0) o_done = 1'b1; // Empty block: no rendezvous.
+      end
+      BOUT_SEND: begin
+        o_mem_valid          = 1'b1;
+        o_mem_addr           = hex_pkg::waddr_t'(blk_addr + blk_idx);
+        o_dnet_valid         = 1'b1;
+        o_dnet_dst           = rt_core[i_slot];
+        o_dnet_flit.dst_core = rt_core[i_slot];
+        o_dnet_flit.dst_slot = rt_slot[i_slot];
+        o_dnet_flit.src_core = i_core_id;
+        o_dnet_flit.word     = i_mem_data;
+      end
+      BOUT_WAIT: begin
+        if (i_anet_valid && blk_idx == blk_count) o_done = 1'b1;
+      end
+      BIN_RECV: begin
+        if (rx_valid[i_slot]) begin
+          o_mem_valid = 1'b1;
+          o_mem_we    = 1'b1;
+          o_mem_addr  = hex_pkg::waddr_t'(blk_addr + blk_idx);
+          o_mem_data  = rx_word[i_slot];
+        end
+      end
+      BIN_ACK: begin
+        o_anet_valid         = 1'b1;
+        o_anet_dst           = rx_src[i_slot];
+        o_anet_flit.dst_core = rx_src[i_slot];
+        if (i_anet_in_ready && blk_idx == blk_count) o_done = 1'b1;
+      end
       default: ; // IDLE
     endcase
     if (o_done) o_busy = 1'b0;
@@ -108,6 +174,7 @@ module link_interface (
         IDLE: begin
           if (i_op_out)                         st <= OUT_SEND;
           else if (i_op_in && rx_valid[i_slot]) st <= IN_ACK;
+          else if (i_op_outn || i_op_inn)       st <= BLK_ADDR;
         end
         OUT_SEND: if (i_dnet_in_ready) st <= OUT_WAIT;
         OUT_WAIT: if (i_anet_valid)    st <= IDLE;
@@ -115,6 +182,28 @@ module link_interface (
                     rx_valid[i_slot] <= 1'b0;
                     st <= IDLE;
                   end
+        BLK_ADDR: begin
+          blk_addr <= hex_pkg::waddr_t'(i_mem_data);
+          st <= BLK_COUNT;
+        end
+        BLK_COUNT: begin
+          blk_count <= i_mem_data;
+          blk_idx   <= '0;
+          if (i_mem_data == '0) st <= IDLE;
+          else if (i_op_outn)   st <= BOUT_SEND;
+          else                  st <= BIN_RECV;
+        end
+        BOUT_SEND: if (i_dnet_in_ready) begin
+                     blk_idx <= blk_idx + 1;
+                     if (blk_idx == '0 || blk_last) st <= BOUT_WAIT;
+                   end
+        BOUT_WAIT: if (i_anet_valid) st <= (blk_idx == blk_count) ? IDLE : BOUT_SEND;
+        BIN_RECV:  if (rx_valid[i_slot]) begin
+                     rx_valid[i_slot] <= 1'b0;
+                     blk_idx <= blk_idx + 1;
+                     if (blk_idx == '0 || blk_last) st <= BIN_ACK;
+                   end
+        BIN_ACK:   if (i_anet_in_ready) st <= (blk_idx == blk_count) ? IDLE : BIN_RECV;
       endcase
     end
 
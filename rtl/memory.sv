@@ -11,7 +11,9 @@ module memory
     input  logic             i_d_we,
     input  hex_pkg::waddr_t  i_d_addr,
     input  hex_pkg::data_t   i_d_data,
-    output hex_pkg::data_t   o_d_data
+    output hex_pkg::data_t   o_d_data,
+    // Read only stack pointer (word 1) port.
+    output hex_pkg::data_t   o_sp_data
   );
 
   logic [hex_pkg::MEM_WIDTH-1:0] memory_q [hex_pkg::MEM_DEPTH-1:0] /* verilator public */;
@@ -26,5 +28,6 @@ module memory
 
   assign o_f_data = memory_q[i_f_addr[hex_pkg::MEM_ADDR_WIDTH-1:2]][fetch_byte_addr +: 8];
   assign o_d_data = memory_q[i_d_addr];
+  assign o_sp_data = memory_q[1];
 
 endmodule
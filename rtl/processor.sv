@@ -12,12 +12,16 @@ module processor
     output hex_pkg::waddr_t   o_d_addr,
     output hex_pkg::data_t    o_d_data,
     input  hex_pkg::data_t    i_d_data,
+    // Stack pointer (memory word 1) for SP-indexed accesses.
+    input  hex_pkg::data_t    i_sp_data,
     // Syscall interface
     output logic              o_syscall_valid,
     output hex_pkg::syscall_t o_syscall,
     // Channel link interface (to the per-core link_interface unit).
     output logic              o_op_out,
     output logic              o_op_in,
+    output logic              o_op_outn,
+    output logic              o_op_inn,
     output hex_pkg::slot_t    o_chan_slot,
     output hex_pkg::data_t    o_chan_areg,
     input  logic              i_liu_busy,
@@ -35,6 +39,8 @@ module processor
   logic              instr_svc;
   logic              instr_in;
   logic              instr_out;
+  logic              instr_inn;
+  logic              instr_outn;
   logic              stall;
   hex_pkg::iaddr_t   pc_d;
   hex_pkg::data_t    areg_d;
@@ -44,6 +50,9 @@ module processor
   hex_pkg::iaddr_t   opr_iaddr;
   hex_pkg::opcode_t  instr_opc;
   hex_pkg::operand_t instr_opr;
+  hex_pkg::spi_opcode_t spi_opc;
+  hex_pkg::data_t    spi_offset;
+  logic              spi_invalid /* verilator public */;
 
   always_ff @(posedge i_clk or posedge i_rst)
     if (i_rst) begin
@@ -67,19 +76,33 @@ module processor
   assign instr_svc = instr.opcode == hex_pkg::OPR && instr.operand == hex_pkg::SVC;
   assign instr_in  = instr.opcode == hex_pkg::OPR && instr.operand == hex_pkg::IN;
   assign instr_out = instr.opcode == hex_pkg::OPR && instr.operand == hex_pkg::OUT;
+  assign instr_inn  = instr.opcode == hex_pkg::OPR && instr.operand == hex_pkg::INN;
+  assign instr_outn = instr.opcode == hex_pkg::OPR && instr.operand == hex_pkg::OUTN;
 
   // Channel ops hand off to the link interface; the channel index is in breg
   // and the word to send is in areg. The processor stalls (freezes all state)
-  // until the link interface completes the rendezvous.
+  // until the link interface completes the rendezvous. Block transfers take
+  // their arguments from the stack, which the link interface reads itself.
   assign o_op_out    = instr_out;
   assign o_op_in     = instr_in;
+  assign o_op_outn   = instr_outn;
+  assign o_op_inn    = instr_inn;
   assign o_chan_slot = breg_q[hex_pkg::SLOT_W-1:0];
   assign o_chan_areg = areg_q;
-  assign stall       = (instr_in || instr_out) && i_liu_busy;
+  assign stall       = (instr_in || instr_out || instr_inn || instr_outn)
+                       && i_liu_busy;
 
   // Current operand (oreg) value.
   assign opr_d = oreg_q | {28'b0, instr.operand};
 
+  // SPI access kind and signed word offset from the stack pointer.
+  assign spi_opc    = hex_pkg::spi_opcode_t'(opr_d[hex_pkg::SPI_OPC_WIDTH-1:0]);
+  assign spi_offset = hex_pkg::data_t'(signed'(opr_d) >>> hex_pkg::SPI_OPC_WIDTH);
+  // Access kind 3 is undefined. It changes no state here, and is flagged so
+  // that a testbench raises the error the simulator does.
+  assign spi_invalid = instr.opcode == hex_pkg::SPI
+                       && !(spi_opc inside {hex_pkg::LDAS, hex_pkg::LDBS, hex_pkg::STAS});
+
   // PC update
   always_comb begin
     pc_d = {pc_q + 20'b1};
@@ -113,11 +136,21 @@ module processor
       hex_pkg::LDAC: areg_d = opr_d;
       hex_pkg::LDAP: areg_d = {11'b0, pc_d + signed'(opr_d[hex_pkg::MEM_ADDR_WIDTH-1:0])};
       hex_pkg::LDAI: areg_d = i_d_data;
+      hex_pkg::SPI:  areg_d = (spi_opc == hex_pkg::LDAS) ? i_d_data : areg_q;
       hex_pkg::OPR:
         unique case(instr.operand)
           hex_pkg::ADD: areg_d = {areg_q + breg_q};
           hex_pkg::SUB: areg_d = {areg_q - breg_q};
           hex_pkg::IN:  areg_d = i_liu_in_word;
+          hex_pkg::MUL: areg_d = areg_q * breg_q;
+          // A zero divisor gives zero, matching the simulator.
+          hex_pkg::DIV: areg_d = (breg_q == '0) ? '0
+                                 : hex_pkg::data_t'(signed'(areg_q) / signed'(breg_q));
+          hex_pkg::LSH: areg_d = areg_q << breg_q;
+          hex_pkg::RSH: areg_d = areg_q >> breg_q;
+          hex_pkg::AND: areg_d = areg_q & breg_q;
+          hex_pkg::OR:  areg_d = areg_q | breg_q;
+          hex_pkg::XOR: areg_d = areg_q ^ breg_q;
           default:;
         endcase
       default:;
@@ -131,16 +164,19 @@ module processor
       hex_pkg::LDBM,
       hex_pkg::LDBI: breg_d = i_d_data;
       hex_pkg::LDBC: breg_d = opr_d;
+      hex_pkg::SPI:  breg_d = (spi_opc == hex_pkg::LDBS) ? i_d_data : breg_q;
       default:;
     endcase
   end
 
   // Memory valid
   assign o_d_valid = instr.opcode inside {hex_pkg::LDAM, hex_pkg::LDBM, hex_pkg::STAM,
-                                          hex_pkg::LDAI, hex_pkg::LDBI, hex_pkg::STAI};
+                                          hex_pkg::LDAI, hex_pkg::LDBI, hex_pkg::STAI,
+                                          hex_pkg::SPI};
 
   // Memory write enable
-  assign o_d_we = instr.opcode inside {hex_pkg::STAM, hex_pkg::STAI};
+  assign o_d_we = instr.opcode inside {hex_pkg::STAM, hex_pkg::STAI}
+                  || (instr.opcode == hex_pkg::SPI && spi_opc == hex_pkg::STAS);
 
   // Memory address generation
   always_comb begin
@@ -157,6 +193,9 @@ module processor
       hex_pkg::STAI:
         o_d_addr = {breg_q[hex_pkg::MEM_ADDR_WIDTH-3:0]
                      + signed'(opr_d[hex_pkg::MEM_ADDR_WIDTH-3:0])};
+      hex_pkg::SPI:
+        o_d_addr = {i_sp_data[hex_pkg::MEM_ADDR_WIDTH-3:0]
+                     + signed'(spi_offset[hex_pkg::MEM_ADDR_WIDTH-3:0])};
       default:;
     endcase
   end
@@ -27,6 +27,8 @@ const char *hex::instrEnumToStr(Instr instr) {
     return "BRZ";
   case BRN:
     return "BRN";
+  case SPI:
+    return "SPI";
   case PFIX:
     return "PFIX";
   case NFIX:
@@ -53,6 +55,38 @@ const char *hex::oprInstrEnumToStr(OprInstr oprInstr) {
     return "IN";
   case OUT:
     return "OUT";
+  case MUL:
+    return "MUL";
+  case DIV:
+    return "DIV";
+  case LSH:
+    return "LSH";
+  case RSH:
+    return "RSH";
+  case AND:
+    return "AND";
+  case OR:
+    return "OR";
+  case XOR:
+    return "XOR";
+  case OUTN:
+    return "OUTN";
+  case INN:
+    return "INN";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+const char *hex::spiInstrEnumToStr(SpiInstr spiInstr) {
+  using enum SpiInstr;
+  switch (spiInstr) {
+  case LDAS:
+    return "LDAS";
+  case LDBS:
+    return "LDBS";
+  case STAS:
+    return "STAS";
   default:
     return "UNKNOWN";
   }
@@ -66,6 +100,14 @@ const char *hex::syscallEnumToStr(Syscall syscall) {
     return "WRITE";
   case Syscall::READ:
     return "READ";
+  case Syscall::WRITES:
+    return "WRITES";
+  case Syscall::READS:
+    return "READS";
+  case Syscall::WRITEN:
+    return "WRITEN";
+  case Syscall::READN:
+    return "READN";
   default:
     return "UNKNOWN";
   }
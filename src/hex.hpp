@@ -22,6 +22,7 @@ enum class Instr : uint8_t {
   BR = 0x9,
   BRZ = 0xA,
   BRN = 0xB,
+  SPI = 0xC,
   OPR = 0xD,
   PFIX = 0xE,
   NFIX = 0xF,
@@ -33,13 +34,73 @@ enum class OprInstr : uint8_t {
   SUB = 0x2,
   SVC = 0x3,
   IN = 0x4,
-  OUT = 0x5
+  OUT = 0x5,
+  // Optional arithmetic and bitwise extensions.
+  MUL = 0x6,
+  DIV = 0x7,
+  LSH = 0x8,
+  RSH = 0x9,
+  AND = 0xA,
+  OR = 0xB,
+  XOR = 0xC,
+  // Block channel transfers of mem[SP+3] words starting at word mem[SP+2].
+  OUTN = 0xD,
+  INN = 0xE
 };
 
-enum class Syscall { EXIT = 0, WRITE = 1, READ = 2, NUM_VALUES };
+// SP-indexed memory accesses, selected by the low SPI_OP_BITS of oreg. The
+// remaining bits of oreg give a signed word offset from the stack pointer
+// held in memory[1].
+enum class SpiInstr : uint8_t { LDAS = 0x0, LDBS = 0x1, STAS = 0x2 };
+
+constexpr unsigned SPI_OP_BITS = 2;
+
+/// Decode the access kind of an SPI operand.
+inline SpiInstr spiOp(uint32_t oreg) {
+  return static_cast<SpiInstr>(oreg & ((1U << SPI_OP_BITS) - 1));
+}
+
+/// Decode the word offset of an SPI operand.
+inline uint32_t spiOffset(uint32_t oreg) {
+  return static_cast<uint32_t>(static_cast<int32_t>(oreg) >> SPI_OP_BITS);
+}
+
+/// Encode an SPI operand from an access kind and word offset.
+inline int spiOperand(SpiInstr op, int offset) {
+  return offset * (1 << SPI_OP_BITS) + static_cast<int>(op);
+}
+
+enum class Syscall {
+  EXIT = 0,
+  WRITE = 1,
+  READ = 2,
+  WRITES = 3, // Write a packed string.
+  READS = 4,  // Read a line into a packed string.
+  WRITEN = 5, // Write a range of words, one character each.
+  READN = 6,  // Read into a range of words, one character each.
+  NUM_VALUES
+};
+
+/// Signed division for OPR DIV: truncates towards zero, and a zero divisor
+/// gives zero.
+inline uint32_t oprDiv(uint32_t a, uint32_t b) {
+  if (b == 0) {
+    return 0;
+  }
+  if (b == 0xFFFFFFFF) {
+    return 0 - a; // Avoid overflow of INT_MIN / -1.
+  }
+  return static_cast<uint32_t>(static_cast<int32_t>(a) /
+                               static_cast<int32_t>(b));
+}
+
+/// Logical shifts for OPR LSH and RSH: shifting by 32 or more gives zero.
+inline uint32_t oprLsh(uint32_t a, uint32_t b) { return b < 32 ? a << b : 0; }
+inline uint32_t oprRsh(uint32_t a, uint32_t b) { return b < 32 ? a >> b : 0; }
 
 const char *instrEnumToStr(Instr instr);
 const char *oprInstrEnumToStr(OprInstr oprInstr);
+const char *spiInstrEnumToStr(SpiInstr spiInstr);
 const char *syscallEnumToStr(Syscall syscall);
 
 constexpr int MAX_MEMORY_SIZE_WORDS = 200000;
@@ -0,0 +1,518 @@
+#ifndef HEX_2C_HPP
+#define HEX_2C_HPP
+
+#include <cstdint>
+#include <fmt/format.h>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hex.hpp"
+#include "hexcontainer.hpp"
+#include "heximage.hpp"
+
+//===---------------------------------------------------------------------===//
+// Ahead-of-time translation of Hex images into C++.
+//
+// Each image becomes one function whose body is a switch over the byte
+// addresses of its basic-block leaders. Straight-line code between leaders is
+// emitted inline with prefix chains folded into constant operands; direct
+// branches become gotos and computed (BRB) branches dispatch through the
+// switch. Syscalls and channel operations return to the runtime in
+// hex2crt.hpp, which reproduces hexsim's scheduling. Images are assumed not to
+// modify their own code.
+//===---------------------------------------------------------------------===//
+
+namespace hex2c {
+
+class Translator {
+
+  /// A decoded image: its program bytes and debug symbols.
+  struct Image {
+    std::vector<uint32_t> words;
+    std::vector<uint8_t> bytes;
+    std::map<uint32_t, std::string> symbols;
+    unsigned function;
+  };
+
+  hexcontainer::Container container;
+  std::vector<Image> images;
+  // Index of the translated function for each processor.
+  std::vector<unsigned> functions;
+
+  static bool isPrefix(hex::Instr instr) {
+    return instr == hex::Instr::PFIX || instr == hex::Instr::NFIX;
+  }
+
+  static uint32_t foldPrefix(hex::Instr instr, uint32_t oreg) {
+    return instr == hex::Instr::PFIX ? oreg << 4 : 0xFFFFFF00 | (oreg << 4);
+  }
+
+  /// OPR operations that return to the runtime.
+  static bool isEventOpr(hex::OprInstr opr) {
+    return opr == hex::OprInstr::SVC || opr == hex::OprInstr::IN ||
+           opr == hex::OprInstr::OUT || opr == hex::OprInstr::OUTN ||
+           opr == hex::OprInstr::INN;
+  }
+
+  /// OPR operations computed inline on the registers.
+  static bool isAluOpr(hex::OprInstr opr) {
+    return opr != hex::OprInstr::BRB && !isEventOpr(opr) &&
+           opr <= hex::OprInstr::XOR;
+  }
+
+  static Image decode(const std::vector<char> &data) {
+    std::istringstream stream(std::string(data.begin(), data.end()),
+                              std::ios::binary);
+    Image image;
+    unsigned programSizeWords = heximage::readU32(stream);
+    image.words.resize(programSizeWords);
+    stream.read(reinterpret_cast<char *>(image.words.data()),
+                programSizeWords * 4);
+    if (data.size() > 4 + programSizeWords * 4) {
+      for (auto &symbol : heximage::readSymbols(stream)) {
+        image.symbols[symbol.offset] = symbol.name;
+      }
+    }
+    for (auto word : image.words) {
+      for (unsigned i = 0; i < 4; i++) {
+        image.bytes.push_back((word >> (i * 8)) & 0xFF);
+      }
+    }
+    return image;
+  }
+
+  /// Find the basic-block leaders of an image: the entry point, symbols,
+  /// branch targets, LDAP link addresses and every instruction following a
+  /// branch, syscall or channel operation. Operands are decoded along the
+  /// fall-through path, which is how the assembler lays out prefix chains.
+  static std::set<uint32_t> findLeaders(const Image &image) {
+    std::set<uint32_t> leaders = {0};
+    auto size = static_cast<uint32_t>(image.bytes.size());
+    auto addLeader = [&](uint32_t address) {
+      if (address < size) {
+        leaders.insert(address);
+      }
+    };
+    for (auto &symbol : image.symbols) {
+      addLeader(symbol.first);
+    }
+    uint32_t oreg = 0;
+    for (uint32_t pc = 0; pc < size; pc++) {
+      auto instr = static_cast<hex::Instr>(image.bytes[pc] >> 4);
+      oreg |= image.bytes[pc] & 0xF;
+      if (isPrefix(instr)) {
+        oreg = foldPrefix(instr, oreg);
+        continue;
+      }
+      switch (instr) {
+      case hex::Instr::BR:
+      case hex::Instr::BRZ:
+      case hex::Instr::BRN:
+        addLeader(pc + 1 + oreg);
+        addLeader(pc + 1);
+        break;
+      case hex::Instr::LDAP:
+        addLeader(pc + 1 + oreg);
+        break;
+      case hex::Instr::OPR:
+        switch (static_cast<hex::OprInstr>(oreg)) {
+        case hex::OprInstr::BRB:
+        case hex::OprInstr::SVC:
+        case hex::OprInstr::IN:
+        case hex::OprInstr::OUT:
+        case hex::OprInstr::OUTN:
+        case hex::OprInstr::INN:
+          addLeader(pc + 1);
+          break;
+        default:
+          break;
+        }
+        break;
+      default:
+        break;
+      }
+      oreg = 0;
+    }
+    return leaders;
+  }
+
+  /// Emits the body of one translated function.
+  class FunctionEmitter {
+    const Image &image;
+    std::ostream &out;
+    std::set<uint32_t> leaders;
+    // Leaders that fall inside a prefix chain, entered with a runtime oreg.
+    std::set<uint32_t> chainLeaders;
+    // Leaders that are the target of a direct goto.
+    std::set<uint32_t> labels;
+    // Instructions executed since cycles was last updated.
+    unsigned pendingCycles = 0;
+
+    std::string save(const char *event, const std::string &pc,
+                     const std::string &oreg = "0") {
+      return fmt::format("return s.suspend(hex2crt::Event::{}, {}, areg, breg, "
+                         "{}, cycles);",
+                         event, pc, oreg);
+    }
+
+    void flushCycles() {
+      if (pendingCycles > 0) {
+        out << fmt::format("    cycles += {};\n", pendingCycles);
+        pendingCycles = 0;
+      }
+    }
+
+    /// A jump to a branch target, direct if it is a leader.
+    std::string jump(uint32_t target) {
+      if (leaders.count(target)) {
+        return fmt::format("{}goto L{};",
+                           chainLeaders.count(target) ? "oreg = 0; " : "",
+                           target);
+      }
+      return fmt::format("pc = {}; goto dispatch;", target);
+    }
+
+    void emitOpr(uint32_t pc, uint32_t opr, const std::string &indent) {
+      switch (static_cast<hex::OprInstr>(opr)) {
+      case hex::OprInstr::BRB:
+        out << indent << "pc = breg;\n" << indent << "goto dispatch;\n";
+        break;
+      case hex::OprInstr::ADD:
+        out << indent << "areg = areg + breg;\n";
+        break;
+      case hex::OprInstr::SUB:
+        out << indent << "areg = areg - breg;\n";
+        break;
+      case hex::OprInstr::MUL:
+        out << indent << "areg = areg * breg;\n";
+        break;
+      case hex::OprInstr::DIV:
+        out << indent << "areg = hex::oprDiv(areg, breg);\n";
+        break;
+      case hex::OprInstr::LSH:
+        out << indent << "areg = hex::oprLsh(areg, breg);\n";
+        break;
+      case hex::OprInstr::RSH:
+        out << indent << "areg = hex::oprRsh(areg, breg);\n";
+        break;
+      case hex::OprInstr::AND:
+        out << indent << "areg = areg & breg;\n";
+        break;
+      case hex::OprInstr::OR:
+        out << indent << "areg = areg | breg;\n";
+        break;
+      case hex::OprInstr::XOR:
+        out << indent << "areg = areg ^ breg;\n";
+        break;
+      case hex::OprInstr::SVC:
+        out << indent << save("SVC", std::to_string(pc)) << "\n";
+        break;
+      case hex::OprInstr::IN:
+        out << indent << save("IN", std::to_string(pc)) << "\n";
+        break;
+      case hex::OprInstr::OUT:
+        out << indent << save("OUT", std::to_string(pc)) << "\n";
+        break;
+      case hex::OprInstr::OUTN:
+        out << indent << save("OUTN", std::to_string(pc)) << "\n";
+        break;
+      case hex::OprInstr::INN:
+        out << indent << save("INN", std::to_string(pc)) << "\n";
+        break;
+      default:
+        out << indent
+            << save("INVALID_OPR", std::to_string(pc), std::to_string(opr))
+            << "\n";
+        break;
+      }
+    }
+
+    void emitSpi(uint32_t pc, uint32_t op, const std::string &offset,
+                 const std::string &operand, const std::string &indent) {
+      switch (static_cast<hex::SpiInstr>(op)) {
+      case hex::SpiInstr::LDAS:
+        out << indent << fmt::format("areg = mem[mem[1] + {}];\n", offset);
+        break;
+      case hex::SpiInstr::LDBS:
+        out << indent << fmt::format("breg = mem[mem[1] + {}];\n", offset);
+        break;
+      case hex::SpiInstr::STAS:
+        out << indent << fmt::format("mem[mem[1] + {}] = areg;\n", offset);
+        break;
+      default:
+        out << indent << save("INVALID_SPI", std::to_string(pc), operand)
+            << "\n";
+        break;
+      }
+    }
+
+    /// Emit a non-prefix instruction with operand expression operand (a
+    /// constant unless known is false).
+    void emitInstr(uint32_t pc, hex::Instr instr, uint32_t value, bool known,
+                   const std::string &operand) {
+      auto next = pc + 1;
+      switch (instr) {
+      case hex::Instr::LDAM:
+        out << fmt::format("    areg = mem[{}];\n", operand);
+        break;
+      case hex::Instr::LDBM:
+        out << fmt::format("    breg = mem[{}];\n", operand);
+        break;
+      case hex::Instr::STAM:
+        out << fmt::format("    mem[{}] = areg;\n", operand);
+        break;
+      case hex::Instr::LDAC:
+        out << fmt::format("    areg = {};\n", operand);
+        break;
+      case hex::Instr::LDBC:
+        out << fmt::format("    breg = {};\n", operand);
+        break;
+      case hex::Instr::LDAP:
+        out << fmt::format("    areg = {}u + {};\n", next, operand);
+        break;
+      case hex::Instr::LDAI:
+        out << fmt::format("    areg = mem[areg + {}];\n", operand);
+        break;
+      case hex::Instr::LDBI:
+        out << fmt::format("    breg = mem[breg + {}];\n", operand);
+        break;
+      case hex::Instr::STAI:
+        out << fmt::format("    mem[breg + {}] = areg;\n", operand);
+        break;
+      case hex::Instr::BR:
+      case hex::Instr::BRZ:
+      case hex::Instr::BRN: {
+        flushCycles();
+        std::string target =
+            known ? jump(next + value)
+                  : fmt::format("pc = {}u + {}; goto dispatch;", next, operand);
+        if (instr == hex::Instr::BR) {
+          out << "    " << target << "\n";
+        } else if (instr == hex::Instr::BRZ) {
+          out << "    if (areg == 0) { " << target << " }\n";
+        } else {
+          out << "    if (static_cast<int32_t>(areg) < 0) { " << target
+              << " }\n";
+        }
+        break;
+      }
+      case hex::Instr::SPI:
+        if (known) {
+          if (hex::spiOp(value) > hex::SpiInstr::STAS) {
+            flushCycles();
+          }
+          emitSpi(pc, uint32_t(hex::spiOp(value)),
+                  fmt::format("{}u", hex::spiOffset(value)),
+                  std::to_string(value), "    ");
+        } else {
+          flushCycles();
+          out << fmt::format("    switch ({} & 0x3) {{\n", operand);
+          for (uint32_t op = 0; op <= uint32_t(hex::SpiInstr::STAS); op++) {
+            out << fmt::format("    case {}:\n", op);
+            emitSpi(pc, op, fmt::format("hex::spiOffset({})", operand),
+                    operand, "      ");
+            out << "      break;\n";
+          }
+          out << "    default:\n";
+          emitSpi(pc, uint32_t(hex::SpiInstr::STAS) + 1, "", operand, "      ");
+          out << "    }\n";
+        }
+        break;
+      case hex::Instr::OPR:
+        // The event operations are counted by the runtime when they complete.
+        if (known) {
+          auto opr = static_cast<hex::OprInstr>(value);
+          if (isEventOpr(opr)) {
+            pendingCycles--;
+          }
+          if (!isAluOpr(opr)) {
+            flushCycles();
+          }
+          emitOpr(pc, value, "    ");
+        } else {
+          flushCycles();
+          out << fmt::format("    switch ({}) {{\n", operand);
+          for (uint32_t opr = 0; opr <= uint32_t(hex::OprInstr::INN); opr++) {
+            out << fmt::format("    case {}:\n", opr);
+            if (isEventOpr(static_cast<hex::OprInstr>(opr))) {
+              out << "      cycles -= 1;\n";
+            }
+            emitOpr(pc, opr, "      ");
+            if (isAluOpr(static_cast<hex::OprInstr>(opr))) {
+              out << "      break;\n";
+            }
+          }
+          out << "    default:\n";
+          out << "      " << save("INVALID_OPR", std::to_string(pc), operand)
+              << "\n";
+          out << "    }\n";
+        }
+        break;
+      default:
+        flushCycles();
+        out << "    " << save("INVALID_INSTR", std::to_string(pc)) << "\n";
+        break;
+      }
+    }
+
+  public:
+    FunctionEmitter(const Image &image, std::ostream &out)
+        : image(image), out(out), leaders(findLeaders(image)) {
+      // Classify the leaders and collect the targets of direct branches.
+      uint32_t oreg = 0;
+      for (uint32_t pc = 0; pc < image.bytes.size(); pc++) {
+        if (pc > 0 && leaders.count(pc) &&
+            isPrefix(static_cast<hex::Instr>(image.bytes[pc - 1] >> 4))) {
+          chainLeaders.insert(pc);
+        }
+        auto instr = static_cast<hex::Instr>(image.bytes[pc] >> 4);
+        oreg |= image.bytes[pc] & 0xF;
+        if (isPrefix(instr)) {
+          oreg = foldPrefix(instr, oreg);
+          continue;
+        }
+        if (instr == hex::Instr::BR || instr == hex::Instr::BRZ ||
+            instr == hex::Instr::BRN) {
+          if (leaders.count(pc + 1 + oreg)) {
+            labels.insert(pc + 1 + oreg);
+          }
+        }
+        oreg = 0;
+      }
+    }
+
+    void emit() {
+      out << "  uint32_t *mem = s.memory.data();\n";
+      out << "  uint32_t pc = s.pc;\n";
+      out << "  uint32_t areg = s.areg;\n";
+      out << "  uint32_t breg = s.breg;\n";
+      // The operand register only exists at runtime inside prefix chains that
+      // contain a leader.
+      if (!chainLeaders.empty()) {
+        out << "  uint32_t oreg = 0;\n";
+      }
+      out << "  uint64_t cycles = s.cycles;\n";
+      out << "dispatch:\n";
+      if (!chainLeaders.empty()) {
+        out << "  oreg = 0;\n";
+      }
+      out << "  switch (pc) {\n";
+      out << "  default:\n";
+      out << "    " << save("UNTRANSLATED", "pc") << "\n";
+      // Whether the operand register is only known at runtime (after a leader
+      // inside a prefix chain), otherwise its constant value.
+      bool runtimeOreg = false;
+      uint32_t oreg = 0;
+      auto size = static_cast<uint32_t>(image.bytes.size());
+      for (uint32_t pc = 0; pc < size; pc++) {
+        if (leaders.count(pc)) {
+          flushCycles();
+          if (chainLeaders.count(pc)) {
+            if (!runtimeOreg) {
+              out << fmt::format("    oreg = {}u;\n", oreg);
+            }
+            runtimeOreg = true;
+          }
+          auto symbol = image.symbols.find(pc);
+          if (symbol != image.symbols.end()) {
+            out << fmt::format("  // {}\n", symbol->second);
+          }
+          out << fmt::format("  case {}:\n", pc);
+          if (labels.count(pc)) {
+            out << fmt::format("  L{}:\n", pc);
+          }
+        }
+        auto instr = static_cast<hex::Instr>(image.bytes[pc] >> 4);
+        uint32_t nibble = image.bytes[pc] & 0xF;
+        pendingCycles++;
+        if (isPrefix(instr)) {
+          if (runtimeOreg) {
+            out << fmt::format("    oreg = {}((oreg | {}) << 4);\n",
+                               instr == hex::Instr::NFIX ? "0xFFFFFF00 | " : "",
+                               nibble);
+          } else {
+            oreg = foldPrefix(instr, oreg | nibble);
+          }
+          continue;
+        }
+        if (runtimeOreg) {
+          emitInstr(pc, instr, 0, false, fmt::format("(oreg | {})", nibble));
+        } else {
+          emitInstr(pc, instr, oreg | nibble, true,
+                    fmt::format("{}u", oreg | nibble));
+        }
+        runtimeOreg = false;
+        oreg = 0;
+      }
+      flushCycles();
+      out << "    " << save("UNTRANSLATED", std::to_string(size)) << "\n";
+      out << "  }\n";
+    }
+  };
+
+public:
+  Translator(hexcontainer::Container container)
+      : container(std::move(container)) {
+    // Translate identical images once.
+    std::map<std::vector<char>, unsigned> seen;
+    for (auto &data : this->container.images) {
+      auto it = seen.find(data);
+      if (it == seen.end()) {
+        auto index = static_cast<unsigned>(images.size());
+        images.push_back(decode(data));
+        images.back().function = index;
+        it = seen.emplace(data, index).first;
+      }
+      functions.push_back(it->second);
+    }
+  }
+
+  /// Write a complete C++ program that runs the translated images.
+  void emit(std::ostream &out) {
+    out << "// Generated by hex2c.\n";
+    out << "#include <cstdint>\n";
+    out << "#include <exception>\n";
+    out << "#include <iostream>\n\n";
+    out << "#include \"hex2crt.hpp\"\n\n";
+    for (auto &image : images) {
+      out << fmt::format("static const uint32_t program{}[] = {{",
+                         image.function);
+      for (size_t i = 0; i < image.words.size(); i++) {
+        out << (i % 8 == 0 ? "\n   " : "")
+            << fmt::format(" {:#010x},", image.words[i]);
+      }
+      out << "\n  0};\n\n";
+      out << fmt::format(
+          "static hex2crt::Event image{}(hex2crt::State &s) {{\n",
+          image.function);
+      FunctionEmitter(image, out).emit();
+      out << "}\n\n";
+    }
+    out << "int main() {\n";
+    out << "  try {\n";
+    out << "    hex2crt::System system(std::cin, std::cout);\n";
+    for (auto function : functions) {
+      out << fmt::format(
+          "    system.addProcessor(image{0}, program{0}, {1});\n", function,
+          images[function].words.size());
+    }
+    for (auto &e : container.edges) {
+      out << fmt::format("    system.connect({}, {}, {}, {});\n", e.procA,
+                         e.slotA, e.procB, e.slotB);
+    }
+    out << "    return system.run();\n";
+    out << "  } catch (std::exception &e) {\n";
+    out << "    std::cerr << \"Error: \" << e.what() << \"\\n\";\n";
+    out << "    return 1;\n";
+    out << "  }\n";
+    out << "}\n";
+  }
+};
+
+} // End namespace hex2c
+
+#endif // HEX_2C_HPP
@@ -0,0 +1,343 @@
+#ifndef HEX_2C_RT_HPP
+#define HEX_2C_RT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hex.hpp"
+#include "hexsimio.hpp"
+
+//===---------------------------------------------------------------------===//
+// Runtime support for programs translated by hex2c.
+//
+// Each translated image is a function that runs from the saved PC until it
+// reaches an event (a syscall, a channel operation or a fault), saves its
+// registers and returns the event. The System commits events in the order
+// hexsim's round-robin scheduler would execute them, ordering by (tick,
+// processor id), so output, exit codes and deadlocks match hexsim exactly.
+// Translated code never touches shared state, so running a processor ahead
+// to its next event is always safe.
+//===---------------------------------------------------------------------===//
+
+namespace hex2crt {
+
+/// The reason a translated function returned to the runtime.
+enum class Event {
+  SVC,
+  IN,
+  OUT,
+  INN,
+  OUTN,
+  INVALID_OPR,
+  INVALID_SPI,
+  INVALID_INSTR,
+  UNTRANSLATED
+};
+
+/// Architectural state of one translated processor.
+struct State {
+  uint32_t pc = 0;
+  uint32_t areg = 0;
+  uint32_t breg = 0;
+  uint32_t oreg = 0;
+  uint64_t cycles = 0;
+  std::vector<uint32_t> memory;
+
+  State() : memory(hex::MAX_MEMORY_SIZE_WORDS) {}
+
+  /// Save the registers of a translated function and return its event.
+  Event suspend(Event event, uint32_t pcValue, uint32_t aregValue,
+                uint32_t bregValue, uint32_t oregValue, uint64_t cycleCount) {
+    pc = pcValue;
+    areg = aregValue;
+    breg = bregValue;
+    oreg = oregValue;
+    cycles = cycleCount;
+    return event;
+  }
+};
+
+/// Entry point of a translated image.
+using Entry = Event (*)(State &);
+
+/// Format an address like hexsim's "{:#08x}".
+inline std::string formatAddress(uint32_t value) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "0x%06x", value);
+  return buffer;
+}
+
+/// A network of translated processors connected by synchronous channels.
+class System {
+  enum class Status { READY, PENDING, BLOCKED, HALTED };
+
+  struct Channel {
+    enum class State { IDLE, WRITER_WAITING, READER_WAITING };
+    State state = State::IDLE;
+    uint32_t value = 0;
+    bool block = false;
+    uint32_t address = 0;
+    uint32_t count = 0;
+    unsigned writer = 0;
+    unsigned reader = 0;
+  };
+
+  struct Processor {
+    Entry entry;
+    State state;
+    hex::HexSimIO io;
+    Status status = Status::READY;
+    Event event = Event::SVC;
+    // The tick at which the next instruction (or the pending event) executes.
+    uint64_t time = 0;
+    int links[hex::NUM_LINKS] = {-1, -1, -1, -1};
+    unsigned blockedSlot = 0;
+    int exitCode = 0;
+
+    Processor(Entry entry, std::istream &in, std::ostream &out)
+        : entry(entry), io(in, out) {}
+  };
+
+  std::vector<std::unique_ptr<Processor>> procs;
+  std::vector<Channel> channels;
+  std::vector<unsigned> ready;
+  std::set<std::pair<uint64_t, unsigned>> pending;
+  std::istream &in;
+  std::ostream &out;
+  int exitCode = 0;
+  bool haveExit = false;
+
+  /// Complete the event instruction of processor id and make it ready to run
+  /// to its next event, starting at tick nextTime.
+  void resume(unsigned id, uint64_t nextTime) {
+    auto &p = *procs[id];
+    p.state.pc++;
+    p.state.oreg = 0;
+    p.state.cycles++;
+    p.time = nextTime;
+    p.status = Status::READY;
+    ready.push_back(id);
+  }
+
+  /// Release the partner parked on a channel when processor id completes the
+  /// rendezvous. In hexsim, a partner with a higher id is stepped later in the
+  /// same tick, and one with a lower id in the next tick.
+  void release(unsigned partner, unsigned id) {
+    auto time = procs[id]->time;
+    resume(partner, partner > id ? time : time + 1);
+  }
+
+  void syscall(unsigned id) {
+    auto &p = *procs[id];
+    auto &memory = p.state.memory;
+    unsigned spWordIndex = memory[1];
+    switch (static_cast<hex::Syscall>(p.state.areg)) {
+    case hex::Syscall::EXIT:
+      p.exitCode = memory[spWordIndex + 2];
+      p.status = Status::HALTED;
+      if (!haveExit) {
+        exitCode = p.exitCode;
+        haveExit = true;
+      }
+      return;
+    case hex::Syscall::WRITE:
+      p.io.output(memory[spWordIndex + 2], memory[spWordIndex + 3]);
+      break;
+    case hex::Syscall::READ:
+      memory[spWordIndex + 1] = p.io.input(memory[spWordIndex + 2]) & 0xFF;
+      break;
+    case hex::Syscall::WRITES:
+      p.io.outputString(memory.data(), memory.size(), memory[spWordIndex + 2],
+                        memory[spWordIndex + 3]);
+      break;
+    case hex::Syscall::READS:
+      memory[spWordIndex + 1] = p.io.inputString(
+          memory.data(), memory.size(), memory[spWordIndex + 2],
+          memory[spWordIndex + 3], memory[spWordIndex + 4]);
+      break;
+    case hex::Syscall::WRITEN:
+      p.io.outputWords(memory.data(), memory.size(), memory[spWordIndex + 2],
+                       memory[spWordIndex + 3], memory[spWordIndex + 4]);
+      break;
+    case hex::Syscall::READN:
+      memory[spWordIndex + 1] = p.io.inputWords(
+          memory.data(), memory.size(), memory[spWordIndex + 2],
+          memory[spWordIndex + 3], memory[spWordIndex + 4]);
+      break;
+    default:
+      throw std::runtime_error("invalid syscall: " +
+                               std::to_string(p.state.areg));
+    }
+    resume(id, p.time + 1);
+  }
+
+  /// Copy count words of a block transfer between two processors' memories.
+  void copyBlock(unsigned writer, uint32_t writerAddress, unsigned reader,
+                 uint32_t readerAddress, uint32_t count) {
+    if (count > hex::MAX_MEMORY_SIZE_WORDS ||
+        writerAddress > hex::MAX_MEMORY_SIZE_WORDS - count ||
+        readerAddress > hex::MAX_MEMORY_SIZE_WORDS - count) {
+      throw std::runtime_error("processor " + std::to_string(writer) +
+                               ": block transfer of " + std::to_string(count) +
+                               " words out of bounds");
+    }
+    auto &from = procs[writer]->state.memory;
+    std::copy_n(from.begin() + writerAddress, count,
+                procs[reader]->state.memory.begin() + readerAddress);
+  }
+
+  void channel(unsigned id) {
+    auto &p = *procs[id];
+    unsigned slot = p.state.breg;
+    if (slot >= hex::NUM_LINKS || p.links[slot] < 0) {
+      throw std::runtime_error(
+          "processor " + std::to_string(id) + ": unwired channel slot " +
+          std::to_string(slot) + " at pc " + formatAddress(p.state.pc));
+    }
+    auto &c = channels[p.links[slot]];
+    auto &memory = p.state.memory;
+    bool block = p.event == Event::OUTN || p.event == Event::INN;
+    uint32_t address = block ? memory[memory[1] + 2] : 0;
+    uint32_t count = block ? memory[memory[1] + 3] : 0;
+    if (block && count == 0) {
+      resume(id, p.time + 1);
+      return;
+    }
+    if (c.state != Channel::State::IDLE &&
+        (c.block != block || (block && c.count != count))) {
+      throw std::runtime_error("processor " + std::to_string(id) +
+                               ": mismatched channel transfer on slot " +
+                               std::to_string(slot) + " at pc " +
+                               formatAddress(p.state.pc));
+    }
+    if (p.event == Event::OUT || p.event == Event::OUTN) {
+      if (c.state == Channel::State::READER_WAITING) {
+        if (block) {
+          copyBlock(id, address, c.reader, c.address, count);
+        } else {
+          procs[c.reader]->state.areg = p.state.areg;
+        }
+        release(c.reader, id);
+        c.state = Channel::State::IDLE;
+        resume(id, p.time + 1);
+        return;
+      }
+      c.state = Channel::State::WRITER_WAITING;
+      c.value = p.state.areg;
+      c.writer = id;
+    } else {
+      if (c.state == Channel::State::WRITER_WAITING) {
+        if (block) {
+          copyBlock(c.writer, c.address, id, address, count);
+        } else {
+          p.state.areg = c.value;
+        }
+        release(c.writer, id);
+        c.state = Channel::State::IDLE;
+        resume(id, p.time + 1);
+        return;
+      }
+      c.state = Channel::State::READER_WAITING;
+      c.reader = id;
+    }
+    c.block = block;
+    c.address = address;
+    c.count = count;
+    p.blockedSlot = slot;
+    p.status = Status::BLOCKED;
+  }
+
+  /// Commit the pending event of processor id.
+  void commit(unsigned id) {
+    auto &p = *procs[id];
+    switch (p.event) {
+    case Event::SVC:
+      syscall(id);
+      break;
+    case Event::IN:
+    case Event::OUT:
+    case Event::INN:
+    case Event::OUTN:
+      channel(id);
+      break;
+    case Event::INVALID_OPR:
+      throw std::runtime_error("invalid OPR: " + std::to_string(p.state.oreg));
+    case Event::INVALID_SPI:
+      throw std::runtime_error("invalid SPI: " + std::to_string(p.state.oreg));
+    case Event::INVALID_INSTR:
+      throw std::runtime_error("invalid instruction");
+    case Event::UNTRANSLATED:
+      throw std::runtime_error("processor " + std::to_string(id) +
+                               ": branch to untranslated address " +
+                               formatAddress(p.state.pc));
+    }
+  }
+
+public:
+  System(std::istream &in, std::ostream &out) : in(in), out(out) {}
+
+  /// Add a processor running a translated image, initialising its memory
+  /// with the image's program words.
+  void addProcessor(Entry entry, const uint32_t *program, size_t numWords) {
+    auto p = std::make_unique<Processor>(entry, in, out);
+    std::copy(program, program + numWords, p->state.memory.begin());
+    ready.push_back(static_cast<unsigned>(procs.size()));
+    procs.push_back(std::move(p));
+  }
+
+  /// Connect a channel between two processors' link slots.
+  void connect(unsigned procA, unsigned slotA, unsigned procB,
+               unsigned slotB) {
+    procs[procA]->links[slotA] = static_cast<int>(channels.size());
+    procs[procB]->links[slotB] = static_cast<int>(channels.size());
+    channels.emplace_back();
+  }
+
+  /// Run until all processors halt, returning the exit code of the first
+  /// processor to exit. Throws on deadlock.
+  int run() {
+    while (true) {
+      // Run every ready processor up to its next event.
+      for (auto id : ready) {
+        auto &p = *procs[id];
+        auto cycles = p.state.cycles;
+        p.event = p.entry(p.state);
+        p.time += p.state.cycles - cycles;
+        p.status = Status::PENDING;
+        pending.emplace(p.time, id);
+      }
+      ready.clear();
+      // Commit the earliest event.
+      if (pending.empty()) {
+        break;
+      }
+      auto id = pending.begin()->second;
+      pending.erase(pending.begin());
+      commit(id);
+    }
+    std::string msg;
+    for (size_t i = 0; i < procs.size(); i++) {
+      if (procs[i]->status == Status::BLOCKED) {
+        msg += " processor " + std::to_string(i) +
+               " blocked on channel slot " +
+               std::to_string(procs[i]->blockedSlot) + ";";
+      }
+    }
+    if (!msg.empty()) {
+      throw std::runtime_error("deadlock detected:" + msg);
+    }
+    return exitCode;
+  }
+};
+
+} // End namespace hex2crt
+
+#endif // HEX_2C_RT_HPP
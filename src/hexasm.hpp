@@ -35,11 +35,14 @@
 // instruction    := <opcode> <number>
 //                 | <opcode> <label>
 //                 | "OPR" <opcode>
+//                 | <sp-opcode> <integer-number>
 // operand        := <number>
 //                 | <label>
 // opcode         := "LDAM" | "LDBM" | "STAM" | "LDAC" | "LDBC" | "LDAP"
 //                 | "LDAI" | "LDBI | "STAI" | "BR" | "BRZ" | "BRN" | "BRB"
-//                 | "SVC" | "ADD" | "SUB
+//                 | "SVC" | "ADD" | "SUB" | "IN" | "OUT" | "MUL" | "DIV"
+//                 | "LSH" | "RSH" | "AND" | "OR" | "XOR" | "OUTN" | "INN"
+// sp-opcode      := "LDAS" | "LDBS" | "STAS"
 // identifier     := <alpha> { <aplha> | <digit> | '_' }
 // alpha          := 'a' | 'b' | ... | 'x' | 'A' | 'B' | ... | 'X'
 // digit-not-zero := '1' | '2' | ... | '9'
@@ -83,6 +86,18 @@ enum class Token {
   SUB,
   IN,
   OUT,
+  MUL,
+  DIV,
+  LSH,
+  RSH,
+  AND,
+  OR,
+  XOR,
+  OUTN,
+  INN,
+  LDAS,
+  LDBS,
+  STAS,
   OPR,
   IDENTIFIER,
   END_OF_FILE,
@@ -146,6 +161,30 @@ static const char *tokenEnumStr(Token token) {
     return "IN";
   case Token::OUT:
     return "OUT";
+  case Token::MUL:
+    return "MUL";
+  case Token::DIV:
+    return "DIV";
+  case Token::LSH:
+    return "LSH";
+  case Token::RSH:
+    return "RSH";
+  case Token::AND:
+    return "AND";
+  case Token::OR:
+    return "OR";
+  case Token::XOR:
+    return "XOR";
+  case Token::OUTN:
+    return "OUTN";
+  case Token::INN:
+    return "INN";
+  case Token::LDAS:
+    return "LDAS";
+  case Token::LDBS:
+    return "LDBS";
+  case Token::STAS:
+    return "STAS";
   case Token::OPR:
     return "OPR";
   case Token::IDENTIFIER:
@@ -198,6 +237,10 @@ static hex::Instr tokenToInstr(Token token) {
     return hex::Instr::BRZ;
   case Token::BRN:
     return hex::Instr::BRN;
+  case Token::LDAS:
+  case Token::LDBS:
+  case Token::STAS:
+    return hex::Instr::SPI;
   case Token::OPR:
     return hex::Instr::OPR;
   default:
@@ -220,6 +263,24 @@ static hex::OprInstr tokenToOprInstr(Token token) {
     return hex::OprInstr::IN;
   case Token::OUT:
     return hex::OprInstr::OUT;
+  case Token::MUL:
+    return hex::OprInstr::MUL;
+  case Token::DIV:
+    return hex::OprInstr::DIV;
+  case Token::LSH:
+    return hex::OprInstr::LSH;
+  case Token::RSH:
+    return hex::OprInstr::RSH;
+  case Token::AND:
+    return hex::OprInstr::AND;
+  case Token::OR:
+    return hex::OprInstr::OR;
+  case Token::XOR:
+    return hex::OprInstr::XOR;
+  case Token::OUTN:
+    return hex::OprInstr::OUTN;
+  case Token::INN:
+    return hex::OprInstr::INN;
   default:
     throw std::runtime_error(
         std::string("unexpected operand instrucion token: ") +
@@ -227,8 +288,46 @@ static hex::OprInstr tokenToOprInstr(Token token) {
   }
 }
 
+static hex::SpiInstr tokenToSpiInstr(Token token) {
+  switch (token) {
+  case Token::LDAS:
+    return hex::SpiInstr::LDAS;
+  case Token::LDBS:
+    return hex::SpiInstr::LDBS;
+  case Token::STAS:
+    return hex::SpiInstr::STAS;
+  default:
+    throw std::runtime_error(std::string("unexpected SP instruction token: ") +
+                             tokenEnumStr(token));
+  }
+}
+
 static int instrToInstrOpc(hex::Instr instr) { return static_cast<int>(instr); }
 
+/// Return true if the token is a valid operand to OPR.
+static bool isOprToken(Token token) {
+  switch (token) {
+  case Token::BRB:
+  case Token::SVC:
+  case Token::ADD:
+  case Token::SUB:
+  case Token::IN:
+  case Token::OUT:
+  case Token::MUL:
+  case Token::DIV:
+  case Token::LSH:
+  case Token::RSH:
+  case Token::AND:
+  case Token::OR:
+  case Token::XOR:
+  case Token::OUTN:
+  case Token::INN:
+    return true;
+  default:
+    return false;
+  }
+}
+
 static int tokenToInstrOpc(Token token) {
   return static_cast<int>(tokenToInstr(token));
 }
@@ -328,6 +427,7 @@ public:
       : location(location), token(token), byteOffset(0), assembled(false) {}
   virtual ~Directive() = default;
   const Location &getLocation() const { return location; }
+  void setLocation(const Location &value) { location = value; }
   Token getToken() const { return token; }
   void setByteOffset(unsigned value) {
     assembled = true;
@@ -426,6 +526,25 @@ public:
   }
 };
 
+/// SP-indexed memory access, encoding the access kind in the low bits of the
+/// immediate and the word offset from the stack pointer in the remainder.
+class InstrSpi : public InstrImm {
+  int offset;
+
+public:
+  InstrSpi(Token token, int offset)
+      : InstrImm(token, hex::spiOperand(tokenToSpiInstr(token), offset)),
+        offset(offset) {}
+  InstrSpi(Location location, Token token, int offset)
+      : InstrImm(location, token,
+                 hex::spiOperand(tokenToSpiInstr(token), offset)),
+        offset(offset) {}
+  int getOffset() const { return offset; }
+  std::string toString() const {
+    return std::string(tokenEnumStr(getToken())) + " " + std::to_string(offset);
+  }
+};
+
 class InstrLabel : public Directive {
   std::string label;
   int labelValue;
@@ -461,15 +580,13 @@ class InstrOp : public Directive {
 
 public:
   InstrOp(Token token, Token opcode) : Directive(token), opcode(opcode) {
-    if (opcode != Token::BRB && opcode != Token::ADD && opcode != Token::SUB &&
-        opcode != Token::SVC && opcode != Token::IN && opcode != Token::OUT) {
+    if (!isOprToken(opcode)) {
       throw InvalidOprError(opcode);
     }
   }
   InstrOp(Location location, Token token, Token opcode)
       : Directive(location, token), opcode(opcode) {
-    if (opcode != Token::BRB && opcode != Token::ADD && opcode != Token::SUB &&
-        opcode != Token::SVC && opcode != Token::IN && opcode != Token::OUT) {
+    if (!isOprToken(opcode)) {
       throw InvalidOprError(location, opcode);
     }
   }
@@ -523,27 +640,39 @@ class Lexer : public hexlex::LexerBase<Token> {
 
   void declareKeywords() {
     table.insert("ADD", Token::ADD);
+    table.insert("AND", Token::AND);
     table.insert("BRN", Token::BRN);
     table.insert("BR", Token::BR);
     table.insert("BRB", Token::BRB);
     table.insert("BRZ", Token::BRZ);
     table.insert("DATA", Token::DATA);
+    table.insert("DIV", Token::DIV);
     table.insert("FUNC", Token::FUNC);
     table.insert("IN", Token::IN);
+    table.insert("INN", Token::INN);
     table.insert("LDAC", Token::LDAC);
     table.insert("LDAI", Token::LDAI);
     table.insert("LDAM", Token::LDAM);
     table.insert("LDAP", Token::LDAP);
+    table.insert("LDAS", Token::LDAS);
     table.insert("LDBC", Token::LDBC);
     table.insert("LDBI", Token::LDBI);
     table.insert("LDBM", Token::LDBM);
+    table.insert("LDBS", Token::LDBS);
+    table.insert("LSH", Token::LSH);
+    table.insert("MUL", Token::MUL);
     table.insert("OPR", Token::OPR);
+    table.insert("OR", Token::OR);
     table.insert("OUT", Token::OUT);
+    table.insert("OUTN", Token::OUTN);
     table.insert("PROC", Token::PROC);
+    table.insert("RSH", Token::RSH);
     table.insert("STAI", Token::STAI);
     table.insert("STAM", Token::STAM);
+    table.insert("STAS", Token::STAS);
     table.insert("SUB", Token::SUB);
     table.insert("SVC", Token::SVC);
+    table.insert("XOR", Token::XOR);
   }
 
   Token readToken() override {
@@ -684,6 +813,13 @@ class Parser {
         return std::make_unique<InstrImm>(location, opcode, parseInteger());
       }
     }
+    case Token::LDAS:
+    case Token::LDBS:
+    case Token::STAS: {
+      auto opcode = lexer.getLastToken();
+      lexer.getNextToken();
+      return std::make_unique<InstrSpi>(location, opcode, parseInteger());
+    }
     case Token::PROLOGUE:
     case Token::EPILOGUE:
     case Token::LDAI_FB:
@@ -715,8 +851,17 @@ class CodeGen {
   std::vector<std::unique_ptr<Directive>> &program;
   std::map<std::string, Label *> labelMap;
   std::vector<std::pair<std::string, unsigned>> debugInfo;
+  std::vector<heximage::Line> lineInfo;
   size_t programSizeBytes;
 
+  /// Record the source line of the code from a byte offset, merging it with
+  /// the code before it if they share a line.
+  void recordLine(unsigned byteOffset, size_t line) {
+    if (lineInfo.empty() ? line != 0 : lineInfo.back().line != line) {
+      lineInfo.push_back({byteOffset, static_cast<uint32_t>(line)});
+    }
+  }
+
   /// Create a map of label strings to label Directives.
   void createLabelMap() {
     for (auto &directive : program) {
@@ -840,11 +985,13 @@ public:
                            paddingBytes);
           byteOffset += paddingBytes;
         }
+        recordLine(byteOffset, 0);
         auto value = directive->getValue();
         outputFile.write(reinterpret_cast<const char *>(&value), size);
         byteOffset += size;
         // Instruction
       } else if (size > 0) {
+        recordLine(byteOffset, directive->getLocation().getLineNumber());
         if (size > 1) {
           // Output PFIX/NFIX to extend the immediate value.
           hex::Instr instr =
@@ -879,6 +1026,9 @@ public:
       symbols.push_back({pair.first, static_cast<uint32_t>(pair.second)});
     }
     heximage::writeSymbols(outputFile, symbols);
+    if (!lineInfo.empty()) {
+      heximage::writeLines(outputFile, lineInfo);
+    }
   }
 
   /// Emit a complete image (size-word + program + debug info) to a stream.
@@ -0,0 +1,638 @@
+#ifndef HEX_BENCH_HPP
+#define HEX_BENCH_HPP
+
+#include <cstdint>
+#include <fmt/format.h>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//===---------------------------------------------------------------------===//
+// Generators of X programs for networks of a parameterised size, to measure
+// how the simulator scales with the number of processors. Each benchmark
+// passes a number of messages along every channel with a configurable amount
+// of computation per message, and prints a checksum that is known in advance
+// so a run can be checked.
+//===---------------------------------------------------------------------===//
+
+namespace hexbench {
+
+/// The shape of a benchmark network.
+enum class Topology { RING, PIPELINE, TREE, FARM, STENCIL };
+
+inline const std::vector<Topology> &allTopologies() {
+  static const std::vector<Topology> all = {Topology::RING, Topology::PIPELINE,
+                                            Topology::TREE, Topology::FARM,
+                                            Topology::STENCIL};
+  return all;
+}
+
+inline const char *topologyName(Topology topology) {
+  switch (topology) {
+  case Topology::RING:
+    return "ring";
+  case Topology::PIPELINE:
+    return "pipeline";
+  case Topology::TREE:
+    return "tree";
+  case Topology::FARM:
+    return "farm";
+  case Topology::STENCIL:
+    return "stencil";
+  }
+  return "?";
+}
+
+inline Topology parseTopology(const std::string &name) {
+  for (auto topology : allTopologies()) {
+    if (name == topologyName(topology)) {
+      return topology;
+    }
+  }
+  throw std::runtime_error("unknown topology: " + name);
+}
+
+/// The parameters of a benchmark.
+struct Params {
+  Topology topology = Topology::RING;
+  unsigned procs = 2;       // processors in the network (at least 2)
+  unsigned messages = 100;  // messages each processor sends or receives
+  unsigned compute = 10;    // loop iterations of work per message
+};
+
+/// Return the width of the grid of a stencil of n processors: the largest
+/// divisor of n no greater than its square root.
+inline unsigned stencilWidth(unsigned n) {
+  unsigned width = 1;
+  for (unsigned d = 1; d * d <= n; d++) {
+    if (n % d == 0) {
+      width = d;
+    }
+  }
+  return width;
+}
+
+/// Return the checksum a benchmark prints: a sum over the messages, in 32-bit
+/// arithmetic as the programs compute it, modulo 65536.
+inline unsigned checksum(const Params &p) {
+  uint32_t m = p.messages;
+  uint32_t n = p.procs;
+  uint32_t sum = 0;
+  switch (p.topology) {
+  case Topology::RING:
+    // The token gains one at each forwarder on each lap.
+    sum = m * (n - 1);
+    break;
+  case Topology::PIPELINE:
+    // Each value gains one at each stage.
+    for (uint32_t i = 0; i < m; i++) {
+      sum += i + (n - 2);
+    }
+    break;
+  case Topology::TREE:
+    // Each node adds one to the sum of its children.
+    sum = m * n;
+    break;
+  case Topology::FARM:
+    // Each task is doubled.
+    for (uint32_t t = 0; t < m * (n - 1); t++) {
+      sum += t + t;
+    }
+    break;
+  case Topology::STENCIL: {
+    // Each cell adds one to the sum of its west and north neighbours.
+    unsigned width = stencilWidth(n);
+    unsigned height = n / width;
+    std::vector<uint32_t> v(n);
+    for (unsigned y = 0; y < height; y++) {
+      for (unsigned x = 0; x < width; x++) {
+        uint32_t w = x > 0 ? v[y * width + x - 1] : 0;
+        uint32_t north = y > 0 ? v[(y - 1) * width + x] : 0;
+        v[y * width + x] = w + north + 1;
+      }
+    }
+    sum = m * v.back();
+    break;
+  }
+  }
+  return sum & 0xFFFF;
+}
+
+namespace detail {
+
+/// Return the declarations every benchmark shares: its parameters, output
+/// of a number, and the work done per message.
+inline std::string prelude(const Params &p) {
+  return fmt::format(
+      "| Benchmark network: {} of {} processors, {} messages with {} "
+      "iterations\n"
+      "| of work each. Prints a checksum of the messages.\n"
+      "\n"
+      "val put = 1;\n"
+      "val messages = {};\n"
+      "val compute = {};\n"
+      "{}"
+      "var div_x;\n"
+      "\n"
+      "proc putval(val c) is put(c, 0)\n"
+      "\n"
+      "func lsu(val x, val y) is\n"
+      "  if (x < 0) = (y < 0)\n"
+      "  then\n"
+      "    return x < y\n"
+      "  else\n"
+      "    return y < 0\n"
+      "\n"
+      "func div_step(val b, val y) is\n"
+      "  var r;\n"
+      "{{ if (y < 0) or (~lsu(y, div_x))\n"
+      "  then\n"
+      "    r := 0\n"
+      "  else\n"
+      "    r := div_step(b + b, y + y);\n"
+      "  if ~lsu(div_x, y)\n"
+      "  then\n"
+      "  {{ div_x := div_x - y;\n"
+      "    r := r + b\n"
+      "  }}\n"
+      "  else\n"
+      "    skip;\n"
+      "  return r\n"
+      "}}\n"
+      "\n"
+      "func div(val n, val m) is\n"
+      "{{ div_x := n;\n"
+      "  if lsu(n, m)\n"
+      "  then\n"
+      "    return 0\n"
+      "  else\n"
+      "    return div_step(1, m)\n"
+      "}}\n"
+      "\n"
+      "func rem(val n, val m) is\n"
+      "  var x;\n"
+      "{{ x := div(n, m);\n"
+      "  return div_x\n"
+      "}}\n"
+      "\n"
+      "proc printn(val n) is\n"
+      "{{ if n > 9\n"
+      "  then\n"
+      "    printn(div(n, 10))\n"
+      "  else skip;\n"
+      "  putval(rem(n, 10) + '0')\n"
+      "}}\n"
+      "\n"
+      "| Print a checksum.\n"
+      "proc report(val sum) is\n"
+      "{{ printn(rem(sum, 65536));\n"
+      "  putval('\\n')\n"
+      "}}\n"
+      "\n"
+      "| The computation done for each message.\n"
+      "proc work() is\n"
+      "  var i;\n"
+      "{{ i := 0;\n"
+      "  while i < compute do\n"
+      "    i := i + 1\n"
+      "}}\n",
+      topologyName(p.topology), p.procs, p.messages, p.compute, p.messages,
+      p.compute,
+      p.topology == Topology::FARM
+          ? fmt::format("val workers = {};\n", p.procs - 1)
+          : "");
+}
+
+/// Return a main proc declaring channels and running branches in parallel.
+inline std::string mainProc(const std::vector<std::string> &channels,
+                            const std::vector<std::string> &branches) {
+  std::string text = "\nproc main() is\n";
+  for (auto &c : channels) {
+    text += fmt::format("  chan {};\n", c);
+  }
+  text += "  par\n";
+  for (size_t i = 0; i < branches.size(); i++) {
+    text += fmt::format("  {} {}{}\n", i == 0 ? "{" : " ", branches[i],
+                        i + 1 < branches.size() ? ";" : "");
+  }
+  text += "  }\n";
+  return text;
+}
+
+/// A token passed round a ring: the starter injects it and each forwarder
+/// adds one.
+inline std::string ring(const Params &p) {
+  std::string text = R"(
+proc starter(chan out, chan in) is
+  var i;
+  var v;
+{ i := 0;
+  v := 0;
+  while i < messages do
+  { work();
+    out ! v;
+    in ? v;
+    i := i + 1
+  };
+  report(v)
+}
+
+proc forwarder(chan in, chan out) is
+  var i;
+  var v;
+{ i := 0;
+  while i < messages do
+  { in ? v;
+    work();
+    out ! v + 1;
+    i := i + 1
+  }
+}
+)";
+  std::vector<std::string> channels, branches;
+  for (unsigned i = 0; i < p.procs; i++) {
+    channels.push_back(fmt::format("c{}", i));
+  }
+  branches.push_back(fmt::format("starter(c0, c{})", p.procs - 1));
+  for (unsigned i = 1; i < p.procs; i++) {
+    branches.push_back(fmt::format("forwarder(c{}, c{})", i - 1, i));
+  }
+  return text + mainProc(channels, branches);
+}
+
+/// A linear pipeline: a source, stages that each add one, and a sink that
+/// sums what arrives.
+inline std::string pipeline(const Params &p) {
+  std::string text = R"(
+proc source(chan out) is
+  var i;
+{ i := 0;
+  while i < messages do
+  { work();
+    out ! i;
+    i := i + 1
+  }
+}
+
+proc stage(chan in, chan out) is
+  var i;
+  var v;
+{ i := 0;
+  while i < messages do
+  { in ? v;
+    work();
+    out ! v + 1;
+    i := i + 1
+  }
+}
+
+proc sink(chan in) is
+  var i;
+  var v;
+  var sum;
+{ i := 0;
+  sum := 0;
+  while i < messages do
+  { in ? v;
+    work();
+    sum := sum + v;
+    i := i + 1
+  };
+  report(sum)
+}
+)";
+  std::vector<std::string> channels, branches;
+  for (unsigned i = 0; i + 1 < p.procs; i++) {
+    channels.push_back(fmt::format("c{}", i));
+  }
+  branches.push_back("source(c0)");
+  for (unsigned i = 1; i + 1 < p.procs; i++) {
+    branches.push_back(fmt::format("stage(c{}, c{})", i - 1, i));
+  }
+  branches.push_back(fmt::format("sink(c{})", p.procs - 2));
+  return text + mainProc(channels, branches);
+}
+
+/// A binary reduction tree, numbered as a heap: each node sends its parent
+/// one more than the sum of its children, and the root sums what it
+/// computes.
+inline std::string tree(const Params &p) {
+  // The procs for a node with each number of children, at the root or not.
+  const char *procs[2][3] = {{R"(
+proc leaf(chan up) is
+  var i;
+{ i := 0;
+  while i < messages do
+  { work();
+    up ! 1;
+    i := i + 1
+  }
+}
+)",
+                              R"(
+proc node1(chan a, chan up) is
+  var i;
+  var x;
+{ i := 0;
+  while i < messages do
+  { a ? x;
+    work();
+    up ! x + 1;
+    i := i + 1
+  }
+}
+)",
+                              R"(
+proc node2(chan a, chan b, chan up) is
+  var i;
+  var x;
+  var y;
+{ i := 0;
+  while i < messages do
+  { a ? x;
+    b ? y;
+    work();
+    up ! (x + y) + 1;
+    i := i + 1
+  }
+}
+)"},
+                             {"", R"(
+proc root1(chan a) is
+  var i;
+  var x;
+  var sum;
+{ i := 0;
+  sum := 0;
+  while i < messages do
+  { a ? x;
+    work();
+    sum := sum + (x + 1);
+    i := i + 1
+  };
+  report(sum)
+}
+)",
+                              R"(
+proc root2(chan a, chan b) is
+  var i;
+  var x;
+  var y;
+  var sum;
+{ i := 0;
+  sum := 0;
+  while i < messages do
+  { a ? x;
+    b ? y;
+    work();
+    sum := sum + ((x + y) + 1);
+    i := i + 1
+  };
+  report(sum)
+}
+)"}};
+  const char *names[2][3] = {{"leaf", "node1", "node2"},
+                             {"", "root1", "root2"}};
+  std::set<std::pair<unsigned, unsigned>> used;
+  std::vector<std::string> channels, branches;
+  for (unsigned i = 1; i < p.procs; i++) {
+    channels.push_back(fmt::format("u{}", i));
+  }
+  for (unsigned i = 0; i < p.procs; i++) {
+    std::vector<std::string> args;
+    for (unsigned child : {2 * i + 1, 2 * i + 2}) {
+      if (child < p.procs) {
+        args.push_back(fmt::format("u{}", child));
+      }
+    }
+    unsigned children = static_cast<unsigned>(args.size());
+    unsigned root = i == 0 ? 1 : 0;
+    if (!root) {
+      args.push_back(fmt::format("u{}", i));
+    }
+    used.insert({root, children});
+    branches.push_back(
+        fmt::format("{}({})", names[root][children], fmt::join(args, ", ")));
+  }
+  std::string text;
+  for (auto &[root, children] : used) {
+    text += procs[root][children];
+  }
+  return text + mainProc(channels, branches);
+}
+
+/// A farm of workers on a chain: each round, the master sends the count of
+/// tasks and then the tasks down the chain, each worker keeps the first that
+/// reaches it and passes the rest on, and the results, each task doubled,
+/// return up the chain to the master, which sums them.
+inline std::string farm(const Params &p) {
+  std::string text = R"(
+proc master(chan down, chan up) is
+  var i;
+  var k;
+  var t;
+  var r;
+  var sum;
+{ i := 0;
+  t := 0;
+  sum := 0;
+  while i < messages do
+  { down ! workers;
+    k := 0;
+    while k < workers do
+    { down ! t;
+      t := t + 1;
+      k := k + 1
+    };
+    k := 0;
+    while k < workers do
+    { up ? r;
+      sum := sum + r;
+      k := k + 1
+    };
+    i := i + 1
+  };
+  report(sum)
+}
+
+proc worker(chan in, chan up, chan down, chan back) is
+  var i;
+  var k;
+  var c;
+  var t;
+  var r;
+{ i := 0;
+  while i < messages do
+  { in ? c;
+    in ? t;
+    down ! c - 1;
+    k := 1;
+    while k < c do
+    { in ? r;
+      down ! r;
+      k := k + 1
+    };
+    work();
+    up ! t + t;
+    k := 1;
+    while k < c do
+    { back ? r;
+      up ! r;
+      k := k + 1
+    };
+    i := i + 1
+  }
+}
+
+proc lastworker(chan in, chan up) is
+  var i;
+  var c;
+  var t;
+{ i := 0;
+  while i < messages do
+  { in ? c;
+    in ? t;
+    work();
+    up ! t + t;
+    i := i + 1
+  }
+}
+)";
+  std::vector<std::string> channels, branches;
+  for (unsigned k = 1; k < p.procs; k++) {
+    channels.push_back(fmt::format("t{}", k));
+    channels.push_back(fmt::format("r{}", k));
+  }
+  branches.push_back("master(t1, r1)");
+  for (unsigned k = 1; k + 1 < p.procs; k++) {
+    branches.push_back(fmt::format("worker(t{}, r{}, t{}, r{})", k, k, k + 1,
+                                   k + 1));
+  }
+  branches.push_back(
+      fmt::format("lastworker(t{0}, r{0})", p.procs - 1));
+  return text + mainProc(channels, branches);
+}
+
+/// A 2D wavefront stencil on a grid: each cell receives from its west and
+/// north neighbours, sends one more than their sum east and south, and the
+/// last cell sums what it computes.
+inline std::string stencil(const Params &p) {
+  unsigned width = stencilWidth(p.procs);
+  unsigned height = p.procs / width;
+  std::set<std::string> defined;
+  std::string text;
+  std::vector<std::string> channels, branches;
+  for (unsigned y = 0; y < height; y++) {
+    for (unsigned x = 0; x < width; x++) {
+      if (x + 1 < width) {
+        channels.push_back(fmt::format("e{}_{}", x, y));
+      }
+      if (y + 1 < height) {
+        channels.push_back(fmt::format("s{}_{}", x, y));
+      }
+    }
+  }
+  for (unsigned y = 0; y < height; y++) {
+    for (unsigned x = 0; x < width; x++) {
+      bool w = x > 0, n = y > 0, e = x + 1 < width, s = y + 1 < height;
+      bool last = !e && !s;
+      std::string name = fmt::format("cell_{}{}{}{}", w ? "w" : "",
+                                     n ? "n" : "", e ? "e" : "", s ? "s" : "");
+      std::vector<std::string> params, args;
+      if (w) {
+        params.push_back("chan w");
+        args.push_back(fmt::format("e{}_{}", x - 1, y));
+      }
+      if (n) {
+        params.push_back("chan n");
+        args.push_back(fmt::format("s{}_{}", x, y - 1));
+      }
+      if (e) {
+        params.push_back("chan e");
+        args.push_back(fmt::format("e{}_{}", x, y));
+      }
+      if (s) {
+        params.push_back("chan s");
+        args.push_back(fmt::format("s{}_{}", x, y));
+      }
+      branches.push_back(fmt::format("{}({})", name, fmt::join(args, ", ")));
+      if (!defined.insert(name).second) {
+        continue;
+      }
+      text += fmt::format("\nproc {}({}) is\n"
+                          "  var i;\n"
+                          "  var a;\n"
+                          "  var b;\n"
+                          "  var v;\n"
+                          "{}"
+                          "{{ i := 0;\n"
+                          "  a := 0;\n"
+                          "  b := 0;\n"
+                          "{}"
+                          "  while i < messages do\n"
+                          "  {{ ",
+                          name, fmt::join(params, ", "),
+                          last ? "  var sum;\n" : "",
+                          last ? "  sum := 0;\n" : "");
+      if (w) {
+        text += "w ? a;\n    ";
+      }
+      if (n) {
+        text += "n ? b;\n    ";
+      }
+      text += "work();\n"
+              "    v := (a + b) + 1;\n";
+      if (e) {
+        text += "    e ! v;\n";
+      }
+      if (s) {
+        text += "    s ! v;\n";
+      }
+      if (last) {
+        text += "    sum := sum + v;\n";
+      }
+      text += "    i := i + 1\n  }";
+      text += last ? ";\n  report(sum)\n}\n" : "\n}\n";
+    }
+  }
+  return text + mainProc(channels, branches);
+}
+
+} // namespace detail
+
+/// Return the X source of a benchmark.
+inline std::string generate(const Params &p) {
+  if (p.procs < 2) {
+    throw std::runtime_error("a benchmark network needs at least 2 "
+                             "processors");
+  }
+  std::string body;
+  switch (p.topology) {
+  case Topology::RING:
+    body = detail::ring(p);
+    break;
+  case Topology::PIPELINE:
+    body = detail::pipeline(p);
+    break;
+  case Topology::TREE:
+    body = detail::tree(p);
+    break;
+  case Topology::FARM:
+    body = detail::farm(p);
+    break;
+  case Topology::STENCIL:
+    body = detail::stencil(p);
+    break;
+  }
+  return detail::prelude(p) + body;
+}
+
+/// Return the output a benchmark prints.
+inline std::string expectedOutput(const Params &p) {
+  return fmt::format("{}\n", checksum(p));
+}
+
+} // namespace hexbench
+
+#endif // HEX_BENCH_HPP
@@ -0,0 +1,225 @@
+#ifndef HEX_COMPRESS_HPP
+#define HEX_COMPRESS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//===---------------------------------------------------------------------===//
+// A small LZ-style codec for the code of images, which is mostly zero words
+// and short repeated instruction sequences. It is simple enough to decompress
+// straight into a processor's memory as the compressed bytes are read.
+//
+// A compressed stream is a varint of the uncompressed size in bytes, then a
+// sequence of operations, each a tag byte holding the operation in its top
+// two bits and a length n in its low six (an n of 63 is followed by a varint
+// to add to it):
+//   0 literal: n + 1 bytes follow, to copy
+//   1 zeros:   write (n + 1) * 4 zero bytes
+//   2 match:   a varint distance d follows; copy n + 4 bytes from d bytes
+//              before the end of the output, which they may overlap
+// Varints are little-endian base 128.
+//===---------------------------------------------------------------------===//
+
+namespace hexcompress {
+
+enum Op : uint8_t { LITERAL = 0, ZEROS = 1, MATCH = 2 };
+
+constexpr unsigned MIN_MATCH = 4;
+constexpr unsigned TAG_LENGTH_MAX = 63;
+constexpr unsigned HASH_BITS = 14;
+
+namespace detail {
+
+inline void appendVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+/// Append an operation's tag, with a varint for a long length.
+inline void appendTag(std::string &out, Op op, size_t n) {
+  if (n < TAG_LENGTH_MAX) {
+    out += static_cast<char>((op << 6) | n);
+  } else {
+    out += static_cast<char>((op << 6) | TAG_LENGTH_MAX);
+    appendVarint(out, n - TAG_LENGTH_MAX);
+  }
+}
+
+inline void appendLiterals(std::string &out, std::string_view bytes) {
+  if (!bytes.empty()) {
+    appendTag(out, LITERAL, bytes.size() - 1);
+    out.append(bytes);
+  }
+}
+
+inline uint32_t load32(const char *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(uint32_t));
+  return value;
+}
+
+inline uint32_t hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/// Reads the fields of a compressed stream, checking each lies within it.
+class Reader {
+  std::string_view in;
+  size_t at = 0;
+
+public:
+  explicit Reader(std::string_view in) : in(in) {}
+  bool done() const { return at == in.size(); }
+  uint8_t byte() {
+    if (at == in.size()) {
+      throw std::runtime_error("truncated compressed image");
+    }
+    return static_cast<uint8_t>(in[at++]);
+  }
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      uint8_t b = byte();
+      value |= uint64_t(b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        return value;
+      }
+    }
+    throw std::runtime_error("corrupt compressed image");
+  }
+  std::string_view bytes(size_t n) {
+    if (in.size() - at < n) {
+      throw std::runtime_error("truncated compressed image");
+    }
+    auto view = in.substr(at, n);
+    at += n;
+    return view;
+  }
+};
+
+} // namespace detail
+
+/// Compress bytes, encoding runs of zero words and repeats of earlier
+/// sequences, found greedily through a hash of the four bytes at each
+/// position.
+inline std::string compress(std::string_view in) {
+  std::string out;
+  detail::appendVarint(out, in.size());
+  std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0); // position + 1
+  size_t literal = 0; // start of the pending literals
+  size_t at = 0;
+  while (at + MIN_MATCH <= in.size()) {
+    const char *p = in.data() + at;
+    uint32_t word = detail::load32(p);
+    if (word == 0) {
+      size_t end = at + 4;
+      while (end + 4 <= in.size() && detail::load32(in.data() + end) == 0) {
+        end += 4;
+      }
+      detail::appendLiterals(out, in.substr(literal, at - literal));
+      detail::appendTag(out, ZEROS, (end - at) / 4 - 1);
+      at = literal = end;
+      continue;
+    }
+    auto &slot = table[detail::hash(word)];
+    size_t candidate = slot;
+    slot = static_cast<uint32_t>(at + 1);
+    if (candidate == 0 || detail::load32(in.data() + candidate - 1) != word) {
+      at++;
+      continue;
+    }
+    size_t from = candidate - 1;
+    size_t length = MIN_MATCH;
+    while (at + length < in.size() && in[from + length] == in[at + length]) {
+      length++;
+    }
+    detail::appendLiterals(out, in.substr(literal, at - literal));
+    detail::appendTag(out, MATCH, length - MIN_MATCH);
+    detail::appendVarint(out, at - from);
+    at = literal = at + length;
+  }
+  detail::appendLiterals(out, in.substr(literal));
+  return out;
+}
+
+/// Return the uncompressed size of a compressed stream.
+inline size_t uncompressedSize(std::string_view in) {
+  return detail::Reader(in).varint();
+}
+
+/// Decompress a stream into out, which has room for capacity bytes, writing
+/// each operation's bytes as it is read. Returns the number of bytes written.
+inline size_t decompress(std::string_view in, char *out, size_t capacity) {
+  detail::Reader reader(in);
+  uint64_t size = reader.varint();
+  if (size > capacity) {
+    throw std::runtime_error("image does not fit in memory");
+  }
+  size_t at = 0;
+  while (at < size) {
+    uint8_t tag = reader.byte();
+    uint64_t n = tag & TAG_LENGTH_MAX;
+    if (n == TAG_LENGTH_MAX) {
+      n += reader.varint();
+    }
+    uint64_t length = 0;
+    switch (tag >> 6) {
+    case LITERAL:
+      length = n + 1;
+      if (length > size - at) {
+        throw std::runtime_error("corrupt compressed image");
+      }
+      std::memcpy(out + at, reader.bytes(length).data(), length);
+      break;
+    case ZEROS:
+      length = (n + 1) * 4;
+      if (n > size || length > size - at) {
+        throw std::runtime_error("corrupt compressed image");
+      }
+      std::memset(out + at, 0, length);
+      break;
+    case MATCH: {
+      length = n + MIN_MATCH;
+      uint64_t distance = reader.varint();
+      if (distance == 0 || distance > at || length > size - at) {
+        throw std::runtime_error("corrupt compressed image");
+      }
+      // An overlapping match repeats the bytes it has just written.
+      const char *from = out + at - distance;
+      if (distance >= length) {
+        std::memcpy(out + at, from, length);
+      } else {
+        for (uint64_t i = 0; i < length; i++) {
+          out[at + i] = from[i];
+        }
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("corrupt compressed image");
+    }
+    at += length;
+  }
+  if (!reader.done()) {
+    throw std::runtime_error("corrupt compressed image");
+  }
+  return at;
+}
+
+/// Decompress a stream into a new buffer.
+inline std::string decompress(std::string_view in) {
+  std::string out(uncompressedSize(in), '\0');
+  decompress(in, out.data(), out.size());
+  return out;
+}
+
+} // namespace hexcompress
+
+#endif // HEX_COMPRESS_HPP
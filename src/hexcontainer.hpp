@@ -2,85 +2,555 @@
 #define HEX_CONTAINER_HPP
 
 #include <cstdint>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
+#include "hexcompress.hpp"
 #include "heximage.hpp"
 
 //===---------------------------------------------------------------------===//
-// Reader for the HEXN network container format, shared by the C++ simulator
-// (hexsim) and the Verilator testbench (hextb) so they cannot drift.
+// Reader and writer for the HEXN network container format, shared by the C++
+// simulator (hexsim), the compiler (xcmp) and the Verilator testbench (hextb)
+// so they cannot drift.
 //
-// Layout (little-endian):
+// Version 2 layout (little-endian), which the writer produces:
+//   uint32 magic = 0x4E584548 ("HEXN")
+//   uint32 version = 0x80000002 (a processor count no v1 container can hold)
+//   uint32 numSections
+//   uint32 reserved = 0
+//   sections[numSections]: uint32 kind, flags, offset, size, locating each
+//     section from the start of the file. Each section starts on a 16-byte
+//     boundary, and the code section on a page. Readers skip unknown kinds.
+//     The only flag is compressed (1), which the code section may have.
+//   network section (kind 1):
+//     uint32 numImages
+//     images[numImages]: uint32 programWords, codeOffset, codeBytes,
+//       symbolsOffset, symbolsBytes, each offset into its section.
+//     uint32 numProcessors
+//     uint32 image[numProcessors]: the image each processor runs, so that
+//       processors running identical images share one entry.
+//     uint32 numEdges
+//     edges[numEdges]: uint32 procA, slotA, procB, slotB
+//   code section (kind 2): the code and data words of each image, each
+//     starting on a page so that it can be mapped directly. In a compressed
+//     code section, each is instead a hexcompress stream, and they are
+//     packed.
+//   symbols section (kind 3): the debug-info block of each image, including
+//     its line table. Kind 4 is not used.
+//   channel names section (kind 5): names[numEdges]: uint32 length, then
+//     length bytes of the source-level name of the channel on each edge.
+//   placement section (kind 6): uint32 width, height, torus (1 for a torus, 0
+//     for a mesh), then nodes[numProcessors]: the row-major node of each
+//     processor.
+//
+// Version 1 layout, which is still read:
 //   uint32 magic = 0x4E584548 ("HEXN")
 //   uint32 numProcessors
 //   uint32 numEdges
 //   edges[numEdges]: uint32 procA, slotA, procB, slotB
 //   images[numProcessors]: uint32 imageSizeBytes, then imageSizeBytes of a
 //     standard single-image binary (size-word + code + debug info).
+//   optional sections, each starting with its magic:
+//     channel names: uint32 namesMagic = 0x4D4E5848 ("HXNM"), then the names
+//       as in version 2.
+//     placement: uint32 placementMagic = 0x504E5848 ("HXNP"), then the
+//       placement as in version 2.
 //
 // A file without the magic is treated as a single plain image.
+//
+// A container is read from a read-only mapping of the file, and the images of
+// a mapped container are views of the mapping, so a loader can copy (or
+// decompress) each straight into a processor's memory.
 //===---------------------------------------------------------------------===//
 
 namespace hexcontainer {
 
-constexpr uint32_t MAGIC = 0x4E584548; // "HEXN"
+constexpr uint32_t MAGIC = 0x4E584548;           // "HEXN"
+constexpr uint32_t NAMES_MAGIC = 0x4D4E5848;     // "HXNM"
+constexpr uint32_t PLACEMENT_MAGIC = 0x504E5848; // "HXNP"
+constexpr uint32_t VERSION_2 = 0x80000002;
+
+/// The kinds of the sections of a version 2 container.
+enum class Section : uint32_t {
+  NETWORK = 1,
+  CODE = 2,
+  SYMBOLS = 3,
+  NAMES = 5,
+  PLACEMENT = 6
+};
+
+/// The flags of a section.
+constexpr uint32_t SECTION_COMPRESSED = 1;
+
+constexpr uint32_t SECTION_ALIGN = 16;
+constexpr uint32_t CODE_ALIGN = 4096;
 
 struct Edge {
   uint32_t procA, slotA, procB, slotB;
 };
 
+/// The placement of the processors onto the nodes of a width x height mesh or
+/// torus (width 0 if there is none).
+struct Placement {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool torus = false;
+  std::vector<uint32_t> nodes; // per-processor node, numbered row-major
+};
+
 struct Container {
   bool isNetwork = false;                // false => single plain image
   std::vector<Edge> edges;               // channel wiring (network only)
   std::vector<std::vector<char>> images; // per-processor image bytes
+  std::vector<std::string> channelNames; // per-edge names (empty if absent)
+  Placement placement;
+  bool compressed = false; // write the code compressed
 };
 
 using heximage::readU32;
+using heximage::writeU32;
 
-/// Read a container file. If it lacks the HEXN magic, returns a single-image
-/// container (isNetwork = false, one image holding the whole file).
-inline Container read(const std::string &filename) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
-    throw std::runtime_error("could not open file: " + filename);
+/// A read-only, private memory mapping of a whole file.
+class MappedFile {
+  const char *base = nullptr;
+  size_t length = 0;
+
+public:
+  explicit MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("could not open file: " + filename);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      throw std::runtime_error("could not read file: " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    void *mapping = nullptr;
+    if (length > 0) {
+      mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("could not map file: " + filename);
+    }
+    base = static_cast<const char *>(mapping);
+  }
+  ~MappedFile() {
+    if (base) {
+      munmap(const_cast<char *>(base), length);
+    }
   }
-  file.seekg(0, std::ios::end);
-  auto fileSize = static_cast<size_t>(file.tellg());
-  file.seekg(0, std::ios::beg);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
 
-  Container container;
-  uint32_t magic = readU32(file);
-  if (magic != MAGIC) {
+  std::string_view bytes() const { return {base, length}; }
+};
+
+/// The parts of an image: the number of its code and data words, as its size
+/// word gives it, the bytes of them present (or a hexcompress stream of them),
+/// and its debug-info block.
+struct ImageView {
+  uint32_t programWords = 0;
+  std::string_view code;
+  std::string_view symbols;
+  bool compressed = false;
+};
+
+/// Copy or decompress an image's code into memory with room for capacity
+/// bytes. Returns the number of bytes written.
+inline size_t loadCode(const ImageView &image, char *memory,
+                       size_t capacity) {
+  if (image.compressed) {
+    return hexcompress::decompress(image.code, memory, capacity);
+  }
+  if (image.code.size() > capacity) {
+    throw std::runtime_error("image does not fit in memory");
+  }
+  std::memcpy(memory, image.code.data(), image.code.size());
+  return image.code.size();
+}
+
+/// Split a single-image binary into its parts. A truncated image (as a failed
+/// compilation may leave) has fewer code bytes than its size word gives.
+inline ImageView splitImage(std::string_view image) {
+  if (image.size() < sizeof(uint32_t)) {
+    throw std::runtime_error("truncated image");
+  }
+  ImageView view;
+  std::memcpy(&view.programWords, image.data(), sizeof(uint32_t));
+  view.code = image.substr(sizeof(uint32_t), size_t(view.programWords) * 4);
+  view.symbols = image.substr(sizeof(uint32_t) + view.code.size());
+  return view;
+}
+
+/// Join the parts of an image back into a single-image binary, decompressing
+/// its code.
+inline std::vector<char> joinImage(const ImageView &image) {
+  std::vector<char> bytes(sizeof(uint32_t));
+  std::memcpy(bytes.data(), &image.programWords, sizeof(uint32_t));
+  if (image.compressed) {
+    size_t programBytes = size_t(image.programWords) * 4;
+    bytes.resize(bytes.size() + programBytes);
+    auto size = loadCode(image, bytes.data() + sizeof(uint32_t), programBytes);
+    bytes.resize(sizeof(uint32_t) + size);
+  } else {
+    bytes.insert(bytes.end(), image.code.begin(), image.code.end());
+  }
+  bytes.insert(bytes.end(), image.symbols.begin(), image.symbols.end());
+  return bytes;
+}
+
+/// A container whose images are views of a mapped file, which the container
+/// keeps alive. Processors running identical images may share an entry.
+struct MappedContainer {
+  bool isNetwork = false;
+  uint32_t version = 1;
+  std::vector<Edge> edges;
+  std::vector<ImageView> images;  // distinct images
+  std::vector<uint32_t> imageOf;  // per-processor index into images
+  std::vector<std::string> channelNames;
+  Placement placement;
+  bool compressed = false;
+  std::shared_ptr<const MappedFile> file;
+
+  size_t numProcessors() const { return imageOf.size(); }
+  const ImageView &imageOfProcessor(size_t i) const {
+    return images[imageOf[i]];
+  }
+};
+
+/// Reads the fields of a container from its bytes, checking each lies within
+/// them.
+class Cursor {
+  std::string_view data;
+  size_t at = 0;
+
+public:
+  explicit Cursor(std::string_view data) : data(data) {}
+  size_t remaining() const { return data.size() - at; }
+  std::string_view bytes(size_t n) {
+    if (remaining() < n) {
+      throw std::runtime_error("truncated network container");
+    }
+    auto view = data.substr(at, n);
+    at += n;
+    return view;
+  }
+  uint32_t u32() {
+    uint32_t value;
+    std::memcpy(&value, bytes(sizeof(uint32_t)).data(), sizeof(uint32_t));
+    return value;
+  }
+  /// Read a count of items of at least itemBytes each, checking they fit.
+  uint32_t count(size_t itemBytes) {
+    auto n = u32();
+    if (n > remaining() / itemBytes) {
+      throw std::runtime_error("truncated network container");
+    }
+    return n;
+  }
+};
+
+/// Read the edges, checking each joins processors the container holds.
+inline std::vector<Edge> readEdges(Cursor &in, uint32_t numEdges,
+                                   size_t numProcessors) {
+  std::vector<Edge> edges(numEdges);
+  for (auto &e : edges) {
+    e.procA = in.u32();
+    e.slotA = in.u32();
+    e.procB = in.u32();
+    e.slotB = in.u32();
+    if (e.procA >= numProcessors || e.procB >= numProcessors) {
+      throw std::runtime_error("network container edge names a processor "
+                               "it does not hold");
+    }
+  }
+  return edges;
+}
+
+inline std::vector<std::string> readNames(Cursor &in, size_t numEdges) {
+  std::vector<std::string> names(numEdges);
+  for (auto &name : names) {
+    name = in.bytes(in.u32());
+  }
+  return names;
+}
+
+inline Placement readPlacement(Cursor &in, size_t numProcessors) {
+  Placement placement;
+  placement.width = in.u32();
+  placement.height = in.u32();
+  placement.torus = in.u32() != 0;
+  placement.nodes.resize(numProcessors);
+  for (auto &node : placement.nodes) {
+    node = in.u32();
+  }
+  return placement;
+}
+
+/// Parse the body of a version 1 container, after its magic.
+inline void readVersion1(Cursor &in, MappedContainer &container) {
+  uint32_t numProcessors = in.u32();
+  // Each edge takes 16 bytes and each image at least 4.
+  uint32_t numEdges = in.count(16);
+  if (numProcessors > (in.remaining() - 16 * size_t(numEdges)) / 4) {
+    throw std::runtime_error("truncated network container");
+  }
+  container.edges = readEdges(in, numEdges, numProcessors);
+  container.images.reserve(numProcessors);
+  for (uint32_t i = 0; i < numProcessors; i++) {
+    container.images.push_back(splitImage(in.bytes(in.u32())));
+    container.imageOf.push_back(i);
+  }
+  while (in.remaining() >= sizeof(uint32_t)) {
+    uint32_t section = in.u32();
+    if (section == NAMES_MAGIC) {
+      container.channelNames = readNames(in, numEdges);
+    } else if (section == PLACEMENT_MAGIC) {
+      container.placement = readPlacement(in, numProcessors);
+    } else {
+      break; // An unknown section.
+    }
+  }
+}
+
+/// Parse the body of a version 2 container, after its version.
+inline void readVersion2(Cursor &in, std::string_view file,
+                         MappedContainer &container) {
+  container.version = 2;
+  uint32_t numSections = in.count(16);
+  in.u32(); // reserved
+  std::map<Section, std::string_view> sections;
+  for (uint32_t i = 0; i < numSections; i++) {
+    auto kind = static_cast<Section>(in.u32());
+    uint32_t flags = in.u32();
+    uint64_t offset = in.u32();
+    uint64_t size = in.u32();
+    if (offset + size > file.size()) {
+      throw std::runtime_error("network container section lies outside "
+                               "the file");
+    }
+    if (kind == Section::CODE && flags == SECTION_COMPRESSED) {
+      container.compressed = true;
+    } else if (flags != 0) {
+      throw std::runtime_error("unsupported network container section "
+                               "flags");
+    }
+    sections.emplace(kind, file.substr(offset, size));
+  }
+  if (!sections.count(Section::NETWORK)) {
+    throw std::runtime_error("network container has no network section");
+  }
+  auto code = sections[Section::CODE];
+  auto symbols = sections[Section::SYMBOLS];
+  // Return the bytes of a section at an offset, checking they lie within it.
+  auto within = [](std::string_view section, uint64_t offset,
+                   uint64_t size) {
+    if (offset + size > section.size()) {
+      throw std::runtime_error("network container image lies outside its "
+                               "section");
+    }
+    return section.substr(offset, size);
+  };
+  Cursor net(sections[Section::NETWORK]);
+  uint32_t numImages = net.count(20);
+  for (uint32_t i = 0; i < numImages; i++) {
+    ImageView image;
+    image.programWords = net.u32();
+    uint32_t codeOffset = net.u32();
+    image.code = within(code, codeOffset, net.u32());
+    uint32_t symbolsOffset = net.u32();
+    image.symbols = within(symbols, symbolsOffset, net.u32());
+    image.compressed = container.compressed;
+    container.images.push_back(image);
+  }
+  uint32_t numProcessors = net.count(4);
+  for (uint32_t i = 0; i < numProcessors; i++) {
+    auto image = net.u32();
+    if (image >= numImages) {
+      throw std::runtime_error("network container processor names an image "
+                               "it does not hold");
+    }
+    container.imageOf.push_back(image);
+  }
+  container.edges = readEdges(net, net.count(16), numProcessors);
+  if (sections.count(Section::NAMES)) {
+    Cursor names(sections[Section::NAMES]);
+    container.channelNames = readNames(names, container.edges.size());
+  }
+  if (sections.count(Section::PLACEMENT)) {
+    Cursor placement(sections[Section::PLACEMENT]);
+    container.placement = readPlacement(placement, numProcessors);
+  }
+}
+
+/// Map a container file of either version and validate it. If it lacks the
+/// HEXN magic, returns a single-image container (isNetwork = false, one image
+/// holding the whole file).
+inline MappedContainer map(const std::string &filename) {
+  MappedContainer container;
+  container.file = std::make_shared<MappedFile>(filename);
+  auto file = container.file->bytes();
+  Cursor in(file);
+  if (in.remaining() < sizeof(uint32_t) || in.u32() != MAGIC) {
     // Single plain image: the whole file is one image.
-    file.seekg(0, std::ios::beg);
-    std::vector<char> image(fileSize);
-    file.read(image.data(), fileSize);
-    container.images.push_back(std::move(image));
+    container.images.push_back(splitImage(file));
+    container.imageOf.push_back(0);
     return container;
   }
-
   container.isNetwork = true;
-  uint32_t numProcessors = readU32(file);
-  uint32_t numEdges = readU32(file);
-  container.edges.resize(numEdges);
-  for (auto &e : container.edges) {
-    e.procA = readU32(file);
-    e.slotA = readU32(file);
-    e.procB = readU32(file);
-    e.slotB = readU32(file);
+  Cursor body = in;
+  if (in.u32() == VERSION_2) {
+    readVersion2(in, file, container);
+  } else {
+    readVersion1(body, container);
   }
-  for (uint32_t i = 0; i < numProcessors; i++) {
-    uint32_t imageSize = readU32(file);
-    std::vector<char> image(imageSize);
-    file.read(image.data(), imageSize);
-    container.images.push_back(std::move(image));
+  return container;
+}
+
+/// Read a container file, copying each processor's image out of the
+/// mapping.
+inline Container read(const std::string &filename) {
+  auto mapped = map(filename);
+  Container container;
+  container.isNetwork = mapped.isNetwork;
+  container.edges = std::move(mapped.edges);
+  for (size_t i = 0; i < mapped.numProcessors(); i++) {
+    container.images.push_back(joinImage(mapped.imageOfProcessor(i)));
   }
+  container.channelNames = std::move(mapped.channelNames);
+  container.placement = std::move(mapped.placement);
+  container.compressed = mapped.compressed;
   return container;
 }
 
+/// Append a little-endian uint32 to a buffer.
+inline void appendU32(std::string &out, uint32_t value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(uint32_t));
+}
+
+/// Write a version 2 network container, with the channel names and placement
+/// sections if it has them. Processors with identical images share one
+/// entry. Compressed code is packed rather than page-aligned, since it must
+/// be decompressed to be loaded.
+inline void write(const std::string &filename, const Container &container) {
+  if (!container.isNetwork) {
+    throw std::runtime_error("cannot write a single image as a container");
+  }
+  // Find the distinct images, and lay out their code and debug info.
+  std::map<std::string_view, uint32_t> distinct;
+  std::vector<uint32_t> imageOf;
+  std::string network, code, symbols;
+  std::vector<ImageView> images;
+  for (auto &bytes : container.images) {
+    std::string_view key(bytes.data(), bytes.size());
+    auto [it, added] =
+        distinct.emplace(key, static_cast<uint32_t>(distinct.size()));
+    imageOf.push_back(it->second);
+    if (added) {
+      images.push_back(splitImage(key));
+    }
+  }
+  appendU32(network, static_cast<uint32_t>(images.size()));
+  for (auto &image : images) {
+    auto bytes = container.compressed ? hexcompress::compress(image.code)
+                                      : std::string(image.code);
+    if (!container.compressed) {
+      code.resize((code.size() + CODE_ALIGN - 1) & ~size_t(CODE_ALIGN - 1));
+    }
+    appendU32(network, image.programWords);
+    appendU32(network, static_cast<uint32_t>(code.size()));
+    appendU32(network, static_cast<uint32_t>(bytes.size()));
+    appendU32(network, static_cast<uint32_t>(symbols.size()));
+    appendU32(network, static_cast<uint32_t>(image.symbols.size()));
+    code.append(bytes);
+    symbols.append(image.symbols);
+  }
+  appendU32(network, static_cast<uint32_t>(imageOf.size()));
+  for (auto image : imageOf) {
+    appendU32(network, image);
+  }
+  appendU32(network, static_cast<uint32_t>(container.edges.size()));
+  for (auto &e : container.edges) {
+    appendU32(network, e.procA);
+    appendU32(network, e.slotA);
+    appendU32(network, e.procB);
+    appendU32(network, e.slotB);
+  }
+  struct Body {
+    Section kind;
+    const std::string *bytes;
+    uint32_t align;
+    uint32_t flags = 0;
+  };
+  std::vector<Body> bodies = {{Section::NETWORK, &network, SECTION_ALIGN}};
+  std::string names;
+  if (!container.channelNames.empty()) {
+    for (auto &name : container.channelNames) {
+      appendU32(names, static_cast<uint32_t>(name.size()));
+      names.append(name);
+    }
+    bodies.push_back({Section::NAMES, &names, SECTION_ALIGN});
+  }
+  std::string placement;
+  auto &p = container.placement;
+  if (p.width > 0) {
+    appendU32(placement, p.width);
+    appendU32(placement, p.height);
+    appendU32(placement, p.torus ? 1 : 0);
+    for (auto node : p.nodes) {
+      appendU32(placement, node);
+    }
+    bodies.push_back({Section::PLACEMENT, &placement, SECTION_ALIGN});
+  }
+  bodies.push_back({Section::SYMBOLS, &symbols, SECTION_ALIGN});
+  if (container.compressed) {
+    bodies.push_back(
+        {Section::CODE, &code, SECTION_ALIGN, SECTION_COMPRESSED});
+  } else {
+    bodies.push_back({Section::CODE, &code, CODE_ALIGN});
+  }
+  // Lay out the header, the section table and the sections.
+  std::string header;
+  appendU32(header, MAGIC);
+  appendU32(header, VERSION_2);
+  appendU32(header, static_cast<uint32_t>(bodies.size()));
+  appendU32(header, 0);
+  size_t at = header.size() + 16 * bodies.size();
+  std::vector<size_t> offsets;
+  for (auto &body : bodies) {
+    at = (at + body.align - 1) & ~size_t(body.align - 1);
+    offsets.push_back(at);
+    appendU32(header, static_cast<uint32_t>(body.kind));
+    appendU32(header, body.flags);
+    appendU32(header, static_cast<uint32_t>(at));
+    appendU32(header, static_cast<uint32_t>(body.bytes->size()));
+    at += body.bytes->size();
+  }
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("could not open output file: " + filename);
+  }
+  file << header;
+  at = header.size();
+  for (size_t i = 0; i < bodies.size(); i++) {
+    file << std::string(offsets[i] - at, '\0') << *bodies[i].bytes;
+    at = offsets[i] + bodies[i].bytes->size();
+  }
+}
+
 } // namespace hexcontainer
 
 #endif // HEX_CONTAINER_HPP
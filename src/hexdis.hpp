@@ -81,6 +81,11 @@ inline void disassemble(const std::vector<uint8_t> &program, std::ostream &out,
       out << fmt::format("  {:#06x}  {:02x}  {}\n", pc, byte,
                          hex::oprInstrEnumToStr(oprInstr));
       oreg = 0;
+    } else if (instrEnum == hex::Instr::SPI) {
+      out << fmt::format("  {:#06x}  {:02x}  {:<4} {}\n", pc, byte,
+                         hex::spiInstrEnumToStr(hex::spiOp(oreg)),
+                         static_cast<int32_t>(hex::spiOffset(oreg)));
+      oreg = 0;
     } else {
       out << fmt::format("  {:#06x}  {:02x}  {:<4} {}\n", pc, byte,
                          hex::instrEnumToStr(instrEnum), oreg);
@@ -1,10 +1,16 @@
 #ifndef HEX_IMAGE_HPP
 #define HEX_IMAGE_HPP
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <istream>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //===---------------------------------------------------------------------===//
@@ -13,12 +19,34 @@
 //
 // An image is: uint32 programSizeWords, programSizeWords*4 bytes of code, then
 // an optional debug-info block:
+//   uint32 magic = 0x59535848 ("HXSY")
+//   uint32 numSymbols
+//   uint32 stringBytes
+//   index[numSymbols]: uint32 byteOffset, nameOffset, sorted by byteOffset
+//   stringBytes of null-terminated names, each stored once, that nameOffset
+//     locates
+// The index has a fixed width and is sorted, so a loader can search it in
+// place without parsing it. An optional line table may follow:
+//   uint32 magic = 0x4E4C5848 ("HXLN")
+//   uint32 numLines
+//   uint32 lineBytes
+//   lineBytes of numLines (byteOffset, line) entries, sorted by byteOffset,
+//     each a varint of the offset after the last entry's, then a zigzag
+//     varint of the change in line. An entry's line (0 for none) holds from
+//     its offset to the next entry's.
+// Varints are little-endian base 128.
+//
+// Images written before the index have a block without the magic, which is
+// still read:
 //   uint32 numStrings, numStrings null-terminated strings
 //   uint32 numSymbols, numSymbols * (uint32 stringIndex, uint32 byteOffset)
 //===---------------------------------------------------------------------===//
 
 namespace heximage {
 
+constexpr uint32_t SYMBOLS_MAGIC = 0x59535848; // "HXSY"
+constexpr uint32_t LINES_MAGIC = 0x4E4C5848;   // "HXLN"
+
 /// Read a little-endian uint32 from a stream.
 inline uint32_t readU32(std::istream &in) {
   uint32_t value = 0;
@@ -37,48 +65,251 @@ struct Symbol {
   uint32_t offset;
 };
 
-/// Read the debug-info block (string table + symbol table) that follows the
-/// program in an image, resolving each symbol's name from the string table.
-inline std::vector<Symbol> readSymbols(std::istream &in) {
-  uint32_t numStrings = readU32(in);
-  std::vector<std::string> strings;
-  strings.reserve(numStrings);
+/// The source line of the code from a byte offset up to the next line's.
+struct Line {
+  uint32_t offset;
+  uint32_t line;
+};
+
+/// Read the symbols of a debug-info block without the magic.
+inline std::vector<Symbol> readUnindexedSymbols(std::string_view bytes) {
+  size_t at = 0;
+  auto u32 = [&](uint32_t &value) {
+    if (bytes.size() - at < sizeof(uint32_t)) {
+      return false;
+    }
+    std::memcpy(&value, bytes.data() + at, sizeof(uint32_t));
+    at += sizeof(uint32_t);
+    return true;
+  };
+  uint32_t numStrings = 0;
+  if (!u32(numStrings)) {
+    return {};
+  }
+  std::vector<std::string_view> strings;
   for (uint32_t i = 0; i < numStrings; i++) {
-    std::string s;
-    char c = in.get();
-    while (c != '\0') {
-      s += c;
-      c = in.get();
+    auto end = bytes.find('\0', at);
+    if (end == std::string_view::npos) {
+      return {};
     }
-    strings.push_back(std::move(s));
+    strings.push_back(bytes.substr(at, end - at));
+    at = end + 1;
   }
-  uint32_t numSymbols = readU32(in);
+  uint32_t numSymbols = 0;
   std::vector<Symbol> symbols;
-  symbols.reserve(numSymbols);
+  if (!u32(numSymbols)) {
+    return symbols;
+  }
   for (uint32_t i = 0; i < numSymbols; i++) {
-    uint32_t strIndex = readU32(in);
-    uint32_t offset = readU32(in);
+    uint32_t strIndex, offset;
+    if (!u32(strIndex) || !u32(offset)) {
+      break;
+    }
     if (strIndex < strings.size()) {
-      symbols.push_back({strings[strIndex], offset});
+      symbols.push_back({std::string(strings[strIndex]), offset});
     }
   }
   return symbols;
 }
 
-/// Write the debug-info block (string table + symbol table), emitting one
-/// string per symbol (no string pooling).
-inline void writeSymbols(std::ostream &out,
-                         const std::vector<Symbol> &symbols) {
-  auto count = static_cast<uint32_t>(symbols.size());
-  writeU32(out, count);
+/// Encode a debug-info block: the symbols sorted by offset, and each distinct
+/// name stored once.
+inline std::string encodeSymbols(std::vector<Symbol> symbols) {
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](const Symbol &a, const Symbol &b) {
+                     return a.offset < b.offset;
+                   });
+  std::string index, strings;
+  std::map<std::string_view, uint32_t> pooled;
+  auto append = [](std::string &out, uint32_t value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(uint32_t));
+  };
   for (const auto &symbol : symbols) {
-    out.write(symbol.name.c_str(), symbol.name.length() + 1);
+    auto [it, added] = pooled.emplace(
+        symbol.name, static_cast<uint32_t>(strings.size()));
+    if (added) {
+      strings.append(symbol.name.c_str(), symbol.name.size() + 1);
+    }
+    append(index, symbol.offset);
+    append(index, it->second);
   }
-  writeU32(out, count);
-  for (uint32_t i = 0; i < count; i++) {
-    writeU32(out, i);
-    writeU32(out, symbols[i].offset);
+  std::string block;
+  append(block, SYMBOLS_MAGIC);
+  append(block, static_cast<uint32_t>(symbols.size()));
+  append(block, static_cast<uint32_t>(strings.size()));
+  return block + index + strings;
+}
+
+/// A view of the symbols of a debug-info block, searched in place. A block
+/// without the index is converted to one when it is viewed. A truncated block
+/// is viewed as the symbols it holds.
+class SymbolIndex {
+  std::shared_ptr<const std::string> converted;
+  std::string_view index;
+  std::string_view strings;
+  uint32_t count = 0;
+
+  uint32_t field(size_t i, size_t word) const {
+    uint32_t value;
+    std::memcpy(&value, index.data() + (i * 2 + word) * sizeof(uint32_t),
+                sizeof(uint32_t));
+    return value;
+  }
+
+public:
+  SymbolIndex() = default;
+  explicit SymbolIndex(std::string_view bytes) {
+    uint32_t header[3];
+    if (bytes.size() < sizeof(uint32_t)) {
+      return;
+    }
+    std::memcpy(header, bytes.data(), sizeof(uint32_t));
+    if (header[0] != SYMBOLS_MAGIC) {
+      converted = std::make_shared<const std::string>(
+          encodeSymbols(readUnindexedSymbols(bytes)));
+      bytes = *converted;
+    }
+    if (bytes.size() < sizeof(header)) {
+      return;
+    }
+    std::memcpy(header, bytes.data(), sizeof(header));
+    bytes.remove_prefix(sizeof(header));
+    constexpr size_t entryBytes = 2 * sizeof(uint32_t);
+    count = static_cast<uint32_t>(
+        std::min<size_t>(header[1], bytes.size() / entryBytes));
+    index = bytes.substr(0, count * entryBytes);
+    strings = bytes.substr(index.size(), header[2]);
   }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  /// Return the byte offset symbol i labels.
+  uint32_t offset(size_t i) const { return field(i, 0); }
+  /// Return the name of symbol i, or "" if the block does not hold it.
+  std::string_view name(size_t i) const {
+    uint32_t at = field(i, 1);
+    if (at >= strings.size()) {
+      return {};
+    }
+    auto end = strings.find('\0', at);
+    return strings.substr(at, end == std::string_view::npos ? end : end - at);
+  }
+  /// Return the index of the symbol covering a byte offset: the last with the
+  /// greatest offset <= it, or -1 if it is before the first symbol.
+  int find(uint32_t byteOffset) const {
+    size_t low = 0, high = count;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (offset(mid) <= byteOffset) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return static_cast<int>(low) - 1;
+  }
+};
+
+/// Read the symbols of a debug-info block in memory, in offset order. A
+/// truncated block yields the symbols read before its end.
+inline std::vector<Symbol> readSymbols(std::string_view bytes) {
+  SymbolIndex index(bytes);
+  std::vector<Symbol> symbols;
+  symbols.reserve(index.size());
+  for (size_t i = 0; i < index.size(); i++) {
+    symbols.push_back({std::string(index.name(i)), index.offset(i)});
+  }
+  return symbols;
+}
+
+/// Read the debug-info block that follows the program in an image, to the
+/// end of the stream.
+inline std::vector<Symbol> readSymbols(std::istream &in) {
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  return readSymbols(bytes);
+}
+
+/// Encode a line table, from lines sorted by offset.
+inline std::string encodeLines(const std::vector<Line> &lines) {
+  std::string deltas;
+  auto varint = [&](uint64_t value) {
+    while (value >= 0x80) {
+      deltas += static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    deltas += static_cast<char>(value);
+  };
+  Line last = {0, 0};
+  for (const auto &line : lines) {
+    int64_t change = int64_t(line.line) - int64_t(last.line);
+    varint(line.offset - last.offset);
+    varint(change < 0 ? (uint64_t(-change) << 1) - 1 : uint64_t(change) << 1);
+    last = line;
+  }
+  std::string table;
+  for (uint32_t value : {LINES_MAGIC, static_cast<uint32_t>(lines.size()),
+                         static_cast<uint32_t>(deltas.size())}) {
+    table.append(reinterpret_cast<const char *>(&value), sizeof(uint32_t));
+  }
+  return table + deltas;
+}
+
+/// Read the line table that follows the symbols of a debug-info block, if it
+/// has one. A damaged table yields the lines decoded before the damage.
+inline std::vector<Line> readLines(std::string_view bytes) {
+  uint32_t header[3];
+  if (bytes.size() < sizeof(header)) {
+    return {};
+  }
+  std::memcpy(header, bytes.data(), sizeof(header));
+  uint64_t end = sizeof(header) + uint64_t(header[1]) * 2 * sizeof(uint32_t) +
+                 header[2];
+  if (header[0] != SYMBOLS_MAGIC || end + sizeof(header) > bytes.size()) {
+    return {};
+  }
+  bytes.remove_prefix(end);
+  std::memcpy(header, bytes.data(), sizeof(header));
+  bytes = bytes.substr(sizeof(header), header[2]);
+  if (header[0] != LINES_MAGIC) {
+    return {};
+  }
+  size_t at = 0;
+  auto varint = [&](uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && at < bytes.size(); shift += 7) {
+      auto b = static_cast<uint8_t>(bytes[at++]);
+      value |= uint64_t(b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::vector<Line> lines;
+  Line last = {0, 0};
+  for (uint32_t i = 0; i < header[1]; i++) {
+    uint64_t offset, change;
+    if (!varint(offset) || !varint(change)) {
+      break;
+    }
+    last.offset += static_cast<uint32_t>(offset);
+    last.line += static_cast<uint32_t>(change & 1 ? ~(change >> 1)
+                                                  : change >> 1);
+    lines.push_back(last);
+  }
+  return lines;
+}
+
+/// Write the debug-info block.
+inline void writeSymbols(std::ostream &out,
+                         const std::vector<Symbol> &symbols) {
+  out << encodeSymbols(symbols);
+}
+
+/// Write a line table, to follow the debug-info block.
+inline void writeLines(std::ostream &out, const std::vector<Line> &lines) {
+  out << encodeLines(lines);
 }
 
 } // namespace heximage
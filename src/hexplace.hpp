@@ -0,0 +1,307 @@
+#ifndef HEX_PLACE_HPP
+#define HEX_PLACE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fmt/format.h>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//===---------------------------------------------------------------------===//
+// Placement of the processes of a network onto the nodes of a 2D mesh or
+// torus. The simulator (hexsim) derives each channel's hop count from a
+// placement, and searches for placements that reduce the cost of the traffic
+// it measured on each channel.
+//===---------------------------------------------------------------------===//
+
+namespace hexplace {
+
+/// A width x height grid of nodes, numbered row-major, with links between
+/// neighbouring nodes and, in a torus, wrap-around links at the edges.
+struct Topology {
+  unsigned width = 0;
+  unsigned height = 0;
+  bool torus = false;
+
+  bool empty() const { return width == 0 || height == 0; }
+  unsigned size() const { return width * height; }
+
+  /// Parse a "WxH" size.
+  static Topology parse(const std::string &spec, bool torus) {
+    Topology t;
+    t.torus = torus;
+    auto x = spec.find('x');
+    if (x == std::string::npos) {
+      throw std::runtime_error("expected a size WxH: " + spec);
+    }
+    t.width = std::stoul(spec.substr(0, x));
+    t.height = std::stoul(spec.substr(x + 1));
+    if (t.empty()) {
+      throw std::runtime_error("empty topology: " + spec);
+    }
+    return t;
+  }
+
+  /// Return the distance between two coordinates of a dimension of size n,
+  /// going the shorter way round in a torus.
+  unsigned distance(unsigned a, unsigned b, unsigned n) const {
+    unsigned d = a > b ? a - b : b - a;
+    return torus ? std::min(d, n - d) : d;
+  }
+
+  /// Return the number of hops between two nodes.
+  unsigned hops(unsigned a, unsigned b) const {
+    return distance(a % width, b % width, width) +
+           distance(a / width, b / width, height);
+  }
+
+  /// Call visit with each link a message crosses from node a to node b under
+  /// dimension-order routing (X then Y, the shorter way round in a torus). A
+  /// link is numbered 4 * node + direction for the node it leaves.
+  template <typename Visit>
+  void route(unsigned a, unsigned b, Visit visit) const {
+    auto walk = [&](unsigned &at, unsigned to, unsigned n, unsigned stride,
+                    unsigned dirUp, unsigned dirDown, unsigned &node) {
+      while (at != to) {
+        unsigned up = (to + n - at) % n; // steps going up, with wrap-around
+        bool goUp = torus ? up <= n - up : to > at;
+        visit(4 * node + (goUp ? dirUp : dirDown));
+        unsigned next = goUp ? (at + 1) % n : (at + n - 1) % n;
+        node = node - at * stride + next * stride;
+        at = next;
+      }
+    };
+    unsigned node = a;
+    unsigned x = a % width, y = a / width;
+    walk(x, b % width, width, 1, 0, 1, node);
+    walk(y, b / width, height, width, 2, 3, node);
+  }
+};
+
+/// A channel between two processes and the traffic it carried.
+struct Flow {
+  unsigned procA;
+  unsigned procB;
+  uint64_t weight;
+};
+
+/// What a placement minimises: the traffic-weighted hop count summed over the
+/// channels, which the cycles spent in transfers follow, or the traffic over
+/// the busiest link.
+enum class Objective { HOPS, LINK_LOAD };
+
+/// Return the cost of a placement (process -> node) under an objective.
+inline uint64_t cost(const Topology &topology,
+                     const std::vector<unsigned> &placement,
+                     const std::vector<Flow> &flows, Objective objective) {
+  if (objective == Objective::HOPS) {
+    uint64_t total = 0;
+    for (auto &f : flows) {
+      total += f.weight * topology.hops(placement[f.procA], placement[f.procB]);
+    }
+    return total;
+  }
+  std::vector<uint64_t> load(4 * topology.size());
+  for (auto &f : flows) {
+    topology.route(placement[f.procA], placement[f.procB],
+                   [&](unsigned link) { load[link] += f.weight; });
+  }
+  return load.empty() ? 0 : *std::max_element(load.begin(), load.end());
+}
+
+/// Return the placement of numProcs processes on the first nodes in order.
+inline std::vector<unsigned> defaultPlacement(size_t numProcs) {
+  std::vector<unsigned> placement(numProcs);
+  for (size_t i = 0; i < numProcs; i++) {
+    placement[i] = static_cast<unsigned>(i);
+  }
+  return placement;
+}
+
+/// Check a placement puts each of numProcs processes on its own node.
+inline void validate(const Topology &topology,
+                     const std::vector<unsigned> &placement, size_t numProcs) {
+  if (placement.size() != numProcs) {
+    throw std::runtime_error(
+        fmt::format("placement of {} processes for {} processors",
+                    placement.size(), numProcs));
+  }
+  std::vector<bool> used(topology.size());
+  for (auto node : placement) {
+    if (node >= topology.size() || used[node]) {
+      throw std::runtime_error(fmt::format(
+          "placement does not fit a {}x{} topology", topology.width,
+          topology.height));
+    }
+    used[node] = true;
+  }
+}
+
+/// Place numProcs processes greedily: the one with the most traffic at the
+/// centre, then repeatedly the one with the most traffic to those placed, on
+/// the free node with the fewest traffic-weighted hops to them.
+inline std::vector<unsigned> greedyPlacement(const Topology &topology,
+                                             size_t numProcs,
+                                             const std::vector<Flow> &flows) {
+  std::vector<std::vector<std::pair<unsigned, uint64_t>>> partners(numProcs);
+  std::vector<uint64_t> total(numProcs);
+  for (auto &f : flows) {
+    partners[f.procA].push_back({f.procB, f.weight});
+    partners[f.procB].push_back({f.procA, f.weight});
+    total[f.procA] += f.weight;
+    total[f.procB] += f.weight;
+  }
+  const unsigned NONE = ~0U;
+  std::vector<unsigned> placement(numProcs, NONE);
+  std::vector<bool> used(topology.size());
+  for (size_t placed = 0; placed < numProcs; placed++) {
+    // Choose the process with the most traffic to those already placed.
+    unsigned next = NONE;
+    uint64_t bestTo = 0;
+    for (unsigned p = 0; p < numProcs; p++) {
+      if (placement[p] != NONE) {
+        continue;
+      }
+      uint64_t to = 0;
+      for (auto &[q, w] : partners[p]) {
+        to += placement[q] != NONE ? w : 0;
+      }
+      if (next == NONE || to > bestTo ||
+          (to == bestTo && total[p] > total[next])) {
+        next = p;
+        bestTo = to;
+      }
+    }
+    // Choose the free node nearest its placed partners, or the centre.
+    unsigned centre = (topology.height / 2) * topology.width +
+                      topology.width / 2;
+    unsigned bestNode = NONE;
+    uint64_t bestCost = 0;
+    for (unsigned n = 0; n < topology.size(); n++) {
+      if (used[n]) {
+        continue;
+      }
+      uint64_t c = 0;
+      for (auto &[q, w] : partners[next]) {
+        c += placement[q] != NONE ? w * topology.hops(n, placement[q]) : 0;
+      }
+      c = c * topology.size() + topology.hops(n, centre);
+      if (bestNode == NONE || c < bestCost) {
+        bestNode = n;
+        bestCost = c;
+      }
+    }
+    placement[next] = bestNode;
+    used[bestNode] = true;
+  }
+  return placement;
+}
+
+/// Improve a placement by simulated annealing. Each step moves a process to
+/// a random node, swapping with any process there, and is kept if it lowers
+/// the cost, or otherwise with a probability that falls as the temperature
+/// cools. Returns the best placement seen. The search is deterministic for a
+/// given seed.
+inline std::vector<unsigned> anneal(const Topology &topology,
+                                    std::vector<unsigned> placement,
+                                    const std::vector<Flow> &flows,
+                                    Objective objective, unsigned iterations,
+                                    unsigned seed) {
+  if (placement.empty() || topology.size() < 2) {
+    return placement;
+  }
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<unsigned> pickProc(
+      0, static_cast<unsigned>(placement.size() - 1));
+  std::uniform_int_distribution<unsigned> pickNode(0, topology.size() - 1);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  std::vector<int> occupant(topology.size(), -1);
+  for (size_t p = 0; p < placement.size(); p++) {
+    occupant[placement[p]] = static_cast<int>(p);
+  }
+  // Move process p to node n, swapping with its occupant.
+  auto move = [&](unsigned p, unsigned n) {
+    unsigned from = placement[p];
+    int q = occupant[n];
+    if (q >= 0) {
+      placement[q] = from;
+    }
+    occupant[from] = q;
+    placement[p] = n;
+    occupant[n] = static_cast<int>(p);
+  };
+  auto current = cost(topology, placement, flows, objective);
+  auto best = placement;
+  auto bestCost = current;
+  // Start hot enough to accept a typical uphill move.
+  double temperature = std::max(1.0, static_cast<double>(current) /
+                                         std::max<size_t>(1, flows.size()));
+  double cooling = std::pow(1e-3, 1.0 / std::max(1U, iterations));
+  for (unsigned i = 0; i < iterations; i++, temperature *= cooling) {
+    unsigned p = pickProc(rng);
+    unsigned n = pickNode(rng);
+    unsigned from = placement[p];
+    if (n == from) {
+      continue;
+    }
+    move(p, n);
+    auto next = cost(topology, placement, flows, objective);
+    double delta = static_cast<double>(next) - static_cast<double>(current);
+    if (delta <= 0 || chance(rng) < std::exp(-delta / temperature)) {
+      current = next;
+      if (current < bestCost) {
+        best = placement;
+        bestCost = current;
+      }
+    } else {
+      move(p, from);
+    }
+  }
+  return best;
+}
+
+/// Find a placement of numProcs processes with a low cost: the cheaper of
+/// the default and greedy placements, improved by annealing.
+inline std::vector<unsigned> optimise(const Topology &topology,
+                                      size_t numProcs,
+                                      const std::vector<Flow> &flows,
+                                      Objective objective,
+                                      unsigned iterations = 20000,
+                                      unsigned seed = 1) {
+  if (numProcs > topology.size()) {
+    throw std::runtime_error(
+        fmt::format("{} processors do not fit a {}x{} topology", numProcs,
+                    topology.width, topology.height));
+  }
+  auto start = defaultPlacement(numProcs);
+  auto greedy = greedyPlacement(topology, numProcs, flows);
+  if (cost(topology, greedy, flows, objective) <
+      cost(topology, start, flows, objective)) {
+    start = greedy;
+  }
+  return anneal(topology, start, flows, objective, iterations, seed);
+}
+
+/// Print a placement as a grid of the processor on each node.
+inline void printPlacement(std::ostream &out, const Topology &topology,
+                           const std::vector<unsigned> &placement) {
+  std::vector<int> occupant(topology.size(), -1);
+  for (size_t p = 0; p < placement.size(); p++) {
+    occupant[placement[p]] = static_cast<int>(p);
+  }
+  for (unsigned y = 0; y < topology.height; y++) {
+    for (unsigned x = 0; x < topology.width; x++) {
+      int p = occupant[y * topology.width + x];
+      out << (p < 0 ? fmt::format("{:>4}", ".") : fmt::format("{:>4}", p));
+    }
+    out << "\n";
+  }
+}
+
+} // namespace hexplace
+
+#endif // HEX_PLACE_HPP
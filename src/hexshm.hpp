@@ -0,0 +1,159 @@
+#ifndef HEX_SHM_HPP
+#define HEX_SHM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <thread>
+
+//===---------------------------------------------------------------------===//
+// Memory shared between processes, for running a network across several
+// processes on one host (see hexsim::System::setPartitions): an anonymous
+// mapping that forked children inherit, and the lock-free structures the
+// processes communicate through, placed in it.
+//===---------------------------------------------------------------------===//
+
+namespace hexshm {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free to work across "
+              "processes");
+
+/// An anonymous memory mapping, zero-filled and shared with the child
+/// processes forked after it is created.
+class Mapping {
+  void *base = nullptr;
+  size_t length = 0;
+
+public:
+  explicit Mapping(size_t length) : length(length) {
+    base = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("could not map shared memory");
+    }
+  }
+  ~Mapping() { munmap(base, length); }
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  /// Return a pointer to the byte at an offset.
+  template <typename T> T *at(size_t offset) const {
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+  }
+};
+
+/// Assigns offsets in a mapping to the objects placed in it, each on its own
+/// cache line.
+class Layout {
+  size_t size = 0;
+
+public:
+  static constexpr size_t ALIGN = 64;
+  /// Reserve bytes and return their offset.
+  size_t reserve(size_t bytes) {
+    size_t offset = (size + ALIGN - 1) & ~(ALIGN - 1);
+    size = offset + bytes;
+    return offset;
+  }
+  size_t total() const { return size; }
+};
+
+/// A single-producer single-consumer ring of bytes, followed in the mapping
+/// by its data. The producer publishes a record with one store, so the
+/// consumer sees either all of it or none.
+class Ring {
+  alignas(64) std::atomic<uint64_t> head{0}; // bytes written
+  alignas(64) std::atomic<uint64_t> tail{0}; // bytes read
+  uint64_t capacity;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+
+public:
+  explicit Ring(uint64_t capacity) : capacity(capacity) {}
+
+  /// Return the bytes of a mapping a ring with a capacity occupies.
+  static size_t size(uint64_t capacity) { return sizeof(Ring) + capacity; }
+
+  /// Construct a ring at an offset of a mapping.
+  static Ring *create(const Mapping &mapping, size_t offset,
+                      uint64_t capacity) {
+    return new (mapping.at<void>(offset)) Ring(capacity);
+  }
+
+  /// Append the n bytes at src as one record, returning false if there is
+  /// not space for all of them.
+  bool tryWrite(const void *src, size_t n) {
+    auto h = head.load(std::memory_order_relaxed);
+    auto t = tail.load(std::memory_order_acquire);
+    if (capacity - (h - t) < n) {
+      return false;
+    }
+    auto *bytes = static_cast<const char *>(src);
+    size_t at = h % capacity;
+    size_t first = std::min<size_t>(n, capacity - at);
+    std::memcpy(data() + at, bytes, first);
+    std::memcpy(data(), bytes + first, n - first);
+    head.store(h + n, std::memory_order_release);
+    return true;
+  }
+
+  /// Return the number of bytes available to read.
+  size_t readable() const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_relaxed);
+  }
+
+  /// Copy n available bytes, starting skip bytes in, to dst without
+  /// consuming them.
+  void peek(void *dst, size_t n, size_t skip = 0) {
+    auto *bytes = static_cast<char *>(dst);
+    size_t at = (tail.load(std::memory_order_relaxed) + skip) % capacity;
+    size_t first = std::min<size_t>(n, capacity - at);
+    std::memcpy(bytes, data() + at, first);
+    std::memcpy(bytes + first, data(), n - first);
+  }
+
+  /// Consume n available bytes.
+  void consume(size_t n) {
+    tail.store(tail.load(std::memory_order_relaxed) + n,
+               std::memory_order_release);
+  }
+};
+
+/// A reusable barrier for a fixed number of processes. A process waiting at
+/// it calls idle() as it spins, and gives up if abort is set.
+class Barrier {
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> generation{0};
+
+public:
+  /// Wait for all n processes to arrive. Returns false if aborted.
+  template <typename Idle>
+  bool arriveAndWait(uint32_t n, const std::atomic<bool> &abort, Idle idle) {
+    auto current = generation.load(std::memory_order_acquire);
+    if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == n) {
+      count.store(0, std::memory_order_relaxed);
+      generation.fetch_add(1, std::memory_order_release);
+      return true;
+    }
+    while (generation.load(std::memory_order_acquire) == current) {
+      if (abort.load(std::memory_order_acquire)) {
+        return false;
+      }
+      idle();
+      std::this_thread::yield();
+    }
+    return true;
+  }
+};
+
+} // namespace hexshm
+
+#endif // HEX_SHM_HPP
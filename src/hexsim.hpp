@@ -3,19 +3,39 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <coroutine>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <exception>
 #include <fmt/format.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
 #include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include "hex.hpp"
 #include "hexcontainer.hpp"
 #include "heximage.hpp"
+#include "hexplace.hpp"
+#include "hexshm.hpp"
 #include "hexsimio.hpp"
 
 namespace hexsim {
@@ -26,13 +46,1027 @@ enum class StepResult { RUNNING, HALTED, BLOCKED };
 class Processor;
 
 /// A point-to-point synchronous channel connecting two processors. Holds the
-/// rendezvous state and (when a writer is parked) the value in flight.
+/// rendezvous state and (when a writer is parked) the value in flight. For a
+/// block transfer, the parked side records its block address and word count.
 struct Channel {
   enum class State { IDLE, WRITER_WAITING, READER_WAITING };
   State state = State::IDLE;
   uint32_t value = 0;
+  bool block = false;
+  uint32_t address = 0;
+  uint32_t count = 0;
   Processor *writer = nullptr;
   Processor *reader = nullptr;
+  unsigned index = 0; // position in the network's channels
+
+  // Timed transfers in a PDES run (see System::setPdes). The writer's message
+  // waits in the channel until it is taken, stamped with its arrival time, and
+  // the reader's acknowledgement likewise until the writer takes it. Each of
+  // the hops between the endpoints adds the link latency.
+  struct Message {
+    bool valid = false;
+    uint64_t time = 0;
+    bool block = false;
+    uint32_t count = 0;
+    std::vector<uint32_t> data;
+  };
+  std::mutex mutex;
+  Message message;
+  bool ackValid = false;
+  uint64_t ackTime = 0;
+  unsigned hops = 1;
+
+  // Buffered what-if mode (see System::setChannelDepth): up to depth messages
+  // written but not yet read, oldest first, and the most held at once.
+  unsigned depth = 0;
+  std::deque<Message> fifo;
+  size_t peak = 0;
+
+  // Partitioned PDES runs (see System::setPartitions): a channel between
+  // processors in different processes is remote, and the message or
+  // acknowledgement its local endpoint posts is sent to the other process.
+  bool remote = false;
+  bool messageOut = false;
+  bool ackOut = false;
+};
+
+/// The state a processor stopped in, passed back to the coordinator of a
+/// partitioned run from the worker process that ran it.
+struct StoppedState {
+  StepResult status;
+  unsigned blockedSlot;
+  bool blockedWriting;
+  uint32_t pc;
+  uint64_t simTime;
+  uint64_t instructions;
+};
+
+/// The processors to step in the current tick and in the next tick of a
+/// round-robin network run, each in id order.
+class ReadyQueues {
+  using Queue =
+      std::priority_queue<unsigned, std::vector<unsigned>, std::greater<>>;
+
+public:
+  Queue current, next;
+
+  /// Queue processor id, just unblocked by processor by: in the current tick
+  /// if its turn is still to come, otherwise in the next.
+  void wake(unsigned id, unsigned by) {
+    (id > by ? current : next).push(id);
+  }
+};
+
+/// The coroutine executing a processor in the coroutine back-end of System
+/// (see System::setCoroutines).
+class ProcessorTask {
+public:
+  struct promise_type {
+    std::exception_ptr error;
+    ProcessorTask get_return_object() {
+      return ProcessorTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  explicit ProcessorTask(std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+  ProcessorTask(ProcessorTask &&other) noexcept
+      : handle(std::exchange(other.handle, nullptr)) {}
+  ProcessorTask(const ProcessorTask &) = delete;
+  ProcessorTask &operator=(const ProcessorTask &) = delete;
+  ~ProcessorTask() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  /// Run the processor until it next suspends, rethrowing any error.
+  void resume() {
+    handle.resume();
+    if (handle.promise().error) {
+      std::rethrow_exception(handle.promise().error);
+    }
+  }
+
+private:
+  std::coroutine_handle<promise_type> handle;
+};
+
+/// A worker thread's queue of runnable processors in a parallel run. The
+/// owner takes processors from the front and other workers steal from the
+/// back. Each push counts into an epoch shared by the queues of a run, on
+/// which idle workers wait.
+class RunQueue {
+  std::mutex mutex;
+  std::deque<Processor *> queue;
+  std::atomic<uint64_t> &epoch;
+
+public:
+  explicit RunQueue(std::atomic<uint64_t> &epoch) : epoch(epoch) {}
+
+  void push(Processor *p) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(p);
+    }
+    epoch.fetch_add(1, std::memory_order_acq_rel);
+    epoch.notify_all();
+  }
+
+  Processor *pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty()) {
+      return nullptr;
+    }
+    auto *p = queue.front();
+    queue.pop_front();
+    return p;
+  }
+
+  Processor *steal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty()) {
+      return nullptr;
+    }
+    auto *p = queue.back();
+    queue.pop_back();
+    return p;
+  }
+};
+
+/// Utilisation of one worker thread in a parallel run.
+struct WorkerStats {
+  uint64_t slices = 0;       // processor time slices run
+  uint64_t instructions = 0; // instructions stepped
+  uint64_t steals = 0;       // slices taken from another worker's queue
+  double busySeconds = 0;    // time spent running slices
+  double totalSeconds = 0;   // lifetime of the worker thread
+};
+
+/// Statistics of a round-robin network run, to compare scheduling quanta.
+struct ScheduleStats {
+  unsigned quantum = 1;
+  uint64_t ticks = 0;        // scheduling rounds run
+  uint64_t instructions = 0; // instructions stepped
+  uint64_t outputs = 0;      // output syscalls executed
+  int64_t firstOutputTick = -1;
+  int64_t lastOutputTick = -1;
+};
+
+/// Print the statistics of a round-robin network run.
+inline void printScheduleStats(std::ostream &out, const ScheduleStats &s) {
+  out << fmt::format("quantum {}: {} ticks, {} instructions, {} outputs",
+                     s.quantum, s.ticks, s.instructions, s.outputs);
+  if (s.outputs > 0) {
+    out << fmt::format(", first at tick {}, last at tick {}",
+                       s.firstOutputTick, s.lastOutputTick);
+  }
+  out << "\n";
+}
+
+/// Statistics of a PDES network run.
+struct PdesStats {
+  uint64_t latency = 1; // cycles per router hop
+  uint64_t time = 0;    // simulated cycles until the last processor stopped
+  uint64_t windows = 0; // lookahead windows run
+  uint64_t phases = 0;  // barrier phases, including those for syscalls
+};
+
+/// Print the statistics of a PDES network run.
+inline void printPdesStats(std::ostream &out, const PdesStats &s) {
+  out << fmt::format("pdes latency {}: {} cycles, {} windows, {} phases\n",
+                     s.latency, s.time, s.windows, s.phases);
+}
+
+/// Traffic through one end of a channel (a processor's link slot) in a
+/// round-robin run.
+struct EndpointStats {
+  uint64_t sent = 0;            // messages written
+  uint64_t received = 0;        // messages read
+  uint64_t words = 0;           // words written or read
+  uint64_t writerWaitTicks = 0; // ticks parked as the writer
+  uint64_t readerWaitTicks = 0; // ticks parked as the reader
+  int64_t firstTick = -1;       // tick of the first transfer
+  int64_t lastTick = -1;        // tick of the last transfer
+};
+
+/// Traffic and blocking on one channel of a round-robin run. Ends a and b are
+/// the link slots of the channel's wiring edge.
+struct ChannelStats {
+  std::string name;
+  hexcontainer::Edge edge;
+  EndpointStats a, b;
+  uint64_t messages = 0;
+  uint64_t words = 0;
+  uint64_t writerWaitTicks = 0; // ticks a writer sat in WRITER_WAITING
+  uint64_t readerWaitTicks = 0; // ticks a reader sat in READER_WAITING
+  int64_t firstTick = -1;
+  int64_t lastTick = -1;
+};
+
+/// How one processor spent the ticks of a round-robin run. Blocked ticks
+/// include those waiting for input.
+struct ProcessorStats {
+  uint64_t busyTicks = 0;
+  uint64_t blockedTicks = 0;
+  uint64_t haltedTicks = 0;
+};
+
+/// Per-channel and per-processor statistics of a round-robin network run.
+struct NetworkStats {
+  uint64_t ticks = 0;
+  std::vector<ProcessorStats> processors;
+  std::vector<ChannelStats> channels;
+};
+
+/// Print the statistics of a network run, listing the channels that were
+/// waited on longest first.
+inline void printNetworkStats(std::ostream &out, const NetworkStats &s) {
+  out << fmt::format("{} ticks\n", s.ticks);
+  for (size_t i = 0; i < s.processors.size(); i++) {
+    auto &p = s.processors[i];
+    out << fmt::format("processor {}: {} busy, {} blocked, {} halted\n", i,
+                       p.busyTicks, p.blockedTicks, p.haltedTicks);
+  }
+  std::vector<const ChannelStats *> channels;
+  for (auto &c : s.channels) {
+    channels.push_back(&c);
+  }
+  std::stable_sort(channels.begin(), channels.end(),
+                   [](const ChannelStats *x, const ChannelStats *y) {
+                     return x->writerWaitTicks + x->readerWaitTicks >
+                            y->writerWaitTicks + y->readerWaitTicks;
+                   });
+  for (auto *c : channels) {
+    out << fmt::format("channel {}: {} messages, {} words, writer waited {}, "
+                       "reader waited {}",
+                       c->name, c->messages, c->words, c->writerWaitTicks,
+                       c->readerWaitTicks);
+    if (c->messages > 0) {
+      out << fmt::format(", transfers at ticks {}-{}", c->firstTick,
+                         c->lastTick);
+    }
+    out << "\n";
+    auto printEnd = [&](uint32_t proc, uint32_t slot, const EndpointStats &e) {
+      out << fmt::format("  processor {} slot {}: {} sent, {} received, "
+                         "writer waited {}, reader waited {}\n",
+                         proc, slot, e.sent, e.received, e.writerWaitTicks,
+                         e.readerWaitTicks);
+    };
+    printEnd(c->edge.procA, c->edge.slotA, c->a);
+    printEnd(c->edge.procB, c->edge.slotB, c->b);
+  }
+}
+
+/// Escape a string for a JSON string literal.
+inline std::string jsonEscape(std::string_view s) {
+  std::string escaped;
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    case '\t':
+      escaped += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        escaped += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+      } else {
+        escaped += c;
+      }
+    }
+  }
+  return escaped;
+}
+
+/// Write the statistics of a network run as JSON.
+inline void writeNetworkStatsJson(std::ostream &out, const NetworkStats &s) {
+  auto endpoint = [](uint32_t proc, uint32_t slot, const EndpointStats &e) {
+    return fmt::format("{{\"processor\": {}, \"slot\": {}, \"sent\": {}, "
+                       "\"received\": {}, \"words\": {}, "
+                       "\"writerWaitTicks\": {}, \"readerWaitTicks\": {}, "
+                       "\"firstTick\": {}, \"lastTick\": {}}}",
+                       proc, slot, e.sent, e.received, e.words,
+                       e.writerWaitTicks, e.readerWaitTicks, e.firstTick,
+                       e.lastTick);
+  };
+  out << fmt::format("{{\n  \"ticks\": {},\n  \"processors\": [", s.ticks);
+  for (size_t i = 0; i < s.processors.size(); i++) {
+    auto &p = s.processors[i];
+    out << fmt::format("{}\n    {{\"id\": {}, \"busyTicks\": {}, "
+                       "\"blockedTicks\": {}, \"haltedTicks\": {}}}",
+                       i > 0 ? "," : "", i, p.busyTicks, p.blockedTicks,
+                       p.haltedTicks);
+  }
+  out << "\n  ],\n  \"channels\": [";
+  for (size_t i = 0; i < s.channels.size(); i++) {
+    auto &c = s.channels[i];
+    out << fmt::format("{}\n    {{\"name\": \"{}\", \"messages\": {}, "
+                       "\"words\": {}, \"writerWaitTicks\": {}, "
+                       "\"readerWaitTicks\": {}, \"firstTick\": {}, "
+                       "\"lastTick\": {},\n     \"endpoints\": [{}, {}]}}",
+                       i > 0 ? "," : "", jsonEscape(c.name), c.messages,
+                       c.words, c.writerWaitTicks, c.readerWaitTicks,
+                       c.firstTick, c.lastTick,
+                       endpoint(c.edge.procA, c.edge.slotA, c.a),
+                       endpoint(c.edge.procB, c.edge.slotB, c.b));
+  }
+  out << "\n  ]\n}\n";
+}
+
+/// One processor's part in the critical path of a network run.
+struct CriticalPathProcessor {
+  uint64_t instructions = 0;         // instructions executed
+  uint64_t criticalInstructions = 0; // those on the critical path
+  uint64_t slack = 0; // instructions it could be delayed by without delaying
+                      // the run
+};
+
+/// The instructions a procedure of one processor contributes to the critical
+/// path.
+struct CriticalPathEntry {
+  unsigned processor = 0;
+  std::string procedure;
+  uint64_t instructions = 0;
+};
+
+/// The critical path of a round-robin network run, measured in instructions:
+/// the longest chain of compute segments linked by program order and channel
+/// rendezvous.
+struct CriticalPath {
+  uint64_t length = 0;
+  uint64_t rendezvous = 0; // rendezvous on the path
+  std::vector<CriticalPathProcessor> processors;
+  std::vector<CriticalPathEntry> procedures; // largest share first
+};
+
+/// Records the compute segments and channel rendezvous of a round-robin run as
+/// a happens-before graph. Each processor's instructions form a chain of
+/// segments, and a rendezvous ends the current segment of both partners and
+/// starts their next ones after whichever finished later.
+class CriticalPathRecorder {
+  static constexpr size_t NONE = ~size_t(0);
+
+  struct Segment {
+    uint64_t instructions = 0;
+    std::map<int, uint64_t> symbols; // debug symbol index -> instructions
+    size_t event = NONE;             // the rendezvous ending the segment
+  };
+
+  struct Event {
+    unsigned procA;
+    size_t segA;
+    unsigned procB;
+    size_t segB;
+  };
+
+  std::vector<std::vector<Segment>> segments; // per processor
+  std::vector<Event> events;                  // in the order they occurred
+
+public:
+  /// Start recording a run of numProcs processors.
+  void reset(size_t numProcs) {
+    segments.assign(numProcs, std::vector<Segment>(1));
+    events.clear();
+  }
+
+  /// Count an instruction of processor proc in the procedure with the given
+  /// debug symbol index (-1 if none).
+  void count(unsigned proc, int symbol) {
+    auto &segment = segments[proc].back();
+    segment.instructions++;
+    segment.symbols[symbol]++;
+  }
+
+  /// Record a rendezvous between processors a and b.
+  void rendezvous(unsigned a, unsigned b) {
+    segments[a].back().event = events.size();
+    segments[b].back().event = events.size();
+    events.push_back({a, segments[a].size() - 1, b, segments[b].size() - 1});
+    segments[a].emplace_back();
+    segments[b].emplace_back();
+  }
+
+  /// Find the critical path. A forward pass over the rendezvous in the order
+  /// they occurred gives the earliest time of each segment when every
+  /// instruction takes one cycle and a rendezvous none, and a backward pass
+  /// the latest time that does not delay the end of the run. The path is
+  /// traced back from the last processor to finish through the later partner
+  /// of each rendezvous. symbolName names a symbol index of a processor.
+  CriticalPath
+  analyse(const std::function<std::string(unsigned, int)> &symbolName) const {
+    CriticalPath path;
+    if (segments.empty()) {
+      return path;
+    }
+    std::vector<std::vector<uint64_t>> earliest, latest;
+    for (auto &chain : segments) {
+      earliest.emplace_back(chain.size(), 0);
+      latest.emplace_back(chain.size(), 0);
+    }
+    auto end = [&](unsigned proc, size_t seg) {
+      return earliest[proc][seg] + segments[proc][seg].instructions;
+    };
+    for (auto &e : events) {
+      auto time = std::max(end(e.procA, e.segA), end(e.procB, e.segB));
+      earliest[e.procA][e.segA + 1] = time;
+      earliest[e.procB][e.segB + 1] = time;
+    }
+    unsigned last = 0;
+    for (unsigned p = 0; p < segments.size(); p++) {
+      auto finish = end(p, segments[p].size() - 1);
+      if (finish > path.length) {
+        path.length = finish;
+        last = p;
+      }
+    }
+    // Latest start times, from the end of the run back.
+    for (unsigned p = 0; p < segments.size(); p++) {
+      auto &chain = segments[p];
+      latest[p].back() = path.length - chain.back().instructions;
+    }
+    for (auto it = events.rbegin(); it != events.rend(); ++it) {
+      auto time = std::min(latest[it->procA][it->segA + 1],
+                           latest[it->procB][it->segB + 1]);
+      latest[it->procA][it->segA] =
+          time - segments[it->procA][it->segA].instructions;
+      latest[it->procB][it->segB] =
+          time - segments[it->procB][it->segB].instructions;
+    }
+    for (unsigned p = 0; p < segments.size(); p++) {
+      CriticalPathProcessor stats;
+      stats.slack = path.length;
+      for (size_t i = 0; i < segments[p].size(); i++) {
+        stats.instructions += segments[p][i].instructions;
+        stats.slack = std::min(stats.slack, latest[p][i] - earliest[p][i]);
+      }
+      path.processors.push_back(stats);
+    }
+    // Trace the path back, attributing its instructions to procedures.
+    std::map<std::pair<unsigned, int>, uint64_t> shares;
+    unsigned proc = last;
+    size_t seg = segments[proc].size() - 1;
+    while (true) {
+      auto &segment = segments[proc][seg];
+      path.processors[proc].criticalInstructions += segment.instructions;
+      for (auto &[symbol, count] : segment.symbols) {
+        shares[{proc, symbol}] += count;
+      }
+      if (seg == 0) {
+        break;
+      }
+      auto &e = events[segments[proc][seg - 1].event];
+      path.rendezvous++;
+      if (end(e.procA, e.segA) >= end(e.procB, e.segB)) {
+        proc = e.procA;
+        seg = e.segA;
+      } else {
+        proc = e.procB;
+        seg = e.segB;
+      }
+    }
+    for (auto &[key, count] : shares) {
+      path.procedures.push_back(
+          {key.first, symbolName(key.first, key.second), count});
+    }
+    std::stable_sort(
+        path.procedures.begin(), path.procedures.end(),
+        [](const CriticalPathEntry &x, const CriticalPathEntry &y) {
+          return x.instructions > y.instructions;
+        });
+    return path;
+  }
+};
+
+/// Print the critical path of a network run as a ranked list of the
+/// procedures to speed up.
+inline void printCriticalPath(std::ostream &out, const CriticalPath &path) {
+  out << fmt::format("critical path: {} instructions, {} rendezvous\n",
+                     path.length, path.rendezvous);
+  for (size_t i = 0; i < path.processors.size(); i++) {
+    auto &p = path.processors[i];
+    out << fmt::format("processor {}: {} instructions, {} on the critical "
+                       "path, slack {}\n",
+                       i, p.instructions, p.criticalInstructions, p.slack);
+  }
+  out << "speed up:\n";
+  for (size_t i = 0; i < path.procedures.size(); i++) {
+    auto &e = path.procedures[i];
+    double share =
+        path.length > 0 ? 100.0 * e.instructions / path.length : 0.0;
+    out << fmt::format("{:>4}. processor {} {}: {} instructions ({:.1f}%)\n",
+                       i + 1, e.processor, e.procedure, e.instructions, share);
+  }
+}
+
+/// The instructions of a run executed on a source line.
+struct LineCount {
+  uint32_t line;
+  uint64_t instructions;
+};
+
+/// The line profile of a round-robin run: the instructions of the run, and
+/// those on each source line, most first.
+struct LineProfile {
+  uint64_t instructions = 0;
+  std::vector<LineCount> lines;
+};
+
+/// Print a line profile as a ranked list of hot spots, each with its line of
+/// the source if the source is given.
+inline void printLineProfile(std::ostream &out, const LineProfile &profile,
+                             const std::vector<std::string> &source = {}) {
+  uint64_t onLines = 0;
+  for (auto &l : profile.lines) {
+    onLines += l.instructions;
+  }
+  out << fmt::format("line profile: {} instructions, {} on source lines\n",
+                     profile.instructions, onLines);
+  for (size_t i = 0; i < profile.lines.size(); i++) {
+    auto &l = profile.lines[i];
+    double share = profile.instructions > 0
+                       ? 100.0 * l.instructions / profile.instructions
+                       : 0.0;
+    out << fmt::format("{:>4}. line {}: {} instructions ({:.1f}%)", i + 1,
+                       l.line, l.instructions, share);
+    if (l.line <= source.size()) {
+      auto text = std::string_view(source[l.line - 1]);
+      text.remove_prefix(std::min(text.find_first_not_of(" \t"), text.size()));
+      out << "  " << text;
+    }
+    out << "\n";
+  }
+}
+
+/// Records a timeline of a round-robin network run, buffered in memory until
+/// it is written as Chrome trace JSON for Perfetto or chrome://tracing, with
+/// one tick to a microsecond. Each processor has a track of the procedures it
+/// calls (a branch to the start of a debug symbol opens a span and a BRB
+/// closes it), the intervals it is blocked on a channel slot, a slice for
+/// each message it sends or receives with an arrow from the sender's to the
+/// receiver's, and its syscalls and halt.
+///
+/// With a sampling interval of more than one tick, a track instead samples
+/// the procedure its processor is in, or the slot it is blocked on, at the
+/// start of each interval, merging equal samples into one slice, and records
+/// at most one arrow per channel and one syscall per processor an interval.
+class TimelineRecorder {
+  static constexpr uint64_t NONE = ~uint64_t(0);
+
+  enum class Kind { CALL, BLOCKED, SEND, RECEIVE, SYSCALL, HALT };
+
+  struct Event {
+    Kind kind;
+    unsigned proc;
+    uint64_t time;
+    uint64_t duration = 0;
+    int symbol = -1;       // CALL: debug symbol index
+    unsigned slot = 0;     // BLOCKED, SEND, RECEIVE
+    unsigned channel = 0;  // BLOCKED, SEND, RECEIVE
+    bool writing = false;  // BLOCKED
+    uint32_t value = 0;    // SYSCALL: number, HALT: exit code
+    uint64_t flow = 0;     // SEND, RECEIVE: the arrow joining them
+  };
+
+  /// What a processor is doing: running in a procedure, or blocked on a slot.
+  struct State {
+    bool blocked = false;
+    int symbol = -1;
+    unsigned slot = 0;
+    unsigned channel = 0;
+    bool writing = false;
+    uint64_t since = 0;
+
+    bool same(const State &other) const {
+      return blocked == other.blocked && symbol == other.symbol &&
+             slot == other.slot && writing == other.writing;
+    }
+  };
+
+  struct Track {
+    std::vector<std::pair<int, uint64_t>> calls; // symbol, start time
+    std::optional<State> blocked;
+    std::optional<uint64_t> halted;
+    std::optional<State> sample; // the open sampled slice
+    uint64_t syscallInterval = NONE;
+  };
+
+  /// The sides of a channel's transfers waiting for the other side: the
+  /// arrows of messages sent and not yet received, or received first.
+  struct Pending {
+    std::deque<uint64_t> writers;
+    std::deque<uint64_t> readers;
+    uint64_t interval = NONE; // the last interval with an arrow
+  };
+
+  unsigned interval = 1;
+  std::vector<Track> tracks; // per processor
+  std::vector<Pending> pending; // per channel
+  std::vector<Event> events;
+  uint64_t nextFlow = 1;
+
+  bool sampled() const { return interval > 1; }
+
+  Event slice(unsigned proc, const State &s, uint64_t end) const {
+    Event e{s.blocked ? Kind::BLOCKED : Kind::CALL, proc, s.since,
+            end - s.since};
+    e.symbol = s.symbol;
+    e.slot = s.slot;
+    e.channel = s.channel;
+    e.writing = s.writing;
+    return e;
+  }
+
+  /// Close a processor's sampled slice at a time.
+  void closeSample(unsigned proc, uint64_t time) {
+    auto &t = tracks[proc];
+    if (t.sample) {
+      events.push_back(slice(proc, *t.sample, time));
+      t.sample.reset();
+    }
+  }
+
+public:
+  /// Start recording a run of numProcs processors and numChannels channels,
+  /// sampling every interval ticks (one to record every event).
+  void reset(size_t numProcs, size_t numChannels, unsigned value) {
+    interval = std::max(1U, value);
+    tracks.assign(numProcs, Track());
+    pending.assign(numChannels, Pending());
+    events.clear();
+    nextFlow = 1;
+  }
+
+  /// Record processor proc calling the procedure with a debug symbol index.
+  void call(unsigned proc, uint64_t time, int symbol) {
+    tracks[proc].calls.push_back({symbol, time});
+  }
+
+  /// Record processor proc returning from its innermost call, if any (a BRB
+  /// outside a call is not a return).
+  void ret(unsigned proc, uint64_t time) {
+    auto &calls = tracks[proc].calls;
+    if (calls.empty()) {
+      return;
+    }
+    if (!sampled()) {
+      State s;
+      s.symbol = calls.back().first;
+      s.since = calls.back().second;
+      events.push_back(slice(proc, s, time));
+    }
+    calls.pop_back();
+  }
+
+  /// Record processor proc blocking on a link slot wired to a channel.
+  void block(unsigned proc, uint64_t time, unsigned slot, unsigned channel,
+             bool writing) {
+    tracks[proc].blocked = State{true, -1, slot, channel, writing, time};
+  }
+
+  /// Record processor proc's side of a transfer on a link slot, which ends
+  /// any interval it was blocked for. The two sides of a transfer are paired
+  /// in whichever order they arrive, and a FIFO channel holds the writers'
+  /// sides until they are read.
+  void transfer(unsigned proc, uint64_t time, unsigned slot, unsigned channel,
+                bool writing) {
+    auto &t = tracks[proc];
+    if (t.blocked) {
+      if (!sampled()) {
+        events.push_back(slice(proc, *t.blocked, time));
+      }
+      t.blocked.reset();
+    }
+    auto &p = pending[channel];
+    auto &partners = writing ? p.readers : p.writers;
+    uint64_t flow = 0;
+    if (!partners.empty()) {
+      flow = partners.front();
+      partners.pop_front();
+    } else {
+      if (!sampled() || p.interval != time / interval) {
+        flow = nextFlow++;
+        p.interval = time / interval;
+      }
+      (writing ? p.writers : p.readers).push_back(flow);
+    }
+    if (flow != 0) {
+      Event e{writing ? Kind::SEND : Kind::RECEIVE, proc, time};
+      e.slot = slot;
+      e.channel = channel;
+      e.flow = flow;
+      events.push_back(e);
+    }
+  }
+
+  /// Record processor proc performing a syscall.
+  void syscall(unsigned proc, uint64_t time, uint32_t number) {
+    auto &t = tracks[proc];
+    if (sampled() && t.syscallInterval == time / interval) {
+      return;
+    }
+    t.syscallInterval = time / interval;
+    Event e{Kind::SYSCALL, proc, time};
+    e.value = number;
+    events.push_back(e);
+  }
+
+  /// Record processor proc halting with an exit code.
+  void halt(unsigned proc, uint64_t time, int exitCode) {
+    tracks[proc].halted = time;
+    closeSample(proc, time);
+    Event e{Kind::HALT, proc, time};
+    e.value = static_cast<uint32_t>(exitCode);
+    events.push_back(e);
+  }
+
+  /// Sample what each processor is doing at the start of a tick, if it
+  /// starts an interval.
+  void sample(uint64_t time) {
+    if (!sampled() || time % interval != 0) {
+      return;
+    }
+    for (unsigned p = 0; p < tracks.size(); p++) {
+      auto &t = tracks[p];
+      if (t.halted) {
+        continue;
+      }
+      State now;
+      if (t.blocked) {
+        now = *t.blocked;
+      } else if (!t.calls.empty()) {
+        now.symbol = t.calls.back().first;
+      }
+      if (t.sample && !t.sample->same(now)) {
+        closeSample(p, time);
+      }
+      // Code outside any procedure (the start-up code) is not shown.
+      if (!t.sample && (now.blocked || now.symbol >= 0)) {
+        now.since = time;
+        t.sample = now;
+      }
+    }
+  }
+
+  /// Write the timeline as Chrome trace JSON, closing the spans still open
+  /// at the end time (those of a processor that halted, at its halt).
+  /// symbolName names a symbol index of a processor, and channelName a
+  /// channel index.
+  void writeJson(std::ostream &out, uint64_t end,
+                 const std::function<std::string(unsigned, int)> &symbolName,
+                 const std::function<std::string(unsigned)> &channelName)
+      const {
+    std::vector<Event> all(events);
+    for (unsigned p = 0; p < tracks.size(); p++) {
+      auto &t = tracks[p];
+      auto until = t.halted.value_or(end);
+      if (t.sample) {
+        all.push_back(slice(p, *t.sample, until));
+      }
+      if (sampled()) {
+        continue;
+      }
+      if (t.blocked) {
+        all.push_back(slice(p, *t.blocked, until));
+      }
+      for (auto &[symbol, since] : t.calls) {
+        State s;
+        s.symbol = symbol;
+        s.since = since;
+        all.push_back(slice(p, s, until));
+      }
+    }
+    out << "{\"traceEvents\": [\n";
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, "
+           "\"args\": {\"name\": \"hexsim\"}}";
+    for (unsigned p = 0; p < tracks.size(); p++) {
+      out << fmt::format(",\n{{\"name\": \"thread_name\", \"ph\": \"M\", "
+                         "\"pid\": 0, \"tid\": {0}, "
+                         "\"args\": {{\"name\": \"processor {0}\"}}}}",
+                         p);
+      out << fmt::format(",\n{{\"name\": \"thread_sort_index\", \"ph\": "
+                         "\"M\", \"pid\": 0, \"tid\": {0}, "
+                         "\"args\": {{\"sort_index\": {0}}}}}",
+                         p);
+    }
+    for (auto &e : all) {
+      auto common = fmt::format("\"pid\": 0, \"tid\": {}, \"ts\": {}", e.proc,
+                                e.time);
+      switch (e.kind) {
+      case Kind::CALL:
+        out << fmt::format(",\n{{\"name\": \"{}\", \"cat\": \"{}\", "
+                           "\"ph\": \"X\", {}, \"dur\": {}}}",
+                           jsonEscape(symbolName(e.proc, e.symbol)),
+                           sampled() ? "sample" : "call", common, e.duration);
+        break;
+      case Kind::BLOCKED:
+        out << fmt::format(",\n{{\"name\": \"blocked {} slot {}\", "
+                           "\"cat\": \"blocked\", \"ph\": \"X\", {}, "
+                           "\"dur\": {}, \"args\": {{\"channel\": \"{}\"}}}}",
+                           e.writing ? "writing" : "reading", e.slot, common,
+                           e.duration, jsonEscape(channelName(e.channel)));
+        break;
+      case Kind::SEND:
+      case Kind::RECEIVE:
+        out << fmt::format(",\n{{\"name\": \"{} {}\", \"cat\": "
+                           "\"rendezvous\", \"ph\": \"X\", {}, \"dur\": 0, "
+                           "\"bind_id\": {}, \"{}\": true, "
+                           "\"args\": {{\"slot\": {}}}}}",
+                           e.kind == Kind::SEND ? "send" : "receive",
+                           jsonEscape(channelName(e.channel)), common, e.flow,
+                           e.kind == Kind::SEND ? "flow_out" : "flow_in",
+                           e.slot);
+        break;
+      case Kind::SYSCALL:
+        out << fmt::format(",\n{{\"name\": \"{}\", \"cat\": \"syscall\", "
+                           "\"ph\": \"i\", \"s\": \"t\", {}}}",
+                           hex::syscallEnumToStr(
+                               static_cast<hex::Syscall>(e.value)),
+                           common);
+        break;
+      case Kind::HALT:
+        out << fmt::format(",\n{{\"name\": \"halt\", \"cat\": \"halt\", "
+                           "\"ph\": \"i\", \"s\": \"t\", {}, "
+                           "\"args\": {{\"exitCode\": {}}}}}",
+                           common, static_cast<int>(e.value));
+        break;
+      }
+    }
+    out << "\n]}\n";
+  }
+};
+
+/// The wait-for graph of a round-robin run as a forest of link-cut trees,
+/// over processor ids. A blocked processor is linked under the partner it
+/// waits for and cut when it is unblocked, so each tree is rooted at a running
+/// or halted processor, or at the processor that closed a cycle, which is
+/// left unlinked. Finding the root of a processor takes amortised logarithmic
+/// time, however long the chain of processors waiting on each other.
+class WaitForForest {
+  static constexpr unsigned NONE = std::numeric_limits<unsigned>::max();
+  // Each preferred path is a splay tree ordered from the root of the tree
+  // (left) to its deepest node (right). parent is the splay tree parent or,
+  // for the root of a splay tree, the path-parent.
+  std::vector<std::array<unsigned, 2>> child;
+  std::vector<unsigned> parent;
+
+  bool isSplayRoot(unsigned x) const {
+    auto p = parent[x];
+    return p == NONE || (child[p][0] != x && child[p][1] != x);
+  }
+
+  void rotate(unsigned x) {
+    auto y = parent[x];
+    auto z = parent[y];
+    int dir = child[y][1] == x;
+    if (!isSplayRoot(y)) {
+      child[z][child[z][1] == y] = x;
+    }
+    parent[x] = z;
+    child[y][dir] = child[x][!dir];
+    if (child[x][!dir] != NONE) {
+      parent[child[x][!dir]] = y;
+    }
+    child[x][!dir] = y;
+    parent[y] = x;
+  }
+
+  void splay(unsigned x) {
+    while (!isSplayRoot(x)) {
+      auto y = parent[x];
+      if (!isSplayRoot(y)) {
+        auto z = parent[y];
+        rotate((child[y][0] == x) == (child[z][0] == y) ? y : x);
+      }
+      rotate(x);
+    }
+  }
+
+  /// Make the path from the root of x's tree to x preferred, with x at the
+  /// root of its splay tree.
+  void access(unsigned x) {
+    for (unsigned last = NONE, y = x; y != NONE; last = y, y = parent[y]) {
+      splay(y);
+      child[y][1] = last;
+    }
+    splay(x);
+  }
+
+public:
+  void reset(size_t n) {
+    child.assign(n, {NONE, NONE});
+    parent.assign(n, NONE);
+  }
+
+  /// Return the root of the tree containing x.
+  unsigned root(unsigned x) {
+    access(x);
+    while (child[x][0] != NONE) {
+      x = child[x][0];
+    }
+    splay(x);
+    return x;
+  }
+
+  /// Link the root x under y.
+  void link(unsigned x, unsigned y) {
+    access(x);
+    parent[x] = y;
+  }
+
+  /// Cut x from its parent, if it has one.
+  void cut(unsigned x) {
+    if (x >= parent.size()) {
+      return;
+    }
+    access(x);
+    auto above = child[x][0];
+    if (above != NONE) {
+      parent[above] = NONE;
+      child[x][0] = NONE;
+    }
+  }
+};
+
+/// The FIFO of a channel in the buffered what-if mode.
+struct ChannelBuffer {
+  std::string name;
+  unsigned depth = 0; // messages it can hold
+  size_t peak = 0;    // most it held at once
+};
+
+/// Print the comparison of a run with buffered channels against the
+/// synchronous baseline (none if it did not complete), and how full each FIFO
+/// became.
+inline void printBufferReport(std::ostream &out,
+                              std::optional<uint64_t> baselineTicks,
+                              uint64_t bufferedTicks,
+                              const std::vector<ChannelBuffer> &buffers) {
+  out << "buffered channels: performance exploration only, the hardware's "
+         "channels are synchronous\n";
+  if (baselineTicks) {
+    double speedup = bufferedTicks > 0 ? static_cast<double>(*baselineTicks) /
+                                             bufferedTicks
+                                       : 0.0;
+    out << fmt::format("synchronous: {} ticks\nbuffered: {} ticks ({:.2f}x)\n",
+                       *baselineTicks, bufferedTicks, speedup);
+  } else {
+    out << fmt::format("synchronous: did not complete\nbuffered: {} ticks\n",
+                       bufferedTicks);
+  }
+  for (auto &b : buffers) {
+    out << fmt::format("channel {}: depth {}, peak {}\n", b.name, b.depth,
+                       b.peak);
+  }
+}
+
+/// Print the utilisation of each worker thread in a parallel run.
+inline void printWorkerStats(std::ostream &out,
+                             const std::vector<WorkerStats> &stats) {
+  for (size_t w = 0; w < stats.size(); w++) {
+    auto &s = stats[w];
+    double busy =
+        s.totalSeconds > 0 ? 100.0 * s.busySeconds / s.totalSeconds : 0.0;
+    out << fmt::format("worker {}: {} slices, {} instructions, {} steals, "
+                       "{:.1f}% busy\n",
+                       w, s.slices, s.instructions, s.steals, busy);
+  }
+}
+
+/// State shared by the worker threads of a parallel run, in which the
+/// processors are multiplexed onto a pool of host threads (see
+/// System::setParallel).
+struct ParallelState {
+  std::vector<Processor *> procs;
+  std::vector<std::unique_ptr<RunQueue>> queues; // one per worker
+  // Counts pushes to the queues and stops, so an idle worker can sleep until
+  // there is work or the run ends.
+  std::atomic<uint64_t> epoch{0};
+  // Processors neither parked on a channel nor stopped, and processors that
+  // have not halted. When no processor is running but some are live, the
+  // network is deadlocked.
+  std::atomic<unsigned> running{0};
+  std::atomic<unsigned> live{0};
+  // Counts wakes, so a processor ordering a syscall can detect a waker handing
+  // its logical time to a parked partner while it scans the others.
+  std::atomic<uint64_t> wakes{0};
+  // The first processor to exit, in the sequential order.
+  std::atomic<int> firstExit{-1};
+  std::atomic<bool> stop{false};
+  std::atomic<bool> deadlocked{false};
+  std::atomic<bool> timedOut{false};
 };
 
 class Processor {
@@ -70,28 +1104,129 @@ class Processor {
   StepResult status = StepResult::RUNNING;
   std::array<Channel *, hex::NUM_LINKS> links{}; // slot -> channel (null if
                                                  // unwired)
+  std::array<Processor *, hex::NUM_LINKS> partners{}; // slot -> other end
   unsigned blockedSlot = 0; // slot this processor is blocked on
+  bool blockedWriting = false; // blocked as the writer rather than the reader
+  Processor *waitsFor = nullptr; // wait-for graph edge while blocked
+  WaitForForest *waitForest = nullptr; // cut from when unblocked, if set
+  std::array<EndpointStats, hex::NUM_LINKS> linkStats{}; // per slot
+  Processor *woken = nullptr; // partner unblocked by the last step
+  uint64_t outputs = 0;       // output syscalls executed
+  bool waitingInput = false;  // coroutine suspended until input is available
+  CriticalPathRecorder *recorder = nullptr; // records segments if set
+  TimelineRecorder *timeline = nullptr;     // records a timeline if set
+
+  // PDES run state. time is the simulated time of the next instruction, and
+  // a processor waiting for a message or an acknowledgement records the
+  // channel it waits on. Syscalls are left pending for System to perform in
+  // simulated-time order.
+  enum class TimedWait { NONE, MESSAGE, ACK };
+  bool pdes = false;
+  uint64_t linkLatency = 1;
+  uint64_t simTime = 0;
+  uint64_t windowEnd = 0;
+  bool timeSet = false;
+  bool syscallPending = false;
+  TimedWait timedWait = TimedWait::NONE;
+  Channel *waitChannel = nullptr;
+
+  // Parallel run state. tick is the round of the sequential scheduler in which
+  // the next instruction would execute (a round-robin run also sets it to time
+  // transfers), and time publishes it to the other threads (NEVER while parked
+  // or stopped). While parked, the partner completing the rendezvous stores
+  // the resume tick tagged with WOKEN_BIT. The parking worker and the waking
+  // partner each count into handshake, and the second to arrive requeues the
+  // processor. A parked processor's transfer is described by its pending
+  // fields.
+  static constexpr uint64_t NEVER = ~0ULL;
+  static constexpr uint64_t WOKEN_BIT = 1ULL << 63;
+  ParallelState *parallel = nullptr;
+  unsigned worker = 0; // the worker running the current slice
+  bool yielded = false;
+  uint64_t tick = 0;
+  std::atomic<uint64_t> time{0};
+  std::atomic<uint32_t> handshake{0};
+  bool pendingBlock = false;
+  uint32_t pendingAddress = 0;
+  uint32_t pendingCount = 0;
+  std::exception_ptr error;
 
   // State for tracing.
   uint32_t lastPC;
   size_t cycles;
   size_t maxCycles;
   hex::Instr instrEnum;
-  std::vector<std::pair<std::string, unsigned>> debugInfo;
-  std::map<std::string, unsigned> debugInfoMap;
-
-  /// Lookup a symbol name given the current PC: the symbol with the greatest
-  /// offset <= lastPC. debugInfo is sorted by ascending offset.
-  const char *lookupSymbol() {
-    auto it = std::upper_bound(
-        debugInfo.begin(), debugInfo.end(), lastPC,
-        [](uint32_t pc, const std::pair<std::string, unsigned> &entry) {
-          return pc < entry.second;
-        });
-    if (it == debugInfo.begin()) {
-      return nullptr; // lastPC is before the first symbol.
+  // The debug-info block of the image and what keeps its bytes alive. Its
+  // symbol index is viewed the first time a symbol is needed.
+  std::string_view debugBytes;
+  std::shared_ptr<const void> debugOwner;
+  mutable std::once_flag debugParsed;
+  mutable heximage::SymbolIndex symbolIndex;
+  // The range of PCs [symbolLow, symbolHigh) the last symbol looked up by
+  // cachedSymbolIndex covers, so that successive instructions in the same
+  // procedure need no search.
+  uint32_t symbolLow = 0;
+  uint32_t symbolHigh = 0;
+  int symbolCached = -1;
+  // The line table of the debug-info block, decoded the first time it is
+  // needed, and with a line profile the instructions executed in the code of
+  // each entry (lineCounts[0] counting the code before the first). As with
+  // symbols, [lineLow, lineHigh) is the range of PCs of the last entry.
+  mutable std::once_flag linesParsed;
+  mutable std::vector<heximage::Line> lineTable;
+  bool lineProfile = false;
+  std::vector<uint64_t> lineCounts;
+  uint32_t lineLow = 0;
+  uint32_t lineHigh = 0;
+  size_t lineCached = 0;
+
+  /// Return the debug symbols, sorted by ascending offset, viewing them on
+  /// first use.
+  const heximage::SymbolIndex &symbols() const {
+    std::call_once(debugParsed,
+                   [this] { symbolIndex = heximage::SymbolIndex(debugBytes); });
+    return symbolIndex;
+  }
+
+  /// Lookup the index of the symbol covering a PC: the symbol with the
+  /// greatest offset <= pc, or -1 if pc is before the first symbol.
+  int lookupSymbolIndex(uint32_t pc) const { return symbols().find(pc); }
+
+  /// Return the source lines of the code, sorted by ascending offset, decoding
+  /// them on first use.
+  const std::vector<heximage::Line> &lines() const {
+    std::call_once(linesParsed,
+                   [this] { lineTable = heximage::readLines(debugBytes); });
+    return lineTable;
+  }
+
+  /// Count an instruction at a PC towards the line table entry covering it.
+  void countLine(uint32_t pc) {
+    if (pc - lineLow >= lineHigh - lineLow) {
+      auto &table = lines();
+      auto it = std::upper_bound(
+          table.begin(), table.end(), pc,
+          [](uint32_t pc, const heximage::Line &l) { return pc < l.offset; });
+      lineCached = it - table.begin();
+      lineLow = lineCached == 0 ? 0 : table[lineCached - 1].offset;
+      lineHigh = it == table.end() ? UINT32_MAX : it->offset;
+    }
+    lineCounts[lineCached]++;
+  }
+
+  /// Lookup the index of the symbol covering a PC through the range of the
+  /// last one looked up.
+  int cachedSymbolIndex(uint32_t pc) {
+    if (pc - symbolLow < symbolHigh - symbolLow) {
+      return symbolCached;
     }
-    return std::prev(it)->first.c_str();
+    auto &index = symbols();
+    symbolCached = index.find(pc);
+    symbolLow = symbolCached < 0 ? 0 : index.offset(symbolCached);
+    symbolHigh = static_cast<size_t>(symbolCached + 1) < index.size()
+                     ? index.offset(symbolCached + 1)
+                     : UINT32_MAX;
+    return symbolCached;
   }
 
 public:
@@ -104,43 +1239,111 @@ public:
   void setTruncateInputs(bool value) { truncateInputs = value; }
 
   void setId(unsigned value) { id = value; }
-  void setLink(unsigned slot, Channel *channel) { links[slot] = channel; }
+  void setLink(unsigned slot, Channel *channel, Processor *partner) {
+    links[slot] = channel;
+    partners[slot] = partner;
+  }
   StepResult getStatus() const { return status; }
   int getExitCode() const { return exitCode; }
   unsigned getBlockedSlot() const { return blockedSlot; }
+  /// Return the partner this processor waits for while it is blocked.
+  Processor *getWaitsFor() const { return waitsFor; }
+  /// Describe the channel operation this processor is blocked on.
+  std::string describeBlocked() const {
+    return fmt::format("processor {} ({} slot {} in {})", id,
+                       blockedWriting ? "writing" : "reading", blockedSlot,
+                       getSymbolName(lookupSymbolIndex(pc)));
+  }
+  unsigned getId() const { return id; }
+  uint64_t getOutputs() const { return outputs; }
+  /// Return the number of instructions this processor has executed.
+  uint64_t getInstructions() const { return cycles; }
+  bool isWaitingInput() const { return waitingInput; }
+  bool isSyscallPending() const { return syscallPending; }
+  uint64_t getSimTime() const { return simTime; }
+  void setInputReady(std::function<bool(int)> hook) {
+    io.setInputReady(std::move(hook));
+  }
+  /// Do I/O through a port of a hub shared with the rest of a network.
+  void setIOHub(hex::IOHub *hub) { io.setHub(hub, id); }
+  /// Record this processor's instructions and rendezvous (null to stop).
+  void setRecorder(CriticalPathRecorder *value) { recorder = value; }
+  /// Record this processor's calls, waits and transfers (null to stop).
+  void setTimeline(TimelineRecorder *value) { timeline = value; }
+  /// Remove this processor's edge from a wait-for forest when it is unblocked
+  /// (null to stop).
+  void setWaitForest(WaitForForest *value) { waitForest = value; }
+  /// Count the instructions this processor executes on each source line of
+  /// its line table, from zero.
+  void setLineProfile(bool value) {
+    lineProfile = value;
+    lineCounts.assign(value ? lines().size() + 1 : 0, 0);
+    lineLow = lineHigh = 0;
+  }
+  /// Return the instructions counted on each source line (0 for code without
+  /// one).
+  std::map<uint32_t, uint64_t> getLineProfile() const {
+    std::map<uint32_t, uint64_t> counts;
+    for (size_t i = 0; i < lineCounts.size(); i++) {
+      if (lineCounts[i] > 0) {
+        counts[i == 0 ? 0 : lineTable[i - 1].line] += lineCounts[i];
+      }
+    }
+    return counts;
+  }
+  /// Return the name of the debug symbol with the given index, or "?" if it
+  /// is out of range (no symbol covers the code before the first).
+  std::string getSymbolName(int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= symbols().size()) {
+      return "?";
+    }
+    return std::string(symbolIndex.name(index));
+  }
+  /// Set the round-robin tick in which the next instruction executes.
+  void setTick(uint64_t value) { tick = value; }
+  /// Return the traffic through a link slot.
+  const EndpointStats &getLinkStats(unsigned slot) const {
+    return linkStats[slot];
+  }
+  /// Count a tick spent waiting on the channel this processor blocked on.
+  void countWaitTick() {
+    auto &s = linkStats[blockedSlot];
+    (blockedWriting ? s.writerWaitTicks : s.readerWaitTicks)++;
+  }
+  /// Return the partner the last step unblocked, if any, and clear it.
+  Processor *takeWoken() { return std::exchange(woken, nullptr); }
+
+  /// Load an image, copying or decompressing the code straight into memory.
+  /// The debug info is parsed when it is first needed, from the bytes owner
+  /// keeps alive. An image is loaded once. Returns the program size in bytes.
+  unsigned loadImage(const hexcontainer::ImageView &image,
+                     std::shared_ptr<const void> owner) {
+    if (image.programWords > MEMORY_SIZE_WORDS) {
+      throw std::runtime_error("image does not fit in memory");
+    }
+    // A truncated image loads the code that is present.
+    hexcontainer::loadCode(image, reinterpret_cast<char *>(memory.data()),
+                           MEMORY_SIZE_WORDS * 4);
+    debugBytes = image.symbols;
+    debugOwner = std::move(owner);
+    return image.programWords << 2;
+  }
 
   /// Load a single image (size-word + code + optional debug info) from a
   /// stream. imageSizeBytes is the total number of bytes the image occupies.
   /// Returns the program size in bytes.
   unsigned loadFromStream(std::istream &file, unsigned imageSizeBytes) {
-    // Check the image length matches.
-    unsigned remainingFileSize = imageSizeBytes - 4;
-    remainingFileSize =
-        (remainingFileSize + 3U) & ~3U; // Round up to multiple of 4.
-    unsigned programSize = heximage::readU32(file) << 2;
-
-    // Read the instructions into memory.
-    file.read(reinterpret_cast<char *>(memory.data()), programSize);
-
-    // Read debug data (if present).
-    if (remainingFileSize > programSize) {
-      for (const auto &symbol : heximage::readSymbols(file)) {
-        debugInfo.push_back(std::make_pair(symbol.name, symbol.offset));
-        debugInfoMap[symbol.name] = symbol.offset;
-      }
-    }
-
-    return programSize;
+    auto bytes = std::make_shared<std::string>(imageSizeBytes, '\0');
+    file.read(bytes->data(), imageSizeBytes);
+    bytes->resize(file.gcount());
+    return loadImage(hexcontainer::splitImage(*bytes), bytes);
   }
 
   /// Load a binary file as this processor's single image.
   void load(const char *filename, bool dumpContents = false) {
-    std::ifstream file(filename, std::ios::binary);
-    file.seekg(0, std::ios::end);
-    auto fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    auto file = std::make_shared<hexcontainer::MappedFile>(filename);
     unsigned programSize =
-        loadFromStream(file, static_cast<unsigned>(fileSize));
+        loadImage(hexcontainer::splitImage(file->bytes()), file);
 
     // Print the contents of the binary.
     if (dumpContents) {
@@ -165,18 +1368,37 @@ public:
       out << fmt::format("read {} to mem[{:08x}]\n", memory[spWordIndex + 1],
                          (spWordIndex + 1));
       break;
+    case hex::Syscall::WRITES:
+      out << fmt::format("writes mem[{:08x}] ({} chars) to simout({})\n",
+                         memory[spWordIndex + 2],
+                         memory[memory[spWordIndex + 2]] & 0xFF,
+                         memory[spWordIndex + 3]);
+      break;
+    case hex::Syscall::READS:
+      out << fmt::format("reads {} chars to mem[{:08x}]\n",
+                         memory[spWordIndex + 1], memory[spWordIndex + 2]);
+      break;
+    case hex::Syscall::WRITEN:
+      out << fmt::format("writen mem[{:08x}] ({} words) to simout({})\n",
+                         memory[spWordIndex + 2], memory[spWordIndex + 3],
+                         memory[spWordIndex + 4]);
+      break;
+    case hex::Syscall::READN:
+      out << fmt::format("readn {} words to mem[{:08x}]\n",
+                         memory[spWordIndex + 1], memory[spWordIndex + 2]);
+      break;
     default:
       break;
     }
   }
 
   void trace(uint32_t instr, hex::Instr instrEnum) {
-    if (debugInfo.size()) {
-      auto symbolName = lookupSymbol();
+    if (!symbols().empty()) {
+      auto index = cachedSymbolIndex(lastPC);
       std::string symbolInfo;
-      if (symbolName) {
-        auto symbolOffset = lastPC - debugInfoMap[symbolName];
-        symbolInfo = fmt::format("{}+{}", symbolName, symbolOffset);
+      if (index >= 0) {
+        symbolInfo = fmt::format("{}+{}", symbolIndex.name(index),
+                                 lastPC - symbolIndex.offset(index));
       }
       out << fmt::format("{:<6d} {:<6d} {:<12} {:<4} {:<2d} ", cycles, lastPC,
                          symbolInfo, instrEnumToStr(instrEnum), (instr & 0xF));
@@ -221,8 +1443,30 @@ public:
     case hex::Instr::BR:
       out << fmt::format("pc = pc + oreg ({}) ({:#08x})\n", oreg, (pc + oreg));
       break;
-    case hex::Instr::BRZ:
-      out << fmt::format("pc = areg == zero ? pc + oreg ({}) ({:#08x}) : pc\n",
+    case hex::Instr::SPI: {
+      auto offset = hex::spiOffset(oreg);
+      auto address = memory[1] + offset;
+      switch (hex::spiOp(oreg)) {
+      case hex::SpiInstr::LDAS:
+        out << fmt::format("LDAS areg = mem[sp ({}) + {} = {:#08x}] ({})\n",
+                           memory[1], (int)offset, address, memory[address]);
+        break;
+      case hex::SpiInstr::LDBS:
+        out << fmt::format("LDBS breg = mem[sp ({}) + {} = {:#08x}] ({})\n",
+                           memory[1], (int)offset, address, memory[address]);
+        break;
+      case hex::SpiInstr::STAS:
+        out << fmt::format("STAS mem[sp ({}) + {} = {:#08x}] = areg ({})\n",
+                           memory[1], (int)offset, address, areg);
+        break;
+      default:
+        out << "\n";
+        break;
+      }
+      break;
+    }
+    case hex::Instr::BRZ:
+      out << fmt::format("pc = areg == zero ? pc + oreg ({}) ({:#08x}) : pc\n",
                          oreg, (pc + oreg));
       break;
     case hex::Instr::BRN:
@@ -250,10 +1494,42 @@ public:
         out << fmt::format("SUB areg = areg ({}) - breg ({}) ({})\n", areg,
                            breg, (areg - breg));
         break;
+      case hex::OprInstr::MUL:
+        out << fmt::format("MUL areg = areg ({}) * breg ({}) ({})\n", areg,
+                           breg, (areg * breg));
+        break;
+      case hex::OprInstr::DIV:
+        out << fmt::format("DIV areg = areg ({}) / breg ({}) ({})\n", areg,
+                           breg, hex::oprDiv(areg, breg));
+        break;
+      case hex::OprInstr::LSH:
+        out << fmt::format("LSH areg = areg ({}) << breg ({}) ({})\n", areg,
+                           breg, hex::oprLsh(areg, breg));
+        break;
+      case hex::OprInstr::RSH:
+        out << fmt::format("RSH areg = areg ({}) >> breg ({}) ({})\n", areg,
+                           breg, hex::oprRsh(areg, breg));
+        break;
+      case hex::OprInstr::AND:
+        out << fmt::format("AND areg = areg ({}) & breg ({}) ({})\n", areg,
+                           breg, (areg & breg));
+        break;
+      case hex::OprInstr::OR:
+        out << fmt::format("OR areg = areg ({}) | breg ({}) ({})\n", areg,
+                           breg, (areg | breg));
+        break;
+      case hex::OprInstr::XOR:
+        out << fmt::format("XOR areg = areg ({}) ^ breg ({}) ({})\n", areg,
+                           breg, (areg ^ breg));
+        break;
       case hex::OprInstr::IN:
         break;
       case hex::OprInstr::OUT:
         break;
+      case hex::OprInstr::INN:
+        break;
+      case hex::OprInstr::OUTN:
+        break;
       case hex::OprInstr::SVC:
         break;
       };
@@ -263,12 +1539,14 @@ public:
 
   void syscall() {
     unsigned spWordIndex = memory[1];
+    io.setTime(pdes ? simTime : tick);
     switch (static_cast<hex::Syscall>(areg)) {
     case hex::Syscall::EXIT:
       exitCode = memory[spWordIndex + 2];
       running = false;
       break;
     case hex::Syscall::WRITE:
+      outputs++;
       io.output(memory[spWordIndex + 2], memory[spWordIndex + 3]);
       break;
     case hex::Syscall::READ: {
@@ -276,6 +1554,26 @@ public:
       memory[spWordIndex + 1] = truncateInputs ? value & 0xFF : value;
       break;
     }
+    case hex::Syscall::WRITES:
+      outputs++;
+      io.outputString(memory.data(), memory.size(), memory[spWordIndex + 2],
+                      memory[spWordIndex + 3]);
+      break;
+    case hex::Syscall::READS:
+      memory[spWordIndex + 1] = io.inputString(
+          memory.data(), memory.size(), memory[spWordIndex + 2],
+          memory[spWordIndex + 3], memory[spWordIndex + 4]);
+      break;
+    case hex::Syscall::WRITEN:
+      outputs++;
+      io.outputWords(memory.data(), memory.size(), memory[spWordIndex + 2],
+                     memory[spWordIndex + 3], memory[spWordIndex + 4]);
+      break;
+    case hex::Syscall::READN:
+      memory[spWordIndex + 1] = io.inputWords(
+          memory.data(), memory.size(), memory[spWordIndex + 2],
+          memory[spWordIndex + 3], memory[spWordIndex + 4], truncateInputs);
+      break;
     default:
       throw std::runtime_error("invalid syscall: " + std::to_string(areg));
     }
@@ -287,6 +1585,20 @@ public:
     pc = pc + 1;
     oreg = 0;
     cycles++;
+    if (recorder) {
+      recorder->count(id, cachedSymbolIndex(lastPC));
+    }
+    if (lineProfile) {
+      countLine(lastPC);
+    }
+  }
+
+  /// Record a branch to the start of a procedure as a call of it.
+  void recordCall() {
+    auto index = cachedSymbolIndex(pc);
+    if (index >= 0 && symbolIndex.offset(index) == pc) {
+      timeline->call(id, tick, index);
+    }
   }
 
   /// Resume a partner that was parked on a blocking channel operation: advance
@@ -294,6 +1606,10 @@ public:
   void unblockAdvance() {
     advanceInstr();
     status = StepResult::RUNNING;
+    waitsFor = nullptr;
+    if (waitForest) {
+      waitForest->cut(id);
+    }
   }
 
   void traceChannel(hex::OprInstr opr, unsigned slot) {
@@ -302,9 +1618,73 @@ public:
                        oprInstrEnumToStr(opr), slot);
   }
 
-  /// Execute a channel IN/OUT operation, performing the rendezvous if the
-  /// partner is already waiting, otherwise parking this processor (PC is not
-  /// advanced so the operation completes when the partner arrives).
+  /// Copy count words of a block transfer from the writer's memory to the
+  /// reader's.
+  static void copyBlock(const Processor &writer, uint32_t writerAddress,
+                        Processor &reader, uint32_t readerAddress,
+                        uint32_t count) {
+    if (count > MEMORY_SIZE_WORDS ||
+        writerAddress > MEMORY_SIZE_WORDS - count ||
+        readerAddress > MEMORY_SIZE_WORDS - count) {
+      throw std::runtime_error(fmt::format(
+          "processor {}: block transfer of {} words out of bounds", writer.id,
+          count));
+    }
+    std::copy_n(writer.memory.begin() + writerAddress, count,
+                reader.memory.begin() + readerAddress);
+  }
+
+  /// Check a block transfer lies within memory.
+  void checkBlockBounds(uint32_t address, uint32_t count) const {
+    if (count > MEMORY_SIZE_WORDS || address > MEMORY_SIZE_WORDS - count) {
+      throw std::runtime_error(fmt::format(
+          "processor {}: block transfer of {} words out of bounds", id,
+          count));
+    }
+  }
+
+  /// Pack a word, or the block at address, into a channel message.
+  void packMessage(Channel::Message &m, bool block, uint32_t address,
+                   uint32_t count, uint32_t value) const {
+    m.block = block;
+    m.count = count;
+    if (block) {
+      checkBlockBounds(address, count);
+      m.data.assign(memory.begin() + address, memory.begin() + address + count);
+    } else {
+      m.data.assign(1, value);
+    }
+  }
+
+  /// Unpack a channel message into areg, or the block at address.
+  void unpackMessage(const Channel::Message &m, uint32_t address) {
+    if (m.block) {
+      checkBlockBounds(address, m.count);
+      std::copy(m.data.begin(), m.data.end(), memory.begin() + address);
+    } else {
+      areg = m.data[0];
+    }
+  }
+
+  /// Check the operation arriving on a channel matches the one parked on it:
+  /// a word with a word, or blocks of the same length.
+  void checkPartner(bool partnerBlock, uint32_t partnerCount, bool block,
+                    uint32_t count, unsigned slot) {
+    if (partnerBlock != block || (block && partnerCount != count)) {
+      throwMismatch(slot);
+    }
+  }
+
+  [[noreturn]] void throwMismatch(unsigned slot) const {
+    throw std::runtime_error(
+        fmt::format("processor {}: mismatched channel transfer on slot {} "
+                    "at pc {:#08x}",
+                    id, slot, pc));
+  }
+
+  /// Execute a channel IN/OUT/INN/OUTN operation, performing the rendezvous
+  /// if the partner is already waiting, otherwise parking this processor (PC
+  /// is not advanced so the operation completes when the partner arrives).
   StepResult stepChannel(hex::OprInstr opr) {
     unsigned slot = breg;
     if (slot >= links.size() || links[slot] == nullptr) {
@@ -312,42 +1692,280 @@ public:
           "processor {}: unwired channel slot {} at pc {:#08x}", id, slot, pc));
     }
     Channel *c = links[slot];
-    if (opr == hex::OprInstr::OUT) {
+    bool block = opr == hex::OprInstr::OUTN || opr == hex::OprInstr::INN;
+    uint32_t address = block ? memory[memory[1] + 2] : 0;
+    uint32_t count = block ? memory[memory[1] + 3] : 0;
+    if (block && count == 0) {
+      // An empty block transfer completes without a rendezvous.
+      if (tracing) {
+        traceChannel(opr, slot);
+      }
+      advanceInstr();
+      return status = StepResult::RUNNING;
+    }
+    if (parallel) {
+      return stepChannelParallel(*c, opr, block, address, count, slot);
+    }
+    if (pdes) {
+      return stepChannelTimed(*c, opr, block, address, count, slot);
+    }
+    if (opr == hex::OprInstr::OUT || opr == hex::OprInstr::OUTN) {
       if (c->state == Channel::State::READER_WAITING) {
-        c->reader->areg = areg;
+        checkPartner(c->block, c->count, block, count, slot);
+        if (block) {
+          copyBlock(*this, address, *c->reader, c->address, count);
+        } else {
+          c->reader->areg = areg;
+        }
         c->reader->unblockAdvance();
+        recordTransfer(slot, true, block ? count : 1, tick);
+        c->reader->recordTransfer(c->reader->blockedSlot, false,
+                                  block ? count : 1, tick);
+        woken = c->reader;
         c->state = Channel::State::IDLE;
         c->reader = nullptr;
         if (tracing) {
           traceChannel(opr, slot);
         }
         advanceInstr();
+        if (recorder) {
+          recorder->rendezvous(id, woken->id);
+        }
+        return status = StepResult::RUNNING;
+      }
+      if (c->fifo.size() < c->depth) {
+        // Buffered: complete while the FIFO has space.
+        packMessage(c->fifo.emplace_back(), block, address, count, areg);
+        c->peak = std::max(c->peak, c->fifo.size());
+        recordTransfer(slot, true, block ? count : 1, tick);
+        if (tracing) {
+          traceChannel(opr, slot);
+        }
+        advanceInstr();
         return status = StepResult::RUNNING;
       }
       c->state = Channel::State::WRITER_WAITING;
       c->value = areg;
+      c->block = block;
+      c->address = address;
+      c->count = count;
       c->writer = this;
       blockedSlot = slot;
+      blockedWriting = true;
+      waitsFor = partners[slot];
+      if (timeline) {
+        timeline->block(id, tick, slot, c->index, true);
+      }
       return status = StepResult::BLOCKED;
     }
-    // IN.
+    // IN or INN.
+    if (!c->fifo.empty()) {
+      // Buffered: take the oldest message, and move a waiting writer's into
+      // the space it leaves.
+      auto &m = c->fifo.front();
+      checkPartner(m.block, m.count, block, count, slot);
+      unpackMessage(m, address);
+      c->fifo.pop_front();
+      recordTransfer(slot, false, block ? count : 1, tick);
+      if (c->state == Channel::State::WRITER_WAITING) {
+        c->writer->packMessage(c->fifo.emplace_back(), c->block, c->address,
+                               c->count, c->value);
+        c->writer->unblockAdvance();
+        c->writer->recordTransfer(c->writer->blockedSlot, true,
+                                  c->block ? c->count : 1, tick);
+        woken = c->writer;
+        c->state = Channel::State::IDLE;
+        c->writer = nullptr;
+      }
+      if (tracing) {
+        traceChannel(opr, slot);
+      }
+      advanceInstr();
+      return status = StepResult::RUNNING;
+    }
     if (c->state == Channel::State::WRITER_WAITING) {
-      areg = c->value;
+      checkPartner(c->block, c->count, block, count, slot);
+      if (block) {
+        copyBlock(*c->writer, c->address, *this, address, count);
+      } else {
+        areg = c->value;
+      }
       c->writer->unblockAdvance();
+      recordTransfer(slot, false, block ? count : 1, tick);
+      c->writer->recordTransfer(c->writer->blockedSlot, true,
+                                block ? count : 1, tick);
+      woken = c->writer;
       c->state = Channel::State::IDLE;
       c->writer = nullptr;
       if (tracing) {
         traceChannel(opr, slot);
       }
       advanceInstr();
+      if (recorder) {
+        recorder->rendezvous(id, woken->id);
+      }
       return status = StepResult::RUNNING;
     }
     c->state = Channel::State::READER_WAITING;
+    c->block = block;
+    c->address = address;
+    c->count = count;
     c->reader = this;
     blockedSlot = slot;
+    blockedWriting = false;
+    waitsFor = partners[slot];
+    if (timeline) {
+      timeline->block(id, tick, slot, c->index, false);
+    }
     return status = StepResult::BLOCKED;
   }
 
+  /// Count a message transferred through a link slot at a tick.
+  void recordTransfer(unsigned slot, bool writing, uint32_t words,
+                      uint64_t at) {
+    auto &s = linkStats[slot];
+    (writing ? s.sent : s.received)++;
+    s.words += words;
+    if (s.firstTick < 0) {
+      s.firstTick = static_cast<int64_t>(at);
+    }
+    s.lastTick = static_cast<int64_t>(at);
+    if (timeline) {
+      timeline->transfer(id, at, slot, links[slot]->index, writing);
+    }
+  }
+
+  /// Stop a parallel run. The workers exit after their current slice.
+  void stopAll() {
+    parallel->stop.store(true, std::memory_order_release);
+    parallel->epoch.fetch_add(1, std::memory_order_acq_rel);
+    parallel->epoch.notify_all();
+  }
+
+  /// Remove this processor from the running count. The last running
+  /// processor to stop ends the run, as a deadlock if any are still live.
+  void stopRunning() {
+    if (parallel->running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (parallel->live.load(std::memory_order_acquire) > 0 &&
+          !parallel->timedOut.load(std::memory_order_acquire)) {
+        parallel->deadlocked.store(true, std::memory_order_release);
+      }
+      stopAll();
+    }
+  }
+
+  /// Return true if every other processor has passed this one in (tick, id)
+  /// order, so syscalls, and with them all I/O and exits, happen in the order
+  /// the sequential scheduler performs them.
+  bool isTurn() const {
+    auto wakes = parallel->wakes.load(std::memory_order_acquire);
+    for (auto *p : parallel->procs) {
+      auto t = p->time.load(std::memory_order_acquire) & ~WOKEN_BIT;
+      if (p != this && (t < tick || (t == tick && p->id < id))) {
+        return false;
+      }
+    }
+    return parallel->wakes.load(std::memory_order_acquire) == wakes;
+  }
+
+  /// Requeue this processor on the current worker once both the parking
+  /// worker and the waking partner have finished with it.
+  void requeue(Processor &p) {
+    if (p.handshake.fetch_add(1, std::memory_order_acq_rel) == 1) {
+      p.handshake.store(0, std::memory_order_relaxed);
+      parallel->queues[worker]->push(&p);
+    }
+  }
+
+  /// Park this processor after it blocks on a channel. It is not runnable
+  /// again until its partner completes the rendezvous.
+  void park() {
+    // The partner may already have completed the rendezvous, in which case
+    // its resume tick must not be overwritten.
+    uint64_t expected = tick;
+    time.compare_exchange_strong(expected, NEVER, std::memory_order_acq_rel);
+    stopRunning();
+    requeue(*this);
+  }
+
+  /// Resume a parked partner at resumeTick.
+  void wake(Processor &partner, uint64_t resumeTick) {
+    partner.time.store(resumeTick | WOKEN_BIT, std::memory_order_release);
+    parallel->wakes.fetch_add(1, std::memory_order_acq_rel);
+    parallel->running.fetch_add(1, std::memory_order_acq_rel);
+    requeue(partner);
+  }
+
+  /// A lock-free rendezvous for the parallel run. The first side to arrive
+  /// describes its transfer in its own pending fields, claims the channel
+  /// with a CAS and parks. The second side performs the transfer, releases
+  /// the channel and wakes it, to resume on the waker's worker. The ticks
+  /// both sides continue from are those of the sequential scheduler: the
+  /// later arrival in (tick, id) order completes at its tick, and the earlier
+  /// one resumes in the same round if it is stepped after it, otherwise in
+  /// the next.
+  StepResult stepChannelParallel(Channel &c, hex::OprInstr opr, bool block,
+                                 uint32_t address, uint32_t count,
+                                 unsigned slot) {
+    bool output = opr == hex::OprInstr::OUT || opr == hex::OprInstr::OUTN;
+    auto waiting = output ? Channel::State::WRITER_WAITING
+                          : Channel::State::READER_WAITING;
+    std::atomic_ref<Channel::State> state(c.state);
+    auto current = state.load(std::memory_order_acquire);
+    if (current == Channel::State::IDLE) {
+      pendingBlock = block;
+      pendingAddress = address;
+      pendingCount = count;
+      (output ? c.writer : c.reader) = this;
+      status = StepResult::BLOCKED;
+      blockedSlot = slot;
+      blockedWriting = output;
+      waitsFor = partners[slot];
+      if (state.compare_exchange_strong(current, waiting,
+                                        std::memory_order_acq_rel)) {
+        // The partner may wake this processor from here on, so its state
+        // belongs to the partner until it is requeued.
+        return StepResult::BLOCKED;
+      }
+      // The partner claimed the channel first.
+      status = StepResult::RUNNING;
+    }
+    if (current == waiting) {
+      // Two writers or two readers meet on the channel, so the one waiting is
+      // not a partner.
+      throwMismatch(slot);
+    }
+    auto &partner = output ? *c.reader : *c.writer;
+    checkPartner(partner.pendingBlock, partner.pendingCount, block, count,
+                 slot);
+    if (output) {
+      if (block) {
+        copyBlock(*this, address, partner, partner.pendingAddress, count);
+      } else {
+        partner.areg = areg;
+      }
+    } else {
+      if (block) {
+        copyBlock(partner, partner.pendingAddress, *this, address, count);
+      } else {
+        areg = partner.areg;
+      }
+    }
+    bool late =
+        partner.tick < tick || (partner.tick == tick && partner.id < id);
+    auto lateTick = late ? tick : partner.tick;
+    auto lateId = late ? id : partner.id;
+    auto resumeTick = [&](const Processor &p) {
+      return p.id == lateId || p.id < lateId ? lateTick + 1 : lateTick;
+    };
+    state.store(Channel::State::IDLE, std::memory_order_release);
+    advanceInstr();
+    // The slice loop advances tick past the channel instruction.
+    tick = resumeTick(*this) - 1;
+    wake(partner, resumeTick(partner));
+    return status = StepResult::RUNNING;
+  }
+
   /// Execute a single instruction. Returns the resulting status.
   StepResult step() {
     if (status != StepResult::RUNNING) {
@@ -359,15 +1977,28 @@ public:
     // Channel operations may block, so they manage the PC themselves.
     if (instrEnum == hex::Instr::OPR) {
       auto oprInstr = static_cast<hex::OprInstr>(oreg);
-      if (oprInstr == hex::OprInstr::IN || oprInstr == hex::OprInstr::OUT) {
+      if (oprInstr == hex::OprInstr::IN || oprInstr == hex::OprInstr::OUT ||
+          oprInstr == hex::OprInstr::INN || oprInstr == hex::OprInstr::OUTN) {
         return stepChannel(oprInstr);
       }
+      // In a parallel run, retry a syscall until it is this processor's turn
+      // (updating oreg again is harmless).
+      if (oprInstr == hex::OprInstr::SVC && parallel && !isTurn()) {
+        yielded = true;
+        return status;
+      }
     }
     lastPC = pc;
     pc = pc + 1;
     if (tracing) {
       trace(instr, instrEnum);
     }
+    if (recorder) {
+      recorder->count(id, cachedSymbolIndex(lastPC));
+    }
+    if (lineProfile) {
+      countLine(lastPC);
+    }
     switch (instrEnum) {
     case hex::Instr::LDAM:
       areg = memory[oreg];
@@ -408,7 +2039,28 @@ public:
     case hex::Instr::BR:
       pc = pc + oreg;
       oreg = 0;
+      if (timeline) {
+        recordCall();
+      }
       break;
+    case hex::Instr::SPI: {
+      auto address = memory[1] + hex::spiOffset(oreg);
+      switch (hex::spiOp(oreg)) {
+      case hex::SpiInstr::LDAS:
+        areg = memory[address];
+        break;
+      case hex::SpiInstr::LDBS:
+        breg = memory[address];
+        break;
+      case hex::SpiInstr::STAS:
+        memory[address] = areg;
+        break;
+      default:
+        throw std::runtime_error("invalid SPI: " + std::to_string(oreg));
+      }
+      oreg = 0;
+      break;
+    }
     case hex::Instr::BRZ:
       if (areg == 0) {
         pc = pc + oreg;
@@ -432,6 +2084,9 @@ public:
       case hex::OprInstr::BRB:
         pc = breg;
         oreg = 0;
+        if (timeline) {
+          timeline->ret(id, tick);
+        }
         break;
       case hex::OprInstr::ADD:
         areg = areg + breg;
@@ -441,11 +2096,42 @@ public:
         areg = areg - breg;
         oreg = 0;
         break;
+      case hex::OprInstr::MUL:
+        areg = areg * breg;
+        oreg = 0;
+        break;
+      case hex::OprInstr::DIV:
+        areg = hex::oprDiv(areg, breg);
+        oreg = 0;
+        break;
+      case hex::OprInstr::LSH:
+        areg = hex::oprLsh(areg, breg);
+        oreg = 0;
+        break;
+      case hex::OprInstr::RSH:
+        areg = hex::oprRsh(areg, breg);
+        oreg = 0;
+        break;
+      case hex::OprInstr::AND:
+        areg = areg & breg;
+        oreg = 0;
+        break;
+      case hex::OprInstr::OR:
+        areg = areg | breg;
+        oreg = 0;
+        break;
+      case hex::OprInstr::XOR:
+        areg = areg ^ breg;
+        oreg = 0;
+        break;
       case hex::OprInstr::SVC:
         syscall();
         if (tracing) {
           traceSyscall();
         }
+        if (timeline) {
+          timeline->syscall(id, tick, areg);
+        }
         break;
       default:
         throw std::runtime_error("invalid OPR: " + std::to_string(oreg));
@@ -469,6 +2155,369 @@ public:
     }
     return exitCode;
   }
+
+  /// Attach this processor to a parallel run.
+  void setParallel(ParallelState *state) { parallel = state; }
+
+  /// Run up to quantum instructions of this processor on a worker thread,
+  /// counting them into steps. Returns true if the processor is still
+  /// runnable and must be requeued.
+  bool runSlice(unsigned w, size_t quantum, uint64_t &steps) {
+    worker = w;
+    try {
+      if (status == StepResult::BLOCKED) {
+        // Resume from the rendezvous the partner completed.
+        unblockAdvance();
+        tick = time.load(std::memory_order_acquire) & ~WOKEN_BIT;
+      }
+      for (size_t i = 0; i < quantum; i++) {
+        if (parallel->stop.load(std::memory_order_relaxed)) {
+          return false;
+        }
+        if (maxCycles > 0 && tick > maxCycles) {
+          parallel->timedOut.store(true, std::memory_order_release);
+          time.store(NEVER, std::memory_order_release);
+          stopRunning();
+          return false;
+        }
+        auto result = step();
+        if (yielded) {
+          yielded = false;
+          return true;
+        }
+        steps++;
+        if (result == StepResult::HALTED) {
+          int none = -1;
+          parallel->firstExit.compare_exchange_strong(
+              none, static_cast<int>(id), std::memory_order_acq_rel);
+          time.store(NEVER, std::memory_order_release);
+          parallel->live.fetch_sub(1, std::memory_order_acq_rel);
+          stopRunning();
+          return false;
+        }
+        if (result == StepResult::BLOCKED) {
+          park();
+          return false;
+        }
+        tick++;
+        time.store(tick, std::memory_order_release);
+      }
+      return true;
+    } catch (...) {
+      error = std::current_exception();
+      stopAll();
+      return false;
+    }
+  }
+
+  /// Return the operation of the next instruction if it is an OPR.
+  std::optional<hex::OprInstr> nextOpr() const {
+    auto next = (memory[pc >> 2] >> ((pc & 0x3) << 3)) & 0xFF;
+    if (static_cast<hex::Instr>((next >> 4) & 0xF) != hex::Instr::OPR) {
+      return std::nullopt;
+    }
+    return static_cast<hex::OprInstr>(oreg | (next & 0xF));
+  }
+
+  /// Return the stream the next instruction reads from if it is an input
+  /// syscall, otherwise -1.
+  int pendingInputStream() const {
+    if (nextOpr() != hex::OprInstr::SVC) {
+      return -1;
+    }
+    unsigned spWordIndex = memory[1];
+    switch (static_cast<hex::Syscall>(areg)) {
+    case hex::Syscall::READ:
+      return static_cast<int>(memory[spWordIndex + 2]);
+    case hex::Syscall::READS:
+    case hex::Syscall::READN:
+      return static_cast<int>(memory[spWordIndex + 4]);
+    default:
+      return -1;
+    }
+  }
+
+  /// Return true unless the next instruction reads input that is not yet
+  /// available.
+  bool inputReady() const {
+    auto stream = pendingInputStream();
+    return stream < 0 || io.inputReady(stream);
+  }
+
+  /// Execute this processor as a coroutine for the coroutine back-end of
+  /// System. Each resume runs a turn of up to quantum instructions and then
+  /// suspends. A turn also ends when a channel operation must wait for its
+  /// partner, and the coroutine is then only resumed once the partner has
+  /// completed the rendezvous and queued it, and when a read finds no input,
+  /// leaving the scheduler to resume it once input arrives.
+  ProcessorTask execute(ReadyQueues &ready, unsigned quantum,
+                        uint64_t &instructions) {
+    while (true) {
+      for (unsigned i = 0; i < quantum && status == StepResult::RUNNING; i++) {
+        if (!inputReady()) {
+          waitingInput = true;
+          break;
+        }
+        step();
+        instructions++;
+        if (auto *partner = takeWoken()) {
+          ready.wake(partner->id, id);
+        }
+      }
+      if (status == StepResult::HALTED) {
+        co_return;
+      }
+      co_await std::suspend_always();
+      waitingInput = false;
+    }
+  }
+
+  /// Attach this processor to a PDES run with the given latency per hop.
+  void setPdes(bool value, uint64_t latency) {
+    pdes = value;
+    linkLatency = latency;
+  }
+
+  /// A timed channel transfer for a PDES run. The writer posts its message
+  /// to the channel, arriving one latency per hop later, and waits for the
+  /// reader's acknowledgement to travel back. The reader takes a message that
+  /// arrives before the end of the current window, completing when it
+  /// arrives if that is later. A message posted in a window arrives after the
+  /// window ends, so what each side sees does not depend on host threads.
+  StepResult stepChannelTimed(Channel &c, hex::OprInstr opr, bool block,
+                              uint32_t address, uint32_t count,
+                              unsigned slot) {
+    std::lock_guard<std::mutex> lock(c.mutex);
+    auto delay = linkLatency * c.hops;
+    if (block) {
+      checkBlockBounds(address, count);
+    }
+    blockedSlot = slot;
+    blockedWriting = opr == hex::OprInstr::OUT || opr == hex::OprInstr::OUTN;
+    waitsFor = partners[slot];
+    waitChannel = &c;
+    if (blockedWriting) {
+      if (c.message.valid) {
+        // Both endpoints are writing.
+        throwMismatch(slot);
+      }
+      c.message.valid = true;
+      c.message.time = simTime + delay;
+      c.messageOut = c.remote;
+      packMessage(c.message, block, address, count, areg);
+      timedWait = TimedWait::ACK;
+      return status = StepResult::BLOCKED;
+    }
+    if (!c.message.valid || c.message.time >= windowEnd) {
+      timedWait = TimedWait::MESSAGE;
+      return status = StepResult::BLOCKED;
+    }
+    checkPartner(c.message.block, c.message.count, block, count, slot);
+    unpackMessage(c.message, address);
+    c.message.valid = false;
+    auto done = std::max(simTime, c.message.time);
+    c.ackValid = true;
+    c.ackTime = done + delay;
+    c.ackOut = c.remote;
+    timedWait = TimedWait::NONE;
+    advanceInstr();
+    simTime = done + 1;
+    timeSet = true;
+    return status = StepResult::RUNNING;
+  }
+
+  /// Return the earliest simulated time at which this processor can next
+  /// execute an instruction, if any.
+  std::optional<uint64_t> nextEventTime() {
+    if (status == StepResult::HALTED) {
+      return std::nullopt;
+    }
+    if (timedWait == TimedWait::NONE) {
+      return simTime;
+    }
+    std::lock_guard<std::mutex> lock(waitChannel->mutex);
+    if (timedWait == TimedWait::MESSAGE && waitChannel->message.valid) {
+      return std::max(simTime, waitChannel->message.time);
+    }
+    if (timedWait == TimedWait::ACK && waitChannel->ackValid) {
+      return waitChannel->ackTime;
+    }
+    return std::nullopt;
+  }
+
+  /// Run this processor in a PDES window until its simulated time reaches
+  /// end, it waits on a channel, it halts, or it reaches a syscall.
+  void runWindow(uint64_t end) {
+    windowEnd = end;
+    if (syscallPending) {
+      return;
+    }
+    if (timedWait == TimedWait::ACK) {
+      std::lock_guard<std::mutex> lock(waitChannel->mutex);
+      if (!waitChannel->ackValid || waitChannel->ackTime >= windowEnd) {
+        return;
+      }
+      waitChannel->ackValid = false;
+      simTime = waitChannel->ackTime;
+      timedWait = TimedWait::NONE;
+      unblockAdvance();
+    } else if (timedWait == TimedWait::MESSAGE) {
+      // Retry the input.
+      status = StepResult::RUNNING;
+    }
+    while (status == StepResult::RUNNING && simTime < windowEnd) {
+      if (nextOpr() == hex::OprInstr::SVC) {
+        syscallPending = true;
+        return;
+      }
+      timeSet = false;
+      step();
+      if (!timeSet && status == StepResult::RUNNING) {
+        simTime++;
+      }
+    }
+  }
+
+  /// Perform the pending syscall of a PDES run.
+  void performSyscall() {
+    syscallPending = false;
+    step();
+    simTime++;
+  }
+
+  /// Return the state this processor stopped in.
+  StoppedState getStoppedState() const {
+    return {status, blockedSlot, blockedWriting, pc, simTime, cycles};
+  }
+
+  /// Restore the state this processor stopped in when another process ran
+  /// it.
+  void setStoppedState(const StoppedState &state) {
+    status = state.status;
+    blockedSlot = state.blockedSlot;
+    blockedWriting = state.blockedWriting;
+    waitsFor = status == StepResult::BLOCKED ? partners[blockedSlot] : nullptr;
+    pc = state.pc;
+    simTime = state.simTime;
+    cycles = state.instructions;
+  }
+
+  /// Rethrow any error raised while running this processor in parallel.
+  void rethrowError() const {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+};
+
+/// The state shared by the processes of a partitioned run (see
+/// System::setPartitions), placed in shared memory. The workers perform their
+/// syscalls one at a time, in turn, and the coordinator serves their input one
+/// character per request and copies out their output.
+struct PartitionControl {
+  static constexpr uint32_t INPUT_IDLE = 0;
+  static constexpr uint32_t INPUT_REQUESTED = 1;
+  static constexpr uint32_t INPUT_READY = 2;
+  std::atomic<bool> abort{false};
+  hexshm::Barrier barrier;
+  std::atomic<uint32_t> turn{0}; // the partition performing its syscalls
+  std::atomic<uint32_t> input{INPUT_IDLE};
+  int inputChar = 0; // the character read, or -1 at the end of input
+  bool haveExit = false;
+  int exitCode = 0;
+  bool deadlocked = false;
+  uint64_t windows = 0;
+  uint64_t phases = 0;
+};
+
+/// What each worker of a partitioned run publishes at a barrier, so that all
+/// of them take the same decisions.
+struct PartitionState {
+  static constexpr uint64_t NONE = ~0ULL;
+  uint64_t syscallTime; // of the earliest pending syscall
+  uint64_t nextEvent;
+  bool live; // any processor has not halted
+  bool failed;
+  char error[512];
+};
+
+/// A channel message or acknowledgement sent between the workers of a
+/// partitioned run, followed in a ring by the words of its data.
+struct PartitionRecord {
+  uint32_t channel;
+  uint32_t ack;
+  uint64_t time;
+  uint32_t block;
+  uint32_t count;
+  uint32_t words;
+  uint32_t unused;
+};
+
+/// The output stream buffer of a worker of a partitioned run, which writes
+/// to the coordinator through a ring.
+class PartitionOutput : public std::streambuf {
+  hexshm::Ring &ring;
+  const std::atomic<bool> &abort;
+
+public:
+  PartitionOutput(hexshm::Ring &ring, const std::atomic<bool> &abort)
+      : ring(ring), abort(abort) {}
+
+protected:
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    static constexpr std::streamsize CHUNK = 4096;
+    for (std::streamsize done = 0; done < n;) {
+      auto chunk = std::min(n - done, CHUNK);
+      while (!ring.tryWrite(s + done, chunk)) {
+        if (abort.load(std::memory_order_acquire)) {
+          return done;
+        }
+        std::this_thread::yield();
+      }
+      done += chunk;
+    }
+    return n;
+  }
+
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    char ch = traits_type::to_char_type(c);
+    return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+  }
+};
+
+/// The input stream buffer of a worker of a partitioned run, which requests
+/// each character from the coordinator so that none is read ahead.
+class PartitionInput : public std::streambuf {
+  PartitionControl &control;
+  char ch = 0;
+
+public:
+  explicit PartitionInput(PartitionControl &control) : control(control) {}
+
+protected:
+  int_type underflow() override {
+    control.input.store(PartitionControl::INPUT_REQUESTED,
+                        std::memory_order_release);
+    while (control.input.load(std::memory_order_acquire) !=
+           PartitionControl::INPUT_READY) {
+      if (control.abort.load(std::memory_order_acquire)) {
+        return traits_type::eof();
+      }
+      std::this_thread::yield();
+    }
+    int c = control.inputChar;
+    control.input.store(PartitionControl::INPUT_IDLE,
+                        std::memory_order_relaxed);
+    if (c < 0) {
+      return traits_type::eof();
+    }
+    ch = static_cast<char>(c);
+    setg(&ch, &ch, &ch + 1);
+    return traits_type::to_int_type(ch);
+  }
 };
 
 /// Magic number identifying a network container file ("HEXN").
@@ -481,8 +2530,41 @@ class System {
   std::vector<std::unique_ptr<Channel>> channels;
   std::istream &in;
   std::ostream &out;
+  hex::IOHub hub;
   size_t maxCycles;
   bool tracing = false;
+  bool parallel = false;
+  unsigned workers = 0;
+  unsigned quantum = 1;
+  bool coroutines = false;
+  bool pdes = false;
+  unsigned linkLatency = 1;
+  unsigned partitions = 1;
+  PdesStats pdesStats;
+  std::function<bool(int)> inputReadyHook;
+  std::vector<WorkerStats> workerStats;
+  ScheduleStats scheduleStats;
+  bool networkStats = false;
+  std::vector<ProcessorStats> processorStats;
+  std::vector<hexcontainer::Edge> edges;
+  std::vector<std::string> channelNames;
+  bool criticalPath = false;
+  CriticalPathRecorder recorder;
+  bool lineProfile = false;
+  bool timeline = false;
+  unsigned timelineInterval = 1;
+  TimelineRecorder timelineRecorder;
+  unsigned channelDepth = 0;
+  std::map<std::string, unsigned> channelDepths; // overrides by name
+  hexplace::Topology topology;
+  std::vector<unsigned> placement; // processor -> node
+  std::function<void(const std::string &)> deadlockHook;
+  std::vector<uint64_t> walkMarks; // per processor, the last walk visiting it
+  uint64_t walkMark = 0;
+  std::vector<const Processor *> walkPath;
+  WaitForForest waitForest;
+  std::vector<std::vector<Processor *>> waiters; // per processor, those
+                                                 // blocked on it
   // Default to truncating character inputs, matching the hardware and xhexb.x
   // behaviour. Tests may enable sign-extension to exercise negative values.
   bool truncateInputs = true;
@@ -491,76 +2573,404 @@ class System {
 
 public:
   System(std::istream &in, std::ostream &out, size_t maxCycles = 0)
-      : in(in), out(out), maxCycles(maxCycles) {}
+      : in(in), out(out), hub(in, out), maxCycles(maxCycles) {}
 
   void setTracing(bool value) { tracing = value; }
   void setTruncateInputs(bool value) { truncateInputs = value; }
+  /// Write each line of each processor's standard output tagged with a
+  /// [coreN] prefix, rather than merging the characters.
+  void setTaggedOutput() { hub.setTagged(); }
+  /// Write the standard output of processor N to the file prefixN.
+  void setSplitOutput(const std::string &prefix) { hub.setSplit(prefix); }
+  /// Run each processor for up to value instructions per round, or until it
+  /// blocks or halts, rather than one. The schedule stays deterministic for
+  /// a given quantum.
+  void setQuantum(unsigned value) { quantum = std::max(1U, value); }
+  /// Run each processor as a coroutine that the round-robin scheduler resumes
+  /// only when it can make progress. The schedule is the same as stepping.
+  void setCoroutines(bool value) { coroutines = value; }
+  /// Set a hook reporting whether input is available on a stream. In the
+  /// coroutine back-end, a read from a stream without input suspends only its
+  /// processor, and the others keep running.
+  void setInputReady(std::function<bool(int)> hook) {
+    inputReadyHook = std::move(hook);
+  }
+  /// Set a hook to report each deadlock of a round-robin run to as it forms,
+  /// while the rest of the network keeps running. Without one, the run stops
+  /// at the first.
+  void setDeadlockHook(std::function<void(const std::string &)> hook) {
+    deadlockHook = std::move(hook);
+  }
+  /// Run the network as a parallel discrete-event simulation in which each
+  /// processor advances in its own simulated time and channel transfers take
+  /// the link latency per router hop. Uses the worker count of parallel mode,
+  /// and takes precedence over it.
+  void setPdes(bool value) { pdes = value; }
+  /// Set the latency in cycles of each router hop in PDES mode, which is also
+  /// the lookahead that lets the threads run ahead of each other.
+  void setLinkLatency(unsigned value) { linkLatency = value; }
+  /// Run the network as a PDES split across value worker processes, forked
+  /// for the run, each running a contiguous range of the processors. Channels
+  /// between processors of different workers are carried over shared-memory
+  /// rings, and this process serves the workers' input and output. The
+  /// results and statistics are those of a single-process PDES run.
+  void setPartitions(unsigned value) { partitions = std::max(1U, value); }
+  /// Return the statistics of the last PDES run.
+  const PdesStats &getPdesStats() const { return pdesStats; }
+  /// Return the statistics of the last round-robin run.
+  const ScheduleStats &getScheduleStats() const { return scheduleStats; }
+  /// Return the number of instructions the processors have executed, under
+  /// any scheduling policy.
+  uint64_t getInstructions() const {
+    uint64_t total = 0;
+    for (auto &p : procs) {
+      total += p->getInstructions();
+    }
+    return total;
+  }
+  /// Record how each processor spends the ticks of a round-robin run, and how
+  /// long each end of each channel waits for the other.
+  void setNetworkStats(bool value) { networkStats = value; }
+  /// Place the processors on the nodes of a mesh or torus, so that the hops of
+  /// each channel, and so its latency in PDES mode, follow the distance
+  /// between its endpoints. Clears any placement.
+  void setTopology(const hexplace::Topology &value) {
+    topology = value;
+    placement.clear();
+  }
+  /// Set the node of each processor (by default, processor i is on node i).
+  void setPlacement(const std::vector<unsigned> &value) { placement = value; }
+  /// Return the topology, which is empty if the processors are not placed.
+  const hexplace::Topology &getTopology() const { return topology; }
+  /// Return the node of each processor.
+  std::vector<unsigned> getPlacement() const {
+    return placement.empty() ? hexplace::defaultPlacement(procs.size())
+                             : placement;
+  }
+  /// Return the traffic of each channel in the last run with network
+  /// statistics, as messages or as words.
+  std::vector<hexplace::Flow> getFlows(bool words) const {
+    std::vector<hexplace::Flow> flows;
+    auto stats = getNetworkStats();
+    for (auto &c : stats.channels) {
+      flows.push_back(
+          {c.edge.procA, c.edge.procB, words ? c.words : c.messages});
+    }
+    return flows;
+  }
+  /// Give every channel of a round-robin run a FIFO holding up to value
+  /// messages, so that a write completes at once while there is space. This
+  /// is a what-if mode for performance exploration: the hardware's channels
+  /// are synchronous, as they are with the default depth of 0.
+  void setChannelDepth(unsigned value) { channelDepth = value; }
+  /// Override the FIFO depth of the channel with the given name.
+  void setChannelDepth(const std::string &name, unsigned value) {
+    channelDepths[name] = value;
+  }
+  /// Return the FIFO of each channel in the last run.
+  std::vector<ChannelBuffer> getChannelBuffers() const {
+    std::vector<ChannelBuffer> buffers;
+    for (size_t i = 0; i < channels.size(); i++) {
+      buffers.push_back(
+          {channelName(i), channels[i]->depth, channels[i]->peak});
+    }
+    return buffers;
+  }
+  /// Record the compute segments and rendezvous of a round-robin run to find
+  /// its critical path.
+  void setCriticalPath(bool value) { criticalPath = value; }
+  /// Return the critical path of the last round-robin run, with procedures
+  /// named after the processors' debug symbols.
+  CriticalPath getCriticalPath() const {
+    return recorder.analyse([this](unsigned proc, int symbol) {
+      return procs[proc]->getSymbolName(symbol);
+    });
+  }
+  /// Count the instructions of a round-robin run executed on each source line
+  /// of the processors' line tables.
+  void setLineProfile(bool value) { lineProfile = value; }
+  /// Return the line profile of the last round-robin run, summed over the
+  /// processors, which share the lines of one source file.
+  LineProfile getLineProfile() const {
+    std::map<uint32_t, uint64_t> counts;
+    for (auto &p : procs) {
+      for (auto [line, count] : p->getLineProfile()) {
+        counts[line] += count;
+      }
+    }
+    LineProfile profile;
+    for (auto [line, count] : counts) {
+      profile.instructions += count;
+      if (line > 0) {
+        profile.lines.push_back({line, count});
+      }
+    }
+    std::stable_sort(profile.lines.begin(), profile.lines.end(),
+                     [](const LineCount &x, const LineCount &y) {
+                       return x.instructions > y.instructions;
+                     });
+    return profile;
+  }
+  /// Record a timeline of a round-robin run's calls, waits, transfers and
+  /// syscalls, sampled every interval ticks if that is more than one.
+  void setTimeline(bool value, unsigned interval = 1) {
+    timeline = value;
+    timelineInterval = interval;
+  }
+  /// Write the timeline of the last round-robin run as Chrome trace JSON,
+  /// which may have stopped with an error or a deadlock.
+  void writeTimeline(std::ostream &out) const {
+    timelineRecorder.writeJson(
+        out, scheduleStats.ticks,
+        [this](unsigned proc, int symbol) {
+          return procs[proc]->getSymbolName(symbol);
+        },
+        [this](unsigned channel) { return channelName(channel); });
+  }
+  /// Return the per-channel and per-processor statistics of the last
+  /// round-robin run. Channels are named after their source declarations when
+  /// the container records them.
+  NetworkStats getNetworkStats() const {
+    NetworkStats stats;
+    stats.ticks = scheduleStats.ticks;
+    stats.processors = processorStats;
+    for (size_t i = 0; i < edges.size(); i++) {
+      ChannelStats c;
+      c.edge = edges[i];
+      c.name = channelName(i);
+      c.a = procs[c.edge.procA]->getLinkStats(c.edge.slotA);
+      c.b = procs[c.edge.procB]->getLinkStats(c.edge.slotB);
+      c.messages = c.a.sent + c.a.received;
+      c.words = c.a.words;
+      c.writerWaitTicks = c.a.writerWaitTicks + c.b.writerWaitTicks;
+      c.readerWaitTicks = c.a.readerWaitTicks + c.b.readerWaitTicks;
+      c.firstTick = c.a.firstTick;
+      c.lastTick = c.a.lastTick;
+      stats.channels.push_back(std::move(c));
+    }
+    return stats;
+  }
+  /// Run the processors on a pool of host threads rather than round-robin.
+  /// Syscalls are ordered as in the round-robin schedule, so the output, input
+  /// and exit code are the same.
+  void setParallel(bool value) { parallel = value; }
+  /// Set the number of worker threads for a parallel run (0 for one per host
+  /// core, but no more than there are processors).
+  void setWorkers(unsigned value) { workers = value; }
+  /// Return the utilisation of each worker thread in the last parallel run.
+  const std::vector<WorkerStats> &getWorkerStats() const {
+    return workerStats;
+  }
 
   /// Load a network container, or fall back to a single-processor system if the
   /// file is a plain image (no network magic).
   void loadNetwork(const char *filename) {
-    auto container = hexcontainer::read(filename);
-    // One processor per image (a plain single image yields one processor).
-    for (size_t i = 0; i < container.images.size(); i++) {
-      auto &image = container.images[i];
-      std::istringstream imageStream(std::string(image.begin(), image.end()),
-                                     std::ios::binary);
-      addProcessor(imageStream, static_cast<unsigned>(image.size()),
+    auto container = hexcontainer::map(filename);
+    // One processor per image (a plain single image yields one processor),
+    // each copied from the mapping.
+    for (size_t i = 0; i < container.numProcessors(); i++) {
+      addProcessor(container.imageOfProcessor(i), container.file,
                    static_cast<unsigned>(i));
     }
     // Wire up the channels.
+    edges = container.edges;
+    channelNames = container.channelNames;
+    // Take the container's placement unless a topology has been set.
+    auto &p = container.placement;
+    if (topology.empty() && p.width > 0) {
+      topology = {p.width, p.height, p.torus};
+      placement.assign(p.nodes.begin(), p.nodes.end());
+    }
     for (auto &e : container.edges) {
+      if (e.slotA >= hex::NUM_LINKS || e.slotB >= hex::NUM_LINKS) {
+        throw std::runtime_error("network container wires a missing link "
+                                 "slot");
+      }
       auto channel = std::make_unique<Channel>();
-      procs[e.procA]->setLink(e.slotA, channel.get());
-      procs[e.procB]->setLink(e.slotB, channel.get());
+      channel->index = static_cast<unsigned>(channels.size());
+      procs[e.procA]->setLink(e.slotA, channel.get(), procs[e.procB].get());
+      procs[e.procB]->setLink(e.slotB, channel.get(), procs[e.procA].get());
       channels.push_back(std::move(channel));
     }
   }
 
   /// Run the network round-robin until all processors halt. Returns the exit
   /// code of the first processor to exit. Throws on deadlock.
+  ///
+  /// Processors are either stepped directly or, with coroutines enabled,
+  /// resumed as coroutines that run a turn and suspend.
+  ///
+  /// Each round steps the runnable processors in id order, each for up to the
+  /// quantum number of instructions. Only runnable processors are queued: a
+  /// processor leaves the queues when it blocks or halts, and rejoins when a
+  /// partner unblocks it, in the current round if its id is still to come,
+  /// otherwise in the next. Termination and deadlock are then checks on the
+  /// halted count and the queue sizes.
+  ///
+  /// A processor's wait-for edge to the partner it is blocked on is kept up
+  /// to date as it blocks and unblocks, and each turn that blocks or halts a
+  /// processor checks the graph, so that a deadlock of some of the processors
+  /// is found as soon as it forms, while others are still running.
   int run() {
     if (procs.empty()) {
       return 0;
     }
+    // Write the output still buffered when the run ends, however it ends.
+    // Traced output is interleaved with the trace, so is not buffered.
+    struct FinishOutput {
+      hex::IOHub &hub;
+      ~FinishOutput() { hub.finish(); }
+    } finishOutput{hub};
+    hub.setUnbuffered(tracing);
+    applyChannelDepths();
+    applyTopology();
+    if (partitions > 1) {
+      return runPartitioned();
+    }
+    if (pdes) {
+      return runPdes();
+    }
+    if (parallel) {
+      return runParallel();
+    }
+    scheduleStats = ScheduleStats();
+    scheduleStats.quantum = quantum;
+    processorStats.assign(procs.size(), ProcessorStats());
+    if (criticalPath && isBuffered()) {
+      throw std::runtime_error(
+          "critical-path analysis needs synchronous channels");
+    }
+    if (criticalPath) {
+      recorder.reset(procs.size());
+      for (auto &p : procs) {
+        p->setRecorder(&recorder);
+      }
+    }
+    for (auto &p : procs) {
+      p->setLineProfile(lineProfile);
+    }
+    if (timeline) {
+      timelineRecorder.reset(procs.size(), channels.size(), timelineInterval);
+      for (auto &p : procs) {
+        p->setTimeline(&timelineRecorder);
+      }
+    }
+    // The processors stepped in the current tick, for the network stats.
+    std::vector<bool> stepped(networkStats ? procs.size() : 0);
+    std::vector<unsigned> steppedIds;
+    walkMarks.assign(procs.size(), 0);
+    waitForest.reset(procs.size());
+    waiters.assign(procs.size(), {});
+    for (auto &p : procs) {
+      p->setWaitForest(&waitForest);
+    }
+    ReadyQueues ready;
+    std::vector<ProcessorTask> tasks;
+    for (auto &p : procs) {
+      if (coroutines) {
+        tasks.push_back(
+            p->execute(ready, quantum, scheduleStats.instructions));
+      }
+      if (p->getStatus() == StepResult::RUNNING) {
+        ready.next.push(p->getId());
+      }
+    }
+    std::vector<unsigned> waitingInput;
+    size_t halted = 0;
     size_t ticks = 0;
     while (true) {
-      // Step every runnable processor once.
-      for (auto &p : procs) {
-        if (p->getStatus() == StepResult::RUNNING) {
-          p->step();
-        }
+      std::swap(ready.current, ready.next);
+      int firstHalted = -1;
+      // Count the round before stepping it, so the ticks of a run stopped
+      // part-way through by an error or a deadlock include it.
+      scheduleStats.ticks = ticks + 1;
+      if (timeline) {
+        timelineRecorder.sample(ticks);
       }
-      // Record the exit code of the first (lowest-id) halted processor.
-      if (!haveExit) {
-        for (auto &p : procs) {
-          if (p->getStatus() == StepResult::HALTED) {
-            exitCode = p->getExitCode();
-            haveExit = true;
-            break;
+      while (!ready.current.empty()) {
+        auto id = ready.current.top();
+        ready.current.pop();
+        auto result = StepResult::RUNNING;
+        auto outputs = procs[id]->getOutputs();
+        procs[id]->setTick(ticks);
+        if (networkStats) {
+          stepped[id] = true;
+          steppedIds.push_back(id);
+        }
+        if (coroutines) {
+          tasks[id].resume();
+          result = procs[id]->getStatus();
+        } else {
+          for (unsigned i = 0; i < quantum && result == StepResult::RUNNING;
+               i++) {
+            result = procs[id]->step();
+            scheduleStats.instructions++;
+            if (auto *partner = procs[id]->takeWoken()) {
+              ready.wake(partner->getId(), id);
+            }
           }
         }
+        if (procs[id]->isWaitingInput()) {
+          waitingInput.push_back(id);
+        } else if (result == StepResult::RUNNING) {
+          ready.next.push(id);
+        } else if (result == StepResult::HALTED) {
+          halted++;
+          if (firstHalted < 0) {
+            firstHalted = static_cast<int>(id);
+          }
+          if (timeline) {
+            timelineRecorder.halt(id, ticks, procs[id]->getExitCode());
+          }
+        }
+        // Check the wait-for graph for a deadlock the turn completed.
+        if (result == StepResult::BLOCKED) {
+          checkWaitFor(*procs[id]);
+        } else if (result == StepResult::HALTED) {
+          checkWaitersOf(*procs[id]);
+        }
+        if (procs[id]->getOutputs() != outputs) {
+          scheduleStats.outputs += procs[id]->getOutputs() - outputs;
+          if (scheduleStats.firstOutputTick < 0) {
+            scheduleStats.firstOutputTick = static_cast<int64_t>(ticks);
+          }
+          scheduleStats.lastOutputTick = static_cast<int64_t>(ticks);
+        }
       }
-      // Termination and deadlock detection.
-      bool allHalted = true;
-      bool anyRunning = false;
-      for (auto &p : procs) {
-        auto s = p->getStatus();
-        allHalted = allHalted && s == StepResult::HALTED;
-        anyRunning = anyRunning || s == StepResult::RUNNING;
+      hub.flush(ticks + 1);
+      if (networkStats) {
+        countTick(stepped);
+        for (auto id : steppedIds) {
+          stepped[id] = false;
+        }
+        steppedIds.clear();
       }
-      if (allHalted) {
-        return exitCode;
+      // Record the exit code of the first (lowest-id) processor to halt.
+      if (!haveExit && firstHalted >= 0) {
+        exitCode = procs[firstHalted]->getExitCode();
+        haveExit = true;
       }
-      if (!anyRunning) {
-        std::string msg = "deadlock detected:";
-        for (size_t i = 0; i < procs.size(); i++) {
-          if (procs[i]->getStatus() == StepResult::BLOCKED) {
-            msg += fmt::format(" processor {} blocked on channel slot {};", i,
-                               procs[i]->getBlockedSlot());
+      // Requeue processors whose input has arrived, waiting for some if no
+      // other processor can run.
+      while (true) {
+        std::erase_if(waitingInput, [&](unsigned id) {
+          if (!procs[id]->inputReady()) {
+            return false;
           }
+          ready.next.push(id);
+          return true;
+        });
+        if (!ready.next.empty() || waitingInput.empty()) {
+          break;
         }
-        throw std::runtime_error(msg);
+        std::this_thread::yield();
+      }
+      // Termination and deadlock detection.
+      if (halted == procs.size()) {
+        return exitCode;
+      }
+      if (ready.next.empty()) {
+        throwDeadlock();
       }
       ticks++;
       if (maxCycles > 0 && ticks > maxCycles) {
@@ -570,12 +2980,803 @@ public:
   }
 
 private:
-  void addProcessor(std::istream &image, unsigned imageSize, unsigned id) {
+  /// Count how each processor spent the last tick: busy if it was stepped and
+  /// is still runnable or has just halted, otherwise blocked or halted. A
+  /// blocked processor not waiting for input waits on the channel it blocked
+  /// on, including one unblocked by a partner later in the tick.
+  void countTick(const std::vector<bool> &stepped) {
+    for (size_t i = 0; i < procs.size(); i++) {
+      auto &p = *procs[i];
+      auto &s = processorStats[i];
+      auto status = p.getStatus();
+      if (status == StepResult::HALTED) {
+        (stepped[i] ? s.busyTicks : s.haltedTicks)++;
+      } else if (stepped[i] && status == StepResult::RUNNING) {
+        s.busyTicks++;
+      } else {
+        s.blockedTicks++;
+        if (!p.isWaitingInput()) {
+          p.countWaitTick();
+        }
+      }
+    }
+  }
+
+  /// Number of instructions a worker runs of one processor before rotating
+  /// to the next in its queue.
+  static constexpr size_t PARALLEL_SLICE = 1024;
+
+  /// Run the processors on a pool of worker threads until all halt, a
+  /// deadlock or an error stops the run, or the cycle limit is reached. Each
+  /// worker starts with a contiguous range of processors, so neighbours in a
+  /// pipeline or ring share a worker, and steals when its own queue runs dry.
+  /// A processor woken by a rendezvous is queued on its partner's worker.
+  int runParallel() {
+    if (tracing || networkStats || criticalPath || timeline || lineProfile ||
+        isBuffered()) {
+      throw std::runtime_error("tracing, run analyses and buffered channels "
+                               "are not supported in parallel mode");
+    }
+    if (quantum != 1) {
+      throw std::runtime_error("a quantum is not supported in parallel mode");
+    }
+    if (coroutines) {
+      throw std::runtime_error("coroutines are not supported in parallel mode");
+    }
+    auto nw = numWorkers();
+    ParallelState state;
+    for (unsigned w = 0; w < nw; w++) {
+      state.queues.push_back(std::make_unique<RunQueue>(state.epoch));
+    }
+    for (size_t i = 0; i < procs.size(); i++) {
+      state.procs.push_back(procs[i].get());
+      state.queues[i * nw / procs.size()]->push(procs[i].get());
+      procs[i]->setParallel(&state);
+    }
+    state.running = state.live = static_cast<unsigned>(procs.size());
+    workerStats.assign(nw, WorkerStats());
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < nw; w++) {
+      threads.emplace_back([this, &state, w] { runWorker(state, w); });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    for (auto &p : procs) {
+      p->setParallel(nullptr);
+    }
+    // Report the error of the lowest-id processor that raised one.
+    for (auto &p : procs) {
+      p->rethrowError();
+    }
+    if (state.deadlocked) {
+      throwDeadlock();
+    }
+    if (state.firstExit >= 0) {
+      exitCode = procs[state.firstExit]->getExitCode();
+      haveExit = true;
+    }
+    return exitCode;
+  }
+
+  /// Return the number of worker threads to use for the network.
+  unsigned numWorkers() const {
+    unsigned n = workers;
+    if (n == 0) {
+      n = std::max(1U, std::thread::hardware_concurrency());
+    }
+    return std::min(n, static_cast<unsigned>(procs.size()));
+  }
+
+  /// Throw if the options of the network are not supported by a PDES run,
+  /// in a single process or partitioned across several.
+  void checkPdesSupported() const {
+    if (tracing || coroutines || networkStats || criticalPath || timeline ||
+        lineProfile || isBuffered()) {
+      throw std::runtime_error("PDES mode does not support tracing, "
+                               "coroutines, run analyses or buffered channels");
+    }
+    if (quantum != 1) {
+      throw std::runtime_error("a quantum is not supported in PDES mode");
+    }
+    if (linkLatency == 0) {
+      throw std::runtime_error("PDES mode needs a link latency of at least 1");
+    }
+  }
+
+  /// Run the network as a conservative parallel discrete-event simulation.
+  /// Each processor advances in its own simulated time, one cycle per
+  /// instruction. The run proceeds in windows as long as the link latency,
+  /// the lookahead: a message posted in a window cannot arrive before the
+  /// window ends, so each worker thread runs its processors through a window
+  /// independently, meeting the others at a barrier. A processor stops at a
+  /// syscall, and between the phases of a window the earliest pending
+  /// syscalls are performed in (time, id) order, so I/O and the exit code
+  /// follow simulated time. Each window starts at the earliest next event,
+  /// skipping stretches in which every processor waits on a channel.
+  int runPdes() {
+    checkPdesSupported();
+    for (auto &p : procs) {
+      p->setPdes(true, linkLatency);
+    }
+    pdesStats = PdesStats();
+    pdesStats.latency = linkLatency;
+    auto nw = numWorkers();
+    uint64_t windowEnd = linkLatency;
+    bool done = false;
+    bool deadlocked = false;
+    std::atomic<bool> failed{false};
+    std::exception_ptr syscallError;
+    std::vector<std::exception_ptr> errors(nw);
+    auto completion = [&]() noexcept {
+      pdesStats.phases++;
+      if (failed) {
+        done = true;
+        return;
+      }
+      try {
+        // Perform the earliest pending syscalls, then rerun the window.
+        std::optional<uint64_t> first;
+        for (auto &p : procs) {
+          if (p->isSyscallPending()) {
+            first = std::min(first.value_or(p->getSimTime()), p->getSimTime());
+          }
+        }
+        if (first) {
+          for (auto &p : procs) {
+            if (p->isSyscallPending() && p->getSimTime() == *first) {
+              p->performSyscall();
+              if (p->getStatus() == StepResult::HALTED && !haveExit) {
+                exitCode = p->getExitCode();
+                haveExit = true;
+              }
+            }
+          }
+          hub.flush(*first + 1);
+          return;
+        }
+        // Start the next window at the earliest next event.
+        pdesStats.windows++;
+        std::optional<uint64_t> start;
+        bool live = false;
+        for (auto &p : procs) {
+          live = live || p->getStatus() != StepResult::HALTED;
+          if (auto t = p->nextEventTime()) {
+            start = std::min(start.value_or(*t), *t);
+          }
+        }
+        if (!start || (maxCycles > 0 && *start > maxCycles)) {
+          deadlocked = !start && live;
+          done = true;
+          return;
+        }
+        windowEnd = *start + linkLatency;
+      } catch (...) {
+        syscallError = std::current_exception();
+        done = true;
+      }
+    };
+    std::barrier sync(static_cast<std::ptrdiff_t>(nw), completion);
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < nw; w++) {
+      threads.emplace_back([&, w] {
+        auto begin = w * procs.size() / nw;
+        auto end = (w + 1) * procs.size() / nw;
+        while (!done) {
+          try {
+            for (auto i = begin; i < end; i++) {
+              procs[i]->runWindow(windowEnd);
+            }
+          } catch (...) {
+            errors[w] = std::current_exception();
+            failed = true;
+          }
+          sync.arrive_and_wait();
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    for (auto &p : procs) {
+      p->setPdes(false, linkLatency);
+      pdesStats.time = std::max(pdesStats.time, p->getSimTime());
+    }
+    for (auto &e : errors) {
+      if (e) {
+        std::rethrow_exception(e);
+      }
+    }
+    if (syscallError) {
+      std::rethrow_exception(syscallError);
+    }
+    if (deadlocked) {
+      throwDeadlock();
+    }
+    return exitCode;
+  }
+
+  /// Bytes of each ring between the workers of a partitioned run, which must
+  /// hold the largest message, a block of all of memory, and of the ring
+  /// carrying their output.
+  static constexpr uint64_t PARTITION_RING_BYTES = 1 << 21;
+  static constexpr uint64_t OUTPUT_RING_BYTES = 1 << 16;
+  static_assert(PARTITION_RING_BYTES >=
+                sizeof(PartitionRecord) + 4 * hex::MAX_MEMORY_SIZE_WORDS);
+
+  /// Run the network as a PDES across worker processes (see setPartitions).
+  /// Each worker runs its processors through the windows and phases of
+  /// runPdes, exchanging the messages posted on remote channels between
+  /// phases: a message arrives after the window it was posted in ends, so it
+  /// need not be seen sooner. At each barrier the workers publish their state
+  /// and each takes the same decision from all of them, so termination and
+  /// deadlock detection need no coordinator. Syscalls are performed in
+  /// (time, id) order by the workers in turn.
+  int runPartitioned() {
+    checkPdesSupported();
+    auto np = static_cast<unsigned>(std::min<size_t>(partitions, procs.size()));
+    std::vector<unsigned> partitionOf(procs.size());
+    for (size_t i = 0; i < procs.size(); i++) {
+      partitionOf[i] = static_cast<unsigned>(i * np / procs.size());
+    }
+    // Lay out the shared memory: the control block, the state of each
+    // partition and processor, the output ring, and a ring for each ordered
+    // pair of partitions sharing a channel.
+    const size_t NO_RING = ~size_t(0);
+    hexshm::Layout layout;
+    auto controlAt = layout.reserve(sizeof(PartitionControl));
+    auto statesAt = layout.reserve(np * sizeof(PartitionState));
+    auto stoppedAt = layout.reserve(procs.size() * sizeof(StoppedState));
+    auto outputAt = layout.reserve(hexshm::Ring::size(OUTPUT_RING_BYTES));
+    std::vector<size_t> ringAt(np * np, NO_RING);
+    for (size_t i = 0; i < channels.size(); i++) {
+      auto a = partitionOf[edges[i].procA];
+      auto b = partitionOf[edges[i].procB];
+      channels[i]->remote = a != b;
+      for (auto pair : {a * np + b, b * np + a}) {
+        if (a != b && ringAt[pair] == NO_RING) {
+          ringAt[pair] =
+              layout.reserve(hexshm::Ring::size(PARTITION_RING_BYTES));
+        }
+      }
+    }
+    hexshm::Mapping shared(layout.total());
+    auto &control = *new (shared.at<void>(controlAt)) PartitionControl();
+    auto *states = shared.at<PartitionState>(statesAt);
+    auto *stopped = shared.at<StoppedState>(stoppedAt);
+    auto &output =
+        *hexshm::Ring::create(shared, outputAt, OUTPUT_RING_BYTES);
+    std::vector<hexshm::Ring *> rings(np * np);
+    for (size_t i = 0; i < rings.size(); i++) {
+      if (ringAt[i] != NO_RING) {
+        rings[i] = hexshm::Ring::create(shared, ringAt[i],
+                                        PARTITION_RING_BYTES);
+      }
+    }
+    // Fork the workers. A worker leaves by _exit, so it never flushes or
+    // destroys what it shares with this process.
+    out.flush();
+    std::vector<pid_t> pids;
+    for (unsigned k = 0; k < np; k++) {
+      auto pid = fork();
+      if (pid < 0) {
+        control.abort = true;
+        break;
+      }
+      if (pid == 0) {
+        int status = 0;
+        try {
+          runPartition(k, partitionOf, control, states, stopped, output,
+                       rings);
+        } catch (std::exception &e) {
+          failPartition(states[k], e.what());
+          control.abort = true;
+          status = 1;
+        } catch (...) {
+          control.abort = true;
+          status = 1;
+        }
+        _exit(status);
+      }
+      pids.push_back(pid);
+    }
+    // Serve the workers until they have all exited, stopping them all if one
+    // fails to run to the end.
+    bool crashed = pids.size() < np;
+    std::exception_ptr serveError;
+    std::vector<char> buffer;
+    while (!pids.empty()) {
+      bool served = false;
+      try {
+        served = servePartitions(control, output, buffer);
+      } catch (...) {
+        serveError = std::current_exception();
+        control.abort = true;
+      }
+      std::erase_if(pids, [&](pid_t pid) {
+        int status = 0;
+        if (waitpid(pid, &status, WNOHANG) != pid) {
+          return false;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          crashed = true;
+          control.abort = true;
+        }
+        return true;
+      });
+      if (!served) {
+        std::this_thread::yield();
+      }
+    }
+    servePartitions(control, output, buffer);
+    for (auto &c : channels) {
+      c->remote = c->messageOut = c->ackOut = false;
+    }
+    if (serveError) {
+      std::rethrow_exception(serveError);
+    }
+    // Report the error of the lowest partition that raised one.
+    for (unsigned k = 0; k < np; k++) {
+      if (states[k].failed) {
+        throw std::runtime_error(states[k].error);
+      }
+    }
+    if (crashed) {
+      throw std::runtime_error("a partition worker process failed");
+    }
+    pdesStats = PdesStats();
+    pdesStats.latency = linkLatency;
+    pdesStats.windows = control.windows;
+    pdesStats.phases = control.phases;
+    for (size_t i = 0; i < procs.size(); i++) {
+      procs[i]->setStoppedState(stopped[i]);
+      pdesStats.time = std::max(pdesStats.time, stopped[i].simTime);
+    }
+    if (control.deadlocked) {
+      throwDeadlock();
+    }
+    if (control.haveExit) {
+      exitCode = control.exitCode;
+      haveExit = true;
+    }
+    return exitCode;
+  }
+
+  /// Copy the output of the workers of a partitioned run, then serve a
+  /// pending input request. Returns true if there was anything to do.
+  bool servePartitions(PartitionControl &control, hexshm::Ring &output,
+                       std::vector<char> &buffer) {
+    bool served = false;
+    if (auto n = output.readable()) {
+      buffer.resize(n);
+      output.peek(buffer.data(), n);
+      output.consume(n);
+      out.write(buffer.data(), static_cast<std::streamsize>(n));
+      served = true;
+    }
+    if (control.input.load(std::memory_order_acquire) ==
+        PartitionControl::INPUT_REQUESTED) {
+      out.flush();
+      auto c = in.get();
+      control.inputChar = c == std::char_traits<char>::eof() ? -1 : c;
+      control.input.store(PartitionControl::INPUT_READY,
+                          std::memory_order_release);
+      served = true;
+    }
+    return served;
+  }
+
+  /// Record the error that stopped a worker of a partitioned run.
+  static void failPartition(PartitionState &state, const char *error) {
+    std::snprintf(state.error, sizeof(state.error), "%s", error);
+    state.failed = true;
+  }
+
+  /// The body of worker process k of a partitioned run.
+  void runPartition(unsigned k, const std::vector<unsigned> &partitionOf,
+                    PartitionControl &control, PartitionState *states,
+                    StoppedState *stopped, hexshm::Ring &output,
+                    const std::vector<hexshm::Ring *> &rings) {
+    auto np = static_cast<unsigned>(partitionOf.back() + 1);
+    PartitionOutput outputBuffer(output, control.abort);
+    PartitionInput inputBuffer(control);
+    out.rdbuf(&outputBuffer);
+    in.rdbuf(&inputBuffer);
+    std::vector<Processor *> local;
+    for (size_t i = 0; i < procs.size(); i++) {
+      if (partitionOf[i] == k) {
+        local.push_back(procs[i].get());
+        procs[i]->setPdes(true, linkLatency);
+      }
+    }
+    // The remote channels with an endpoint here, and where the other is.
+    std::vector<std::pair<size_t, unsigned>> remote;
+    for (size_t i = 0; i < channels.size(); i++) {
+      auto a = partitionOf[edges[i].procA];
+      auto b = partitionOf[edges[i].procB];
+      if (a != b && (a == k || b == k)) {
+        remote.push_back({i, a == k ? b : a});
+      }
+    }
+    // Apply the messages and acknowledgements other workers have sent.
+    auto receive = [&] {
+      for (unsigned from = 0; from < np; from++) {
+        auto *ring = rings[from * np + k];
+        while (ring && ring->readable() >= sizeof(PartitionRecord)) {
+          PartitionRecord r;
+          ring->peek(&r, sizeof(r));
+          auto &c = *channels[r.channel];
+          if (r.ack) {
+            c.ackValid = true;
+            c.ackTime = r.time;
+          } else {
+            c.message.valid = true;
+            c.message.time = r.time;
+            c.message.block = r.block;
+            c.message.count = r.count;
+            c.message.data.resize(r.words);
+            ring->peek(c.message.data.data(), 4 * r.words, sizeof(r));
+          }
+          ring->consume(sizeof(r) + 4 * r.words);
+        }
+      }
+    };
+    // Send a record, receiving while the ring is full so that two workers
+    // sending to each other cannot both wait.
+    std::vector<char> bytes;
+    auto send = [&](unsigned to, const PartitionRecord &r,
+                    const uint32_t *data) {
+      bytes.resize(sizeof(r) + 4 * r.words);
+      std::memcpy(bytes.data(), &r, sizeof(r));
+      std::memcpy(bytes.data() + sizeof(r), data, 4 * r.words);
+      while (!rings[k * np + to]->tryWrite(bytes.data(), bytes.size())) {
+        if (control.abort.load(std::memory_order_acquire)) {
+          return false;
+        }
+        receive();
+        std::this_thread::yield();
+      }
+      return true;
+    };
+    auto wait = [&] {
+      if (!control.barrier.arriveAndWait(np, control.abort, receive)) {
+        return false;
+      }
+      receive();
+      return true;
+    };
+    auto anyFailed = [&] {
+      return std::any_of(states, states + np,
+                         [](const PartitionState &s) { return s.failed; });
+    };
+    // Wait for this worker's turn to do I/O.
+    auto takeTurn = [&] {
+      while (control.turn.load(std::memory_order_acquire) != k) {
+        if (control.abort.load(std::memory_order_acquire)) {
+          return false;
+        }
+        std::this_thread::yield();
+      }
+      return true;
+    };
+    auto &state = states[k];
+    uint64_t windowEnd = linkLatency;
+    uint64_t windows = 0;
+    uint64_t phases = 0;
+    bool deadlocked = false;
+    while (true) {
+      try {
+        for (auto *p : local) {
+          p->runWindow(windowEnd);
+        }
+      } catch (std::exception &e) {
+        failPartition(state, e.what());
+      }
+      for (auto [i, to] : remote) {
+        auto &c = *channels[i];
+        if (c.messageOut) {
+          PartitionRecord r{static_cast<uint32_t>(i), 0, c.message.time,
+                            c.message.block, c.message.count,
+                            static_cast<uint32_t>(c.message.data.size()), 0};
+          if (!send(to, r, c.message.data.data())) {
+            return;
+          }
+          c.message.valid = c.messageOut = false;
+        }
+        if (c.ackOut) {
+          PartitionRecord r{static_cast<uint32_t>(i), 1, c.ackTime, 0, 0, 0, 0};
+          if (!send(to, r, nullptr)) {
+            return;
+          }
+          c.ackValid = c.ackOut = false;
+        }
+      }
+      if (!wait()) {
+        return;
+      }
+      phases++;
+      if (anyFailed()) {
+        break;
+      }
+      state.syscallTime = state.nextEvent = PartitionState::NONE;
+      state.live = false;
+      for (auto *p : local) {
+        if (p->isSyscallPending()) {
+          state.syscallTime = std::min(state.syscallTime, p->getSimTime());
+        }
+        state.live = state.live || p->getStatus() != StepResult::HALTED;
+        if (auto t = p->nextEventTime()) {
+          state.nextEvent = std::min(state.nextEvent, *t);
+        }
+      }
+      if (!wait()) {
+        return;
+      }
+      auto first = PartitionState::NONE;
+      auto start = PartitionState::NONE;
+      bool live = false;
+      for (unsigned j = 0; j < np; j++) {
+        first = std::min(first, states[j].syscallTime);
+        start = std::min(start, states[j].nextEvent);
+        live = live || states[j].live;
+      }
+      if (first != PartitionState::NONE) {
+        // Perform the earliest syscalls, in turn, then rerun the window.
+        if (!takeTurn()) {
+          return;
+        }
+        try {
+          for (auto *p : local) {
+            if (p->isSyscallPending() && p->getSimTime() == first) {
+              p->performSyscall();
+              if (p->getStatus() == StepResult::HALTED && !control.haveExit) {
+                control.exitCode = p->getExitCode();
+                control.haveExit = true;
+              }
+            }
+          }
+          hub.flush(first + 1);
+        } catch (std::exception &e) {
+          failPartition(state, e.what());
+        }
+        control.turn.store(k + 1, std::memory_order_release);
+        if (!wait()) {
+          return;
+        }
+        if (k == 0) {
+          control.turn.store(0, std::memory_order_release);
+        }
+        if (anyFailed()) {
+          break;
+        }
+        continue;
+      }
+      // Start the next window at the earliest next event.
+      windows++;
+      if (start == PartitionState::NONE ||
+          (maxCycles > 0 && start > maxCycles)) {
+        deadlocked = start == PartitionState::NONE && live;
+        break;
+      }
+      windowEnd = start + linkLatency;
+    }
+    for (auto *p : local) {
+      stopped[p->getId()] = p->getStoppedState();
+    }
+    // Write any output still buffered (tagged lines without an end), in
+    // turn.
+    if (!takeTurn()) {
+      return;
+    }
+    hub.finish();
+    control.turn.store(k + 1, std::memory_order_release);
+    if (k == 0) {
+      control.windows = windows;
+      control.phases = phases;
+      control.deadlocked = deadlocked;
+    }
+  }
+
+  /// The body of worker thread w in a parallel run.
+  void runWorker(ParallelState &state, unsigned w) {
+    using clock = std::chrono::steady_clock;
+    auto &stats = workerStats[w];
+    auto start = clock::now();
+    auto nw = static_cast<unsigned>(state.queues.size());
+    while (!state.stop.load(std::memory_order_acquire)) {
+      // Read the epoch before scanning, so a push after the scan wakes this
+      // worker.
+      auto epoch = state.epoch.load(std::memory_order_acquire);
+      auto *p = state.queues[w]->pop();
+      for (unsigned i = 1; !p && i < nw; i++) {
+        p = state.queues[(w + i) % nw]->steal();
+        stats.steals += p != nullptr;
+      }
+      if (!p) {
+        // Sleep until a processor is queued or the run stops.
+        state.epoch.wait(epoch, std::memory_order_acquire);
+        continue;
+      }
+      auto begin = clock::now();
+      if (p->runSlice(w, PARALLEL_SLICE, stats.instructions)) {
+        state.queues[w]->push(p);
+      }
+      stats.slices++;
+      stats.busySeconds +=
+          std::chrono::duration<double>(clock::now() - begin).count();
+    }
+    stats.totalSeconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+  /// Return the name of channel i: its source-level name if the container
+  /// records it, otherwise c<i>.
+  std::string channelName(size_t i) const {
+    return i < channelNames.size() ? channelNames[i] : fmt::format("c{}", i);
+  }
+
+  /// Set the FIFO depth of each channel from the default and the overrides.
+  void applyChannelDepths() {
+    for (auto &entry : channelDepths) {
+      bool found = false;
+      for (size_t i = 0; i < channels.size() && !found; i++) {
+        found = channelName(i) == entry.first;
+      }
+      if (!found) {
+        throw std::runtime_error("no channel named " + entry.first);
+      }
+    }
+    for (size_t i = 0; i < channels.size(); i++) {
+      auto it = channelDepths.find(channelName(i));
+      channels[i]->depth =
+          it != channelDepths.end() ? it->second : channelDepth;
+    }
+  }
+
+  /// Set the hops of each channel from the placement of its endpoints.
+  void applyTopology() {
+    if (topology.empty()) {
+      return;
+    }
+    auto nodes = getPlacement();
+    hexplace::validate(topology, nodes, procs.size());
+    for (size_t i = 0; i < channels.size(); i++) {
+      channels[i]->hops =
+          std::max(1U, topology.hops(nodes[edges[i].procA],
+                                     nodes[edges[i].procB]));
+    }
+  }
+
+  /// Return true if any channel has a FIFO.
+  bool isBuffered() const {
+    return std::any_of(channels.begin(), channels.end(),
+                       [](const auto &c) { return c->depth > 0; });
+  }
+
+  /// Add the wait-for edge of a processor that has just blocked. It is
+  /// deadlocked if the chain of blocked processors it waits on comes back to
+  /// it, or ends at a halted processor or in another deadlock: that is, if
+  /// the root of its partner's tree in the wait-for forest is itself, halted
+  /// or blocked.
+  void checkWaitFor(Processor &blocked) {
+    auto id = blocked.getId();
+    auto partner = blocked.getWaitsFor()->getId();
+    auto &list = waiters[partner];
+    std::erase_if(list, [&](const Processor *w) {
+      return w == &blocked || w->getStatus() != StepResult::BLOCKED ||
+             w->getWaitsFor() != blocked.getWaitsFor();
+    });
+    list.push_back(&blocked);
+    auto root = waitForest.root(partner);
+    if (root != id) {
+      waitForest.link(id, partner);
+    }
+    if (procs[root]->getStatus() == StepResult::RUNNING) {
+      return;
+    }
+    // Walk the chain edge by edge to describe it.
+    walkPath.clear();
+    walkMark++;
+    const Processor *p = &blocked;
+    while (p->getStatus() == StepResult::BLOCKED &&
+           walkMarks[p->getId()] != walkMark) {
+      walkMarks[p->getId()] = walkMark;
+      walkPath.push_back(p);
+      p = p->getWaitsFor();
+    }
+    reportDeadlock(describeWaits(walkPath, *p));
+  }
+
+  /// Check for processors left waiting on one that has just halted.
+  void checkWaitersOf(const Processor &halted) {
+    auto &list = waiters[halted.getId()];
+    std::sort(list.begin(), list.end(), [](auto *a, auto *b) {
+      return a->getId() < b->getId();
+    });
+    for (auto *p : list) {
+      if (p->getStatus() == StepResult::BLOCKED &&
+          p->getWaitsFor() == &halted) {
+        reportDeadlock(describeWaits({p}, halted));
+      }
+    }
+    list.clear();
+  }
+
+  /// Report a deadlock to the hook, or stop the run with it.
+  void reportDeadlock(const std::string &waits) {
+    auto msg = "deadlock detected: " + waits;
+    if (!deadlockHook) {
+      throw std::runtime_error(msg);
+    }
+    deadlockHook(msg);
+  }
+
+  /// Describe a chain of blocked processors, each waiting on the next, ending
+  /// with the one the last waits on.
+  static std::string describeWaits(const std::vector<const Processor *> &chain,
+                                   const Processor &end) {
+    std::string msg;
+    for (auto *p : chain) {
+      msg += p->describeBlocked() + " -> ";
+    }
+    msg += fmt::format("processor {}", end.getId());
+    if (end.getStatus() == StepResult::HALTED) {
+      msg += " (halted)";
+    } else if (&end != chain.front()) {
+      msg += " (deadlocked)";
+    }
+    return msg;
+  }
+
+  /// Throw a deadlock of the whole network, describing each cycle in the
+  /// wait-for graph and each processor waiting on a halted one.
+  [[noreturn]] void throwDeadlock() const {
+    enum class Visit { NONE, ON_PATH, DONE };
+    std::vector<Visit> visits(procs.size(), Visit::NONE);
+    std::vector<std::string> waits;
+    for (auto &start : procs) {
+      std::vector<const Processor *> chain;
+      auto *p = start.get();
+      while (p->getStatus() == StepResult::BLOCKED &&
+             visits[p->getId()] == Visit::NONE) {
+        visits[p->getId()] = Visit::ON_PATH;
+        chain.push_back(p);
+        p = p->getWaitsFor();
+      }
+      if (p->getStatus() == StepResult::BLOCKED &&
+          visits[p->getId()] == Visit::ON_PATH) {
+        auto cycle = std::find(chain.begin(), chain.end(), p);
+        waits.push_back(describeWaits({cycle, chain.end()}, *p));
+      } else if (p->getStatus() == StepResult::HALTED && !chain.empty()) {
+        waits.push_back(describeWaits({chain.back()}, *p));
+      }
+      for (auto *q : chain) {
+        visits[q->getId()] = Visit::DONE;
+      }
+    }
+    if (waits.empty()) {
+      for (auto &p : procs) {
+        if (p->getStatus() == StepResult::BLOCKED) {
+          waits.push_back(p->describeBlocked());
+        }
+      }
+    }
+    std::string msg = "deadlock detected: ";
+    for (size_t i = 0; i < waits.size(); i++) {
+      msg += (i > 0 ? "; " : "") + waits[i];
+    }
+    throw std::runtime_error(msg);
+  }
+
+  void addProcessor(const hexcontainer::ImageView &image,
+                    std::shared_ptr<const void> owner, unsigned id) {
     auto p = std::make_unique<Processor>(in, out, maxCycles);
     p->setId(id);
+    p->setIOHub(&hub);
     p->setTracing(tracing);
     p->setTruncateInputs(truncateInputs);
-    p->loadFromStream(image, imageSize);
+    p->setInputReady(inputReadyHook);
+    p->loadImage(image, std::move(owner));
     procs.push_back(std::move(p));
   }
 };
@@ -1,16 +1,36 @@
 #ifndef HEX_SIM_IO_HPP
 #define HEX_SIM_IO_HPP
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <istream>
 #include <ostream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace hex {
 
-class HexSimIO {
+/// The host streams of one or more simulated processors: stdin/stdout, and
+/// the simin<N>/simout<N> files, each opened once, so the processors share
+/// one read cursor per input stream. Each processor writes through its own
+/// port, and a port's output is buffered with the time it was written at and
+/// merged into the host streams in (time, port) order as the scheduler
+/// flushes the times it has finished with. The merged output therefore does
+/// not depend on when the processors ran, and is written in chunks rather
+/// than a character at a time.
+///
+/// A port's standard output can instead be written a line at a time, tagged
+/// with a [coreN] prefix, or to a file of its own.
+class IOHub {
+public:
+  static constexpr uint64_t ALL = ~uint64_t(0);
 
   // Number of file-backed I/O streams.
   static constexpr size_t NUM_IO_STREAMS = 8;
@@ -19,48 +39,308 @@ class HexSimIO {
   static constexpr int FILE_STREAM_BASE = 256;
   static constexpr int FILE_INDEX_SHIFT = 8;
 
+  /// Where each port's standard output goes.
+  enum class Mode { MERGED, TAGGED, SPLIT };
+
+private:
+  // Buffered output beyond which the times before the latest are flushed.
+  static constexpr size_t FLUSH_BYTES = 1 << 16;
+
+  struct Chunk {
+    uint64_t time;
+    int stream;
+    std::string text;
+  };
+
+  struct Port {
+    std::deque<Chunk> chunks; // oldest first
+    std::string line;         // the tagged line being assembled
+    std::ofstream file;       // the split output file
+  };
+
   std::istream &in;
   std::ostream &out;
-  std::array<std::fstream, NUM_IO_STREAMS> fileIO;
-  std::array<bool, NUM_IO_STREAMS> connected{};
+  std::array<std::ofstream, NUM_IO_STREAMS> outFiles;
+  std::array<std::ifstream, NUM_IO_STREAMS> inFiles;
+  std::vector<Port> ports;
+  Mode mode = Mode::MERGED;
+  std::string splitPrefix;
+  bool unbuffered = false;
+  size_t buffered = 0;
+  bool written = false; // to out since it was last flushed
 
   /// Extract the file index encoded in a (file-backed) stream id.
   static size_t fileIndex(int stream) {
     return (stream >> FILE_INDEX_SHIFT) & (NUM_IO_STREAMS - 1);
   }
 
+  /// Write text a port output to a stream.
+  void write(unsigned port, int stream, const std::string &text) {
+    if (stream >= FILE_STREAM_BASE) {
+      auto &file = outFiles[fileIndex(stream)];
+      if (!file.is_open()) {
+        file.open("simout" + std::to_string(fileIndex(stream)));
+      }
+      file << text;
+      return;
+    }
+    auto &p = ports[port];
+    switch (mode) {
+    case Mode::MERGED:
+      out << text;
+      written = true;
+      break;
+    case Mode::TAGGED:
+      p.line += text;
+      for (auto end = p.line.find('\n'); end != std::string::npos;
+           end = p.line.find('\n')) {
+        out << "[core" << port << "] ";
+        out.write(p.line.data(), end + 1);
+        p.line.erase(0, end + 1);
+        written = true;
+      }
+      break;
+    case Mode::SPLIT:
+      if (!p.file.is_open()) {
+        p.file.open(splitPrefix + std::to_string(port));
+      }
+      p.file << text;
+      break;
+    }
+  }
+
 public:
-  HexSimIO(std::istream &in, std::ostream &out) : in(in), out(out) {}
+  IOHub(std::istream &in, std::ostream &out) : in(in), out(out) {}
+  IOHub(const IOHub &) = delete;
+  IOHub &operator=(const IOHub &) = delete;
 
-  /// Output a character to ostream or a file.
-  void output(char value, int stream) {
+  /// Tag each line of each port's standard output with its port.
+  void setTagged() { mode = Mode::TAGGED; }
+  /// Write each port's standard output to the file prefix<port>.
+  void setSplit(const std::string &prefix) {
+    mode = Mode::SPLIT;
+    splitPrefix = prefix;
+  }
+  /// Write output as it arrives rather than buffering it, when the caller
+  /// delivers it in time order and interleaves other output with it.
+  void setUnbuffered(bool value) { unbuffered = value; }
+
+  /// Output a character from a port at a time.
+  void output(unsigned port, uint64_t time, int stream, char value) {
+    if (port >= ports.size()) {
+      ports.resize(port + 1);
+    }
+    if (unbuffered) {
+      write(port, stream, std::string(1, value));
+      return;
+    }
+    auto &chunks = ports[port].chunks;
+    if (chunks.empty() || chunks.back().time != time ||
+        chunks.back().stream != stream) {
+      chunks.push_back({time, stream, {}});
+    }
+    chunks.back().text += value;
+    if (++buffered >= FLUSH_BYTES) {
+      flush(time);
+    }
+  }
+
+  /// Input a character from stdin or a file, returning EOF at the end. The
+  /// output so far is written first, so a prompt appears before the read.
+  int input(int stream) {
+    flush();
+    if (written) {
+      out.flush();
+      written = false;
+    }
     if (stream < FILE_STREAM_BASE) {
-      out << value;
-    } else {
-      size_t index = fileIndex(stream);
-      if (!connected[index]) {
-        fileIO[index].open(std::string("simout") + std::to_string(index),
-                           std::fstream::out);
-        connected[index] = true;
+      return in.get();
+    }
+    auto &file = inFiles[fileIndex(stream)];
+    if (!file.is_open()) {
+      file.open("simin" + std::to_string(fileIndex(stream)));
+    }
+    return file.get();
+  }
+
+  /// Write the buffered output timed before a time, merged in (time, port)
+  /// order.
+  void flush(uint64_t before = ALL) {
+    if (buffered == 0) {
+      return;
+    }
+    struct Next {
+      uint64_t time;
+      unsigned port;
+      size_t index;
+    };
+    std::vector<Next> order;
+    for (unsigned p = 0; p < ports.size(); p++) {
+      auto &chunks = ports[p].chunks;
+      for (size_t i = 0; i < chunks.size() && chunks[i].time < before; i++) {
+        order.push_back({chunks[i].time, p, i});
       }
-      fileIO[index].put(value);
     }
+    std::sort(order.begin(), order.end(), [](const Next &a, const Next &b) {
+      return std::tie(a.time, a.port, a.index) <
+             std::tie(b.time, b.port, b.index);
+    });
+    std::vector<size_t> written(ports.size());
+    for (auto &n : order) {
+      auto &chunk = ports[n.port].chunks[n.index];
+      write(n.port, chunk.stream, chunk.text);
+      buffered -= chunk.text.size();
+      written[n.port]++;
+    }
+    for (unsigned p = 0; p < ports.size(); p++) {
+      auto &chunks = ports[p].chunks;
+      chunks.erase(chunks.begin(), chunks.begin() + written[p]);
+    }
+  }
+
+  /// Write all the buffered output, including tagged lines without an end,
+  /// at the end of a run.
+  void finish() {
+    flush();
+    for (unsigned p = 0; p < ports.size(); p++) {
+      if (!ports[p].line.empty()) {
+        out << "[core" << p << "] " << ports[p].line;
+        ports[p].line.clear();
+      }
+    }
+    out.flush();
+  }
+};
+
+/// The I/O of one processor: a port of a hub shared with the other
+/// processors of a network, or of a hub of its own that writes through.
+class HexSimIO {
+
+  IOHub own;
+  IOHub *hub = &own;
+  unsigned port = 0;
+  uint64_t time = 0;
+  // Reports whether a read from a stream can proceed without blocking.
+  std::function<bool(int)> inputReadyHook;
+
+public:
+  HexSimIO(std::istream &in, std::ostream &out) : own(in, out) {
+    own.setUnbuffered(true);
+  }
+
+  /// Do I/O through a port of a shared hub.
+  void setHub(IOHub *value, unsigned number) {
+    hub = value;
+    port = number;
+  }
+
+  /// Set the time the next I/O happens at, which orders this port's output
+  /// against the others'.
+  void setTime(uint64_t value) { time = value; }
+
+  /// Set a hook reporting whether input is available on a stream, so a
+  /// scheduler can suspend a read rather than block on it. Without one, input
+  /// is always treated as available.
+  void setInputReady(std::function<bool(int)> hook) {
+    inputReadyHook = std::move(hook);
+  }
+
+  /// Return true if a read from stream can proceed without blocking.
+  bool inputReady(int stream) const {
+    return !inputReadyHook || inputReadyHook(stream);
+  }
+
+  /// Output a character to ostream or a file.
+  void output(char value, int stream) {
+    hub->output(port, time, stream, value);
   }
 
   /// Input a character from stdin or a file.
-  char input(int stream) {
-    if (stream < FILE_STREAM_BASE) {
-      return in.get();
-    } else {
-      size_t index = fileIndex(stream);
-      if (!connected[index]) {
-        fileIO[index].open(std::string("simin") + std::to_string(index),
-                           std::fstream::in);
-        connected[index] = true;
+  char input(int stream) { return getChar(stream); }
+
+  /// Output a packed string held at a word address in a memory of size words:
+  /// the low byte of the first word is the length, followed by the
+  /// characters, least significant byte first (the packing emitted by xcmp).
+  void outputString(const uint32_t *memory, size_t size, uint32_t address,
+                    int stream) {
+    checkBounds(address, 1, size);
+    uint32_t length = memory[address] & 0xFF;
+    checkBounds(address, length / 4 + 1, size);
+    for (uint32_t i = 1; i <= length; i++) {
+      output((memory[address + i / 4] >> ((i % 4) * 8)) & 0xFF, stream);
+    }
+  }
+
+  /// Output count words from a memory of size words, one character per word.
+  void outputWords(const uint32_t *memory, size_t size, uint32_t address,
+                   uint32_t count, int stream) {
+    checkBounds(address, count, size);
+    for (uint32_t i = 0; i < count; i++) {
+      output(memory[address + i], stream);
+    }
+  }
+
+  /// Input a line of at most maxLength (up to 255) characters into a packed
+  /// string at a word address in a memory of size words. The newline is
+  /// consumed but not stored. Returns the length read.
+  uint32_t inputString(uint32_t *memory, size_t size, uint32_t address,
+                       uint32_t maxLength, int stream) {
+    maxLength = std::min<uint32_t>(maxLength, 0xFF);
+    checkBounds(address, maxLength / 4 + 1, size);
+    uint32_t length = 0;
+    uint32_t word = 0;
+    while (length < maxLength) {
+      int value = getChar(stream);
+      if (value == EOF_VALUE || value == '\n') {
+        break;
+      }
+      length++;
+      word |= static_cast<uint32_t>(value & 0xFF) << ((length % 4) * 8);
+      if (length % 4 == 3) {
+        memory[address + length / 4] = word;
+        word = 0;
+      }
+    }
+    if (length % 4 != 3) {
+      memory[address + length / 4] = word;
+    }
+    // The length byte shares the first word with the first characters.
+    memory[address] = (memory[address] & ~0xFFU) | length;
+    return length;
+  }
+
+  /// Input up to count characters into consecutive words of a memory of size
+  /// words, stopping at the end of the stream. Characters are truncated to 8
+  /// bits unless truncate is false. Returns the number of characters read.
+  uint32_t inputWords(uint32_t *memory, size_t size, uint32_t address,
+                      uint32_t count, int stream, bool truncate = true) {
+    checkBounds(address, count, size);
+    uint32_t i = 0;
+    for (; i < count; i++) {
+      int value = getChar(stream);
+      if (value == EOF_VALUE) {
+        break;
       }
-      return fileIO[index].get();
+      char c = static_cast<char>(value);
+      memory[address + i] = truncate ? c & 0xFF : c;
     }
+    return i;
   }
+
+private:
+  static constexpr int EOF_VALUE = std::char_traits<char>::eof();
+
+  /// Throw if a block syscall's words words at a word address do not fit in a
+  /// memory of size words.
+  static void checkBounds(uint32_t address, uint32_t words, size_t size) {
+    if (words > size || address > size - words) {
+      throw std::runtime_error("block syscall of " + std::to_string(words) +
+                               " words out of bounds");
+    }
+  }
+
+  /// Read a character from stdin or a file, returning EOF_VALUE at the end.
+  int getChar(int stream) { return hub->input(stream); }
 };
 
 } // End namespace hex.
@@ -26,6 +26,11 @@ public:
                            : "no location";
   }
   bool isNull() const { return !lineAndPosition.has_value(); }
+  /// Return the line numbered from 1 as an editor does (the lexers count from
+  /// 0), or 0 for no location.
+  size_t getLineNumber() const {
+    return lineAndPosition ? lineAndPosition->first + 1 : 0;
+  }
 };
 
 /// General error class, optionally carrying a source location.
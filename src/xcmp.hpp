@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 
+#include "hexcontainer.hpp"
 #include "lexer.hpp"
 #include "util.hpp"
 
@@ -48,6 +49,7 @@ enum class Token {
   ELSE,
   WHILE,
   DO,
+  FOR,
   ASS,
   SKIP,
   BEGIN,
@@ -76,6 +78,13 @@ enum class Token {
   LE,
   GR,
   GE,
+  MUL,
+  DIV,
+  LSH,
+  RSH,
+  BITAND,
+  BITOR,
+  BITXOR,
   CHAN,
   PAR,
   PLING,
@@ -109,6 +118,8 @@ inline const char *tokenEnumStr(Token token) {
     return "while";
   case Token::DO:
     return "do";
+  case Token::FOR:
+    return "for";
   case Token::ASS:
     return ":=";
   case Token::SKIP:
@@ -165,6 +176,20 @@ inline const char *tokenEnumStr(Token token) {
     return ">";
   case Token::GE:
     return ">=";
+  case Token::MUL:
+    return "*";
+  case Token::DIV:
+    return "/";
+  case Token::LSH:
+    return "<<";
+  case Token::RSH:
+    return ">>";
+  case Token::BITAND:
+    return "bitand";
+  case Token::BITOR:
+    return "bitor";
+  case Token::BITXOR:
+    return "bitxor";
   case Token::CHAN:
     return "chan";
   case Token::PAR:
@@ -193,6 +218,13 @@ inline bool isBinaryOp(Token token) {
   case Token::LE:
   case Token::GR:
   case Token::GE:
+  case Token::MUL:
+  case Token::DIV:
+  case Token::LSH:
+  case Token::RSH:
+  case Token::BITAND:
+  case Token::BITOR:
+  case Token::BITXOR:
     return true;
   default:
     return false;
@@ -237,6 +269,13 @@ struct SemanticTokenError : public ParserTokenError {
       : ParserTokenError(location, message, token) {}
 };
 
+struct ExtendedOpError : public Error {
+  ExtendedOpError(Location location, Token token)
+      : Error(location,
+              fmt::format("operator {} requires the extended OPR instructions",
+                          tokenEnumStr(token))) {}
+};
+
 struct UnknownSymbolError : public Error {
   UnknownSymbolError(Location location, std::string name)
       : Error(location, fmt::format("could not find symbol {}", name)) {}
@@ -290,10 +329,14 @@ class Lexer : public hexlex::LexerBase<Token> {
   void declareKeywords() {
     table.insert("and", Token::AND);
     table.insert("array", Token::ARRAY);
+    table.insert("bitand", Token::BITAND);
+    table.insert("bitor", Token::BITOR);
+    table.insert("bitxor", Token::BITXOR);
     table.insert("chan", Token::CHAN);
     table.insert("do", Token::DO);
     table.insert("else", Token::ELSE);
     table.insert("false", Token::FALSE);
+    table.insert("for", Token::FOR);
     table.insert("func", Token::FUNC);
     table.insert("if", Token::IF);
     table.insert("is", Token::IS);
@@ -442,6 +485,14 @@ class Lexer : public hexlex::LexerBase<Token> {
       readChar();
       token = Token::MINUS;
       break;
+    case '*':
+      readChar();
+      token = Token::MUL;
+      break;
+    case '/':
+      readChar();
+      token = Token::DIV;
+      break;
     case '=':
       readChar();
       token = Token::EQ;
@@ -450,6 +501,9 @@ class Lexer : public hexlex::LexerBase<Token> {
       if (readChar() == '=') {
         readChar();
         token = Token::LE;
+      } else if (lastChar == '<') {
+        readChar();
+        token = Token::LSH;
       } else {
         token = Token::LS;
       }
@@ -458,6 +512,9 @@ class Lexer : public hexlex::LexerBase<Token> {
       if (readChar() == '=') {
         readChar();
         token = Token::GE;
+      } else if (lastChar == '>') {
+        readChar();
+        token = Token::RSH;
       } else {
         token = Token::GR;
       }
@@ -702,6 +759,7 @@ public:
   virtual ValDecl *asValDecl() { return nullptr; }
   virtual CallStatement *asCallStatement() { return nullptr; }
   virtual SkipStatement *asSkipStatement() { return nullptr; }
+  virtual SeqStatement *asSeqStatement() { return nullptr; }
   virtual ParStatement *asParStatement() { return nullptr; }
   const Location &getLocation() const { return location; }
   void replaceExpr(std::unique_ptr<Expr> &expr, AstVisitor *visitor) {
@@ -1105,6 +1163,7 @@ class SeqStatement : public Statement {
 public:
   SeqStatement(Location location, std::vector<std::unique_ptr<Statement>> stmts)
       : Statement(location), stmts(std::move(stmts)) {}
+  SeqStatement *asSeqStatement() override { return this; }
   virtual void accept(AstVisitor *visitor) override {
     visitor->visitPre(*this);
     for (auto &stmt : stmts) {
@@ -1112,6 +1171,7 @@ public:
     }
     visitor->visitPost(*this);
   }
+  const std::vector<std::unique_ptr<Statement>> &getStmts() { return stmts; }
 };
 
 class CallStatement : public Statement {
@@ -1171,14 +1231,17 @@ public:
   std::vector<std::unique_ptr<Statement>> &getBranches() { return branches; }
 };
 
+/// Channel output of a value, or of a block of count array elements starting
+/// at the value, which is then an array subscript.
 class OutStatement : public Statement {
-  std::unique_ptr<Expr> channel, value;
+  std::unique_ptr<Expr> channel, value, count;
 
 public:
   OutStatement(Location location, std::unique_ptr<Expr> channel,
-               std::unique_ptr<Expr> value)
+               std::unique_ptr<Expr> value,
+               std::unique_ptr<Expr> count = nullptr)
       : Statement(location), channel(std::move(channel)),
-        value(std::move(value)) {}
+        value(std::move(value)), count(std::move(count)) {}
   virtual void accept(AstVisitor *visitor) override {
     visitor->visitPre(*this);
     if (visitor->shouldRecurseStmts()) {
@@ -1186,21 +1249,30 @@ public:
       replaceExpr(channel, visitor);
       value->accept(visitor);
       replaceExpr(value, visitor);
+      if (count) {
+        count->accept(visitor);
+        replaceExpr(count, visitor);
+      }
     }
     visitor->visitPost(*this);
   }
+  bool isBlock() const { return count != nullptr; }
   const std::unique_ptr<Expr> &getChannel() { return channel; }
   const std::unique_ptr<Expr> &getValue() { return value; }
+  const std::unique_ptr<Expr> &getCount() { return count; }
 };
 
+/// Channel input to a target, or to a block of count array elements starting
+/// at the target.
 class InStatement : public Statement {
-  std::unique_ptr<Expr> channel, target;
+  std::unique_ptr<Expr> channel, target, count;
 
 public:
   InStatement(Location location, std::unique_ptr<Expr> channel,
-              std::unique_ptr<Expr> target)
+              std::unique_ptr<Expr> target,
+              std::unique_ptr<Expr> count = nullptr)
       : Statement(location), channel(std::move(channel)),
-        target(std::move(target)) {}
+        target(std::move(target)), count(std::move(count)) {}
   virtual void accept(AstVisitor *visitor) override {
     visitor->visitPre(*this);
     if (visitor->shouldRecurseStmts()) {
@@ -1208,11 +1280,17 @@ public:
       replaceExpr(channel, visitor);
       target->accept(visitor);
       replaceExpr(target, visitor);
+      if (count) {
+        count->accept(visitor);
+        replaceExpr(count, visitor);
+      }
     }
     visitor->visitPost(*this);
   }
+  bool isBlock() const { return count != nullptr; }
   const std::unique_ptr<Expr> &getChannel() { return channel; }
   const std::unique_ptr<Expr> &getTarget() { return target; }
+  const std::unique_ptr<Expr> &getCount() { return count; }
 };
 
 // Procedures and functions ================================================= //
@@ -1483,13 +1561,15 @@ public:
   void visitPost(ParStatement &stmt) override { indentCount--; };
   void visitPre(OutStatement &stmt) override {
     indent();
-    outs << fmt::format("outstmt{}\n", locString(stmt));
+    outs << fmt::format("outstmt{}{}\n", stmt.isBlock() ? " block" : "",
+                        locString(stmt));
     indentCount++;
   };
   void visitPost(OutStatement &stmt) override { indentCount--; };
   void visitPre(InStatement &stmt) override {
     indent();
-    outs << fmt::format("instmt{}\n", locString(stmt));
+    outs << fmt::format("instmt{}{}\n", stmt.isBlock() ? " block" : "",
+                        locString(stmt));
     indentCount++;
   };
   void visitPost(InStatement &stmt) override { indentCount--; };
@@ -1524,7 +1604,9 @@ class Parser {
 
   /// Associative operators can be chained (eg a + b + c + d).
   bool isAssociative(Token op) const {
-    return op == Token::AND || op == Token::OR || op == Token::PLUS;
+    return op == Token::AND || op == Token::OR || op == Token::PLUS ||
+           op == Token::MUL || op == Token::BITAND || op == Token::BITOR ||
+           op == Token::BITXOR;
   }
 
   /// There is no operator associativity, so chains of associative operators
@@ -1792,6 +1874,21 @@ class Parser {
     }
   }
 
+  /// Parse the optional word count of a block channel transfer, which starts
+  /// at the given array element. Returns nullptr for a single word transfer.
+  std::unique_ptr<Expr> parseBlockCount(const std::unique_ptr<Expr> &start) {
+    if (lexer.getLastToken() != Token::FOR) {
+      return nullptr;
+    }
+    if (!start->asArraySubscriptExpr()) {
+      throw ParserTokenError(start->getLocation(),
+                             "block transfer must start at an array element",
+                             lexer.getLastToken());
+    }
+    lexer.getNextToken();
+    return parseExpr();
+  }
+
   /// statements :=
   ///   [1 <stmt> "," ]
   std::vector<std::unique_ptr<Statement>> parseStatements() {
@@ -1814,6 +1911,8 @@ class Parser {
   ///   <identifier> ":=" <expr>
   ///   <identifier> "(" <expr-list> ")"
   ///   <number> "(" [ <expr-list> ")"
+  ///   <identifier> "!" <expr> [ "for" <expr> ]
+  ///   <identifier> "?" <element> [ "for" <expr> ]
   std::unique_ptr<Statement> parseStatement() {
     auto location = lexer.getLocation();
     switch (lexer.getLastToken()) {
@@ -1876,17 +1975,23 @@ class Parser {
             static_cast<CallExpr *>(element.release()));
         return std::make_unique<CallStatement>(location, std::move(callExpr));
       }
-      // Channel output: <channel> "!" <expr>
+      // Channel output: <channel> "!" <expr> [ "for" <expr> ]
       if (lexer.getLastToken() == Token::PLING) {
         lexer.getNextToken();
+        auto value = parseExpr();
+        auto count = parseBlockCount(value);
         return std::make_unique<OutStatement>(location, std::move(element),
-                                              parseExpr());
+                                              std::move(value),
+                                              std::move(count));
       }
-      // Channel input: <channel> "?" <element>
+      // Channel input: <channel> "?" <element> [ "for" <expr> ]
       if (lexer.getLastToken() == Token::QUERY) {
         lexer.getNextToken();
+        auto target = parseElement();
+        auto count = parseBlockCount(target);
         return std::make_unique<InStatement>(location, std::move(element),
-                                             parseElement());
+                                             std::move(target),
+                                             std::move(count));
       }
       // Assignment
       expect(Token::ASS);
@@ -2187,6 +2292,28 @@ public:
       case Token::OR:
         result = LHS->getValue() != 0 ? 1 : (RHS->getValue() == 0 ? 0 : 1);
         break;
+      case Token::MUL:
+        result = static_cast<uint32_t>(LHS->getValue()) *
+                 static_cast<uint32_t>(RHS->getValue());
+        break;
+      case Token::DIV:
+        result = hex::oprDiv(LHS->getValue(), RHS->getValue());
+        break;
+      case Token::LSH:
+        result = hex::oprLsh(LHS->getValue(), RHS->getValue());
+        break;
+      case Token::RSH:
+        result = hex::oprRsh(LHS->getValue(), RHS->getValue());
+        break;
+      case Token::BITAND:
+        result = LHS->getValue() & RHS->getValue();
+        break;
+      case Token::BITOR:
+        result = LHS->getValue() | RHS->getValue();
+        break;
+      case Token::BITXOR:
+        result = LHS->getValue() ^ RHS->getValue();
+        break;
       default:
         throw SemanticTokenError(expr.getLocation(), "unexpected binary op",
                                  expr.getOp());
@@ -2385,10 +2512,32 @@ class CodeBuffer {
   size_t stringCount;
   size_t labelCount;
   Frame *currentFrame;
+  bool extendedOprs;
+  bool spIndexed;
+  Location location;
+
+  /// Add a generated instruction, attributed to the current location.
+  void addInstr(std::unique_ptr<hexasm::Directive> instr) {
+    instr->setLocation(location);
+    instrs.push_back(std::move(instr));
+  }
 
 public:
-  CodeBuffer(SymbolTable &symbolTable)
-      : symbolTable(symbolTable), constCount(0), stringCount(0), labelCount(0) {
+  CodeBuffer(SymbolTable &symbolTable, bool extendedOprs = false,
+             bool spIndexed = false)
+      : symbolTable(symbolTable), constCount(0), stringCount(0), labelCount(0),
+        extendedOprs(extendedOprs), spIndexed(spIndexed) {}
+
+  /// Return true if the target supports the extended OPR instructions.
+  bool hasExtendedOprs() const { return extendedOprs; }
+
+  /// Return true if the target supports the SP-indexed SPI instructions.
+  bool hasSpIndexed() const { return spIndexed; }
+
+  /// Attribute the instructions generated from now on to a source location,
+  /// returning the previous one.
+  Location setLocation(Location value) {
+    return std::exchange(location, value);
   }
 
   const std::string getLabel() {
@@ -2410,120 +2559,137 @@ public:
         std::make_unique<hexasm::Label>(hexasm::Token::IDENTIFIER, name));
   }
   void genInstrData(uint32_t value) {
-    instrs.push_back(
-        std::make_unique<hexasm::Data>(hexasm::Token::DATA, value));
+    addInstr(std::make_unique<hexasm::Data>(hexasm::Token::DATA, value));
   }
   void genLabel(std::string name) {
-    instrs.push_back(
-        std::make_unique<hexasm::Label>(hexasm::Token::IDENTIFIER, name));
+    addInstr(std::make_unique<hexasm::Label>(hexasm::Token::IDENTIFIER, name));
   }
   void genFunc(std::string name) {
-    instrs.push_back(std::make_unique<hexasm::Func>(hexasm::Token::FUNC, name));
+    addInstr(std::make_unique<hexasm::Func>(hexasm::Token::FUNC, name));
   }
   void genProc(std::string name) {
-    instrs.push_back(std::make_unique<hexasm::Proc>(hexasm::Token::PROC, name));
+    addInstr(std::make_unique<hexasm::Proc>(hexasm::Token::PROC, name));
   }
 
   /// Instruction generation -----------------------------------------------///
   void genLDAM(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAM, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAM, value));
   }
   void genLDBM(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBM, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBM, value));
   }
   void genSTAM(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::STAM, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::STAM, value));
   }
   void genLDAM(std::string label) {
-    instrs.push_back(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDAM,
-                                                          label, false));
+    addInstr(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDAM,
+                                                  label, false));
   }
   void genLDBM(std::string label) {
-    instrs.push_back(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDBM,
-                                                          label, false));
+    addInstr(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDBM,
+                                                  label, false));
   }
   void genSTAM(std::string label) {
-    instrs.push_back(std::make_unique<hexasm::InstrLabel>(hexasm::Token::STAM,
-                                                          label, false));
+    addInstr(std::make_unique<hexasm::InstrLabel>(hexasm::Token::STAM,
+                                                  label, false));
   }
   void genLDAC(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAC, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAC, value));
   }
   void genLDBC(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBC, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBC, value));
   }
   void genLDAP(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAP, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAP, value));
   }
   void genLDAC(std::string label) {
-    instrs.push_back(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDAC,
-                                                          label, false));
+    addInstr(std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDAC,
+                                                  label, false));
   }
   void genLDBC(std::string label) {
-    instrs.push_back(
+    addInstr(
         std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDBC, label, true));
   }
   void genLDAP(std::string label) {
-    instrs.push_back(
+    addInstr(
         std::make_unique<hexasm::InstrLabel>(hexasm::Token::LDAP, label, true));
   }
   void genLDAI(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAI, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDAI, value));
   }
   void genLDBI(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBI, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::LDBI, value));
   }
   void genSTAI(int value) {
-    instrs.push_back(
-        std::make_unique<hexasm::InstrImm>(hexasm::Token::STAI, value));
+    addInstr(std::make_unique<hexasm::InstrImm>(hexasm::Token::STAI, value));
   }
   void genBR(std::string label) {
-    instrs.push_back(
+    addInstr(
         std::make_unique<hexasm::InstrLabel>(hexasm::Token::BR, label, true));
   }
   void genBRZ(std::string label) {
-    instrs.push_back(
+    addInstr(
         std::make_unique<hexasm::InstrLabel>(hexasm::Token::BRZ, label, true));
   }
   void genBRN(std::string label) {
-    instrs.push_back(
+    addInstr(
         std::make_unique<hexasm::InstrLabel>(hexasm::Token::BRN, label, true));
   }
   void genOPR(hexasm::Token op) {
-    instrs.push_back(std::make_unique<hexasm::InstrOp>(hexasm::Token::OPR, op));
+    addInstr(std::make_unique<hexasm::InstrOp>(hexasm::Token::OPR, op));
   }
 
   /// Intermediate instruction for placeholder SP value --------------------///
-  void genSPValue() { instrs.push_back(std::make_unique<SPValue>()); }
+  void genSPValue() { addInstr(std::make_unique<SPValue>()); }
 
   /// Intermediate instructions for procedure calling ----------------------///
   void genPrologue(Symbol *symbol) {
-    instrs.push_back(std::make_unique<Prologue>(symbol));
+    addInstr(std::make_unique<Prologue>(symbol));
   }
   void genEpilogue(Symbol *symbol) {
-    instrs.push_back(std::make_unique<Epilogue>(symbol));
+    addInstr(std::make_unique<Epilogue>(symbol));
+  }
+
+  /// SP-relative accesses, as a single SPI instruction if supported or by
+  /// first loading the SP from memory otherwise -------------------------///
+  void genLDAS(int offset) {
+    if (spIndexed) {
+      addInstr(std::make_unique<hexasm::InstrSpi>(hexasm::Token::LDAS, offset));
+    } else {
+      genLDAM(SP_OFFSET);
+      genLDAI(offset);
+    }
+  }
+  void genLDBS(int offset) {
+    if (spIndexed) {
+      addInstr(std::make_unique<hexasm::InstrSpi>(hexasm::Token::LDBS, offset));
+    } else {
+      genLDBM(SP_OFFSET);
+      genLDBI(offset);
+    }
+  }
+  void genSTAS(int offset) {
+    if (spIndexed) {
+      addInstr(std::make_unique<hexasm::InstrSpi>(hexasm::Token::STAS, offset));
+    } else {
+      genLDBM(SP_OFFSET);
+      genSTAI(offset);
+    }
   }
 
-  /// Intermediate instructions for frame-base relative accesses -----------///
+  /// Intermediate instructions for frame-base relative accesses, lowered to
+  /// SP-relative accesses once the frame size is known -----------------///
   void genLDAI_FB(Frame *frame, int offset) {
-    instrs.push_back(std::make_unique<InstrStackOffset>(hexasm::Token::LDAI_FB,
-                                                        frame, offset));
+    addInstr(std::make_unique<InstrStackOffset>(hexasm::Token::LDAI_FB,
+                                                frame, offset));
   }
   void genLDBI_FB(Frame *frame, int offset) {
-    instrs.push_back(std::make_unique<InstrStackOffset>(hexasm::Token::LDBI_FB,
-                                                        frame, offset));
+    addInstr(std::make_unique<InstrStackOffset>(hexasm::Token::LDBI_FB,
+                                                frame, offset));
   }
   void genSTAI_FB(Frame *frame, int offset) {
-    instrs.push_back(std::make_unique<InstrStackOffset>(hexasm::Token::STAI_FB,
-                                                        frame, offset));
+    addInstr(std::make_unique<InstrStackOffset>(hexasm::Token::STAI_FB,
+                                                frame, offset));
   }
 
   /// Helpers --------------------------------------------------------------///
@@ -2534,6 +2700,36 @@ public:
   void genIN() { genOPR(hexasm::Token::IN); }
   void genOUT() { genOPR(hexasm::Token::OUT); }
 
+  /// Generate the extended OPR instruction for a binary operator.
+  void genExtendedOp(Token op) {
+    switch (op) {
+    case Token::MUL:
+      genOPR(hexasm::Token::MUL);
+      break;
+    case Token::DIV:
+      genOPR(hexasm::Token::DIV);
+      break;
+    case Token::LSH:
+      genOPR(hexasm::Token::LSH);
+      break;
+    case Token::RSH:
+      genOPR(hexasm::Token::RSH);
+      break;
+    case Token::BITAND:
+      genOPR(hexasm::Token::AND);
+      break;
+    case Token::BITOR:
+      genOPR(hexasm::Token::OR);
+      break;
+    case Token::BITXOR:
+      genOPR(hexasm::Token::XOR);
+      break;
+    default:
+      assert(0 && "unexpected token in extended op codegen");
+      break;
+    }
+  }
+
   /// Code generation visitors ---------------------------------------------///
 
   class ContainsCall : public AstVisitor {
@@ -2561,7 +2757,7 @@ public:
       return !(expr->isConst() || expr->asStringExpr() || expr->asVarRefExpr());
     }
     void genBinopOperands(BinaryOpExpr &expr) {
-      // For ADD and SUB binary operations:
+      // For arithmetic and bitwise binary operations:
       //  - LHS materialise in areg.
       //  - RHS materialise in breg.
       // NOTE: this does not respect left-to-right ordering of operations.
@@ -2573,12 +2769,10 @@ public:
         cb.genExpr(expr.getRHS(), currentScope);
         auto offset = currentFrame->getOffset();
         currentFrame->incOffset(1);
-        cb.genLDBM(SP_OFFSET);
         cb.genSTAI_FB(currentFrame, -offset);
         // Gen LHS.
         cb.genExpr(expr.getLHS(), currentScope);
         // Restore RHS from stack into breg.
-        cb.genLDBM(SP_OFFSET);
         cb.genLDBI_FB(currentFrame, -offset);
         currentFrame->setOffset(stackOffset);
       } else {
@@ -2600,6 +2794,19 @@ public:
           genBinopOperands(expr);
           cb.genSUB();
           break;
+        case Token::MUL:
+        case Token::DIV:
+        case Token::LSH:
+        case Token::RSH:
+        case Token::BITAND:
+        case Token::BITOR:
+        case Token::BITXOR:
+          if (!cb.hasExtendedOprs()) {
+            throw ExtendedOpError(expr.getLocation(), expr.getOp());
+          }
+          genBinopOperands(expr);
+          cb.genExtendedOp(expr.getOp());
+          break;
         case Token::AND: {
           // Logical AND of operands. If first operand is false, result is
           // false, otherwise the result is the value of the second operand.
@@ -2846,7 +3053,6 @@ public:
           cb.genSTAM(symbol->getGlobalLabel());
         } else {
           // Local scope.
-          cb.genLDBM(SP_OFFSET);
           cb.genSTAI_FB(cb.getCurrentFrame(), symbol->getStackOffset());
         }
       } else if (auto *arraySubLHS = expr.getLHS()->asArraySubscriptExpr()) {
@@ -2860,12 +3066,10 @@ public:
         cb.genADD();
         auto stackOffset = cb.getCurrentFrame()->getOffset();
         cb.getCurrentFrame()->incOffset(1);
-        cb.genLDBM(SP_OFFSET);
         cb.genSTAI_FB(cb.getCurrentFrame(), -stackOffset);
         // Generate the RHS expression.
         cb.genExpr(expr.getRHS(), currentScope);
         // Load the array address into breg.
-        cb.genLDBM(SP_OFFSET);
         cb.genLDBI_FB(cb.getCurrentFrame(), -stackOffset);
         // Save areg into mem[breg].
         cb.genSTAI(0);
@@ -2876,6 +3080,12 @@ public:
     }
 
     void visitPost(OutStatement &stmt) {
+      if (stmt.isBlock()) {
+        cb.genBlockTransfer(hexasm::Token::OUTN, stmt.getChannel(),
+                            *stmt.getValue()->asArraySubscriptExpr(),
+                            stmt.getCount(), currentScope);
+        return;
+      }
       // Channel output c ! e: materialise e in areg, the channel slot in breg,
       // then OPR OUT.
       cb.genExpr(stmt.getValue(), currentScope);
@@ -2884,6 +3094,12 @@ public:
     }
 
     void visitPost(InStatement &stmt) {
+      if (stmt.isBlock()) {
+        cb.genBlockTransfer(hexasm::Token::INN, stmt.getChannel(),
+                            *stmt.getTarget()->asArraySubscriptExpr(),
+                            stmt.getCount(), currentScope);
+        return;
+      }
       if (auto *varRef = stmt.getTarget()->asVarRefExpr()) {
         // Channel input c ? v: load the channel slot in breg, OPR IN leaves the
         // received word in areg, then store it to the target variable.
@@ -2894,7 +3110,6 @@ public:
         if (symbol->getScope().empty()) {
           cb.genSTAM(symbol->getGlobalLabel());
         } else {
-          cb.genLDBM(SP_OFFSET);
           cb.genSTAI_FB(cb.getCurrentFrame(), symbol->getStackOffset());
         }
       } else if (auto *arraySub = stmt.getTarget()->asArraySubscriptExpr()) {
@@ -2907,11 +3122,9 @@ public:
         cb.genADD();
         auto stackOffset = cb.getCurrentFrame()->getOffset();
         cb.getCurrentFrame()->incOffset(1);
-        cb.genLDBM(SP_OFFSET);
         cb.genSTAI_FB(cb.getCurrentFrame(), -stackOffset);
         cb.genExpr(stmt.getChannel(), currentScope, Reg::B);
         cb.genIN();
-        cb.genLDBM(SP_OFFSET);
         cb.genLDBI_FB(cb.getCurrentFrame(), -stackOffset);
         cb.genSTAI(0);
         cb.getCurrentFrame()->decOffset(1);
@@ -2933,11 +3146,21 @@ public:
     expr->accept(&visitor);
   }
 
-  /// Generate code for a statement using the StmtCodeGen visitor.
+  /// Generate code for a statement using the StmtCodeGen visitor, attributing
+  /// it to the statement's location, or each statement of a sequence to its
+  /// own.
   void genStmt(const std::unique_ptr<Statement> &stmt,
                const std::string &currentScope) {
+    if (auto *seq = stmt->asSeqStatement()) {
+      for (auto &child : seq->getStmts()) {
+        genStmt(child, currentScope);
+      }
+      return;
+    }
+    auto outer = setLocation(stmt->getLocation());
     StmtCodeGen visitor(symbolTable, *this, currentScope);
     stmt->accept(&visitor);
+    setLocation(outer);
   }
 
   /// Return true if the expression contains a call.
@@ -3006,6 +3229,10 @@ public:
         packedWord = 0;
       }
     }
+    // An empty string still needs its length word.
+    if (value.empty()) {
+      genData(packedWord);
+    }
     // Load the address of the string.
     switch (reg) {
     case Reg::A:
@@ -3033,11 +3260,9 @@ public:
       // Load from stack.
       switch (reg) {
       case Reg::A:
-        genLDAM(SP_OFFSET);
         genLDAI_FB(symbol->getFrame(), symbol->getStackOffset());
         break;
       case Reg::B:
-        genLDBM(SP_OFFSET);
         genLDBI_FB(symbol->getFrame(), symbol->getStackOffset());
         break;
       }
@@ -3055,7 +3280,6 @@ public:
         // be written directly into the parameter slots until all calls have
         // been resolved.
         genExpr(arg.get(), currentScope);
-        genLDBM(SP_OFFSET);
         genSTAI_FB(currentFrame, -currentFrame->getOffset());
         currentFrame->incOffset(1);
       }
@@ -3073,17 +3297,14 @@ public:
         // For each actual expression containing one or more calls, load the
         // expression value saved to a temporary stack location and store it
         // to the actual parameter location.
-        genLDAM(SP_OFFSET);
         genLDAI_FB(currentFrame, -currentFrame->getOffset());
         currentFrame->incOffset(1);
-        genLDBM(SP_OFFSET);
-        genSTAI(parameterIndex);
+        genSTAS(parameterIndex);
       } else {
         // For all other actual expressions, generate the value and store it to
         // the actual parameter location.
         genExpr(arg.get(), currentScope);
-        genLDBM(SP_OFFSET);
-        genSTAI(parameterIndex);
+        genSTAS(parameterIndex);
       }
       parameterIndex++;
     }
@@ -3100,8 +3321,54 @@ public:
     genLDAC(syscallId);
     genOPR(hexasm::Token::SVC);
     // Load any return value into areg.
-    genLDAM(SP_OFFSET);
-    genLDAI(SP_RETURN_VALUE_OFFSET);
+    genLDAS(SP_RETURN_VALUE_OFFSET);
+    currentFrame->setOffset(stackOffset);
+  }
+
+  /// Generate a block channel transfer c ! a[i] for n (OUTN) or c ? a[i] for
+  /// n (INN). The block address and word count are passed like syscall
+  /// arguments and the channel slot in breg.
+  void genBlockTransfer(hexasm::Token op, const std::unique_ptr<Expr> &channel,
+                        ArraySubscriptExpr &start,
+                        const std::unique_ptr<Expr> &count,
+                        const std::string &currentScope) {
+    auto stackOffset = currentFrame->getOffset();
+    auto *array = symbolTable.lookup(
+        std::make_pair(currentScope, start.getName()), start.getLocation());
+    auto genAddress = [&]() {
+      if (start.getExpr()->isConstZero()) {
+        genVar(Reg::A, array);
+        return;
+      }
+      genExpr(start.getExpr(), currentScope);
+      genVar(Reg::B, array);
+      genADD();
+    };
+    if (containsCall(start.getExpr()) || containsCall(count)) {
+      // Evaluate both arguments to temporaries before writing either
+      // argument slot, since a call would overwrite them.
+      genAddress();
+      genSTAI_FB(currentFrame, -currentFrame->getOffset());
+      currentFrame->incOffset(1);
+      genExpr(count.get(), currentScope);
+      genSTAI_FB(currentFrame, -currentFrame->getOffset());
+      currentFrame->incOffset(1);
+      currentFrame->setOffset(stackOffset);
+      genLDAI_FB(currentFrame, -currentFrame->getOffset());
+      currentFrame->incOffset(1);
+      genSTAS(FB_PARAM_OFFSET_FUNC);
+      genLDAI_FB(currentFrame, -currentFrame->getOffset());
+      currentFrame->incOffset(1);
+      genSTAS(FB_PARAM_OFFSET_FUNC + 1);
+    } else {
+      genAddress();
+      genSTAS(FB_PARAM_OFFSET_FUNC);
+      genExpr(count.get(), currentScope);
+      genSTAS(FB_PARAM_OFFSET_FUNC + 1);
+    }
+    currentFrame->incOffset(2 + FB_PARAM_OFFSET_FUNC);
+    genExpr(channel.get(), currentScope, Reg::B);
+    genOPR(op);
     currentFrame->setOffset(stackOffset);
   }
 
@@ -3119,8 +3386,7 @@ public:
     genBR(name);
     genLabel(linkLabel);
     // Load the result of the function call into areg.
-    genLDAM(SP_OFFSET);
-    genLDAI(SP_RETURN_VALUE_OFFSET);
+    genLDAS(SP_RETURN_VALUE_OFFSET);
     currentFrame->setOffset(stackOffset);
   }
 
@@ -3238,9 +3504,10 @@ class CodeGen : public AstVisitor {
   size_t globalsOffset;
 
 public:
-  CodeGen(SymbolTable &symbolTable)
-      : AstVisitor(false, false, false), st(symbolTable), cb(symbolTable),
-        globalsOffset(0) {}
+  CodeGen(SymbolTable &symbolTable, bool extendedOprs = false,
+          bool spIndexed = false)
+      : AstVisitor(false, false, false), st(symbolTable),
+        cb(symbolTable, extendedOprs, spIndexed), globalsOffset(0) {}
 
   void visitPre(Program &tree) {
     // Setup.
@@ -3276,6 +3543,7 @@ public:
     LocalDeclLocations localDeclLocations(st, proc.getName(), frame);
     proc.accept(&localDeclLocations);
     // Generate the prologue.
+    cb.setLocation(proc.getLocation());
     cb.genPrologue(symbol);
     // Generate the body.
     cb.genStmt(proc.getStatement(), proc.getName());
@@ -3285,6 +3553,7 @@ public:
   void visitPost(Proc &proc) {
     auto symbol = st.lookup(std::make_pair(getCurrentScope(), proc.getName()),
                             proc.getLocation());
+    cb.setLocation(proc.getLocation());
     cb.genEpilogue(symbol);
   }
 
@@ -3328,9 +3597,13 @@ class LowerDirectives {
   CodeBuffer cb;
 
 public:
-  LowerDirectives(SymbolTable &symbolTable, CodeGen &cg) : cb(symbolTable) {
+  LowerDirectives(SymbolTable &symbolTable, CodeGen &cg)
+      : cb(symbolTable, cg.getCodeBuffer().hasExtendedOprs(),
+           cg.getCodeBuffer().hasSpIndexed()) {
     // Lower intermediate instruction directives.
     for (auto &instr : cg.getCodeBuffer().getInstrs()) {
+      // Lowered directives keep the source location of the one they replace.
+      cb.setLocation(instr->getLocation());
       auto token = instr->getToken();
       switch (token) {
       case hexasm::Token::SP_VALUE: {
@@ -3414,13 +3687,13 @@ public:
             oldInstr->getFrame()->getSize() - 1 + oldInstr->getOffset();
         switch (token) {
         case hexasm::Token::LDAI_FB:
-          cb.genLDAI(newOffset);
+          cb.genLDAS(newOffset);
           break;
         case hexasm::Token::LDBI_FB:
-          cb.genLDBI(newOffset);
+          cb.genLDBS(newOffset);
           break;
         case hexasm::Token::STAI_FB:
-          cb.genSTAI(newOffset);
+          cb.genSTAS(newOffset);
           break;
         default:
           assert(0 &&
@@ -3496,6 +3769,18 @@ class OptimiseDirectives {
     return false;
   }
 
+  /// Match STAS <x>; LDAS <x>
+  bool matchSpStoreThenLoad(size_t index) {
+    if (instrs[index + 0]->getToken() == hexasm::Token::STAS &&
+        instrs[index + 1]->getToken() == hexasm::Token::LDAS) {
+      // The STAS/LDAS tokens guarantee the concrete type.
+      auto *inst0 = static_cast<hexasm::InstrSpi *>(instrs[index + 0].get());
+      auto *inst1 = static_cast<hexasm::InstrSpi *>(instrs[index + 1].get());
+      return inst0->getOffset() == inst1->getOffset();
+    }
+    return false;
+  }
+
 public:
   OptimiseDirectives(SymbolTable &symbolTable, CodeBuffer &previousCodeBuffer)
       : instrs(previousCodeBuffer.getInstrs()), cb(symbolTable) {
@@ -3509,6 +3794,10 @@ public:
         cb.insertInstr(std::move(instrs[i]));
         // Omit load.
         i += 1;
+      } else if (matchSpStoreThenLoad(i)) {
+        cb.insertInstr(std::move(instrs[i]));
+        // Omit load.
+        i += 1;
       } else if (matchIndexStoreThenLoad(i)) {
         cb.insertInstr(std::move(instrs[i]));
         cb.insertInstr(std::move(instrs[i + 1]));
@@ -3597,9 +3886,6 @@ public:
 
 namespace network {
 
-/// "HEXN" network-container magic. Must match hexsim::NETWORK_MAGIC.
-const uint32_t CONTAINER_MAGIC = 0x4E584548;
-
 /// A channel endpoint: the processor that touches a channel, the link slot it
 /// assigned to it, and how it uses it.
 struct Endpoint {
@@ -3609,9 +3895,11 @@ struct Endpoint {
   bool isReader;
 };
 
-/// A wiring edge connecting two processor link slots.
+/// A wiring edge connecting two processor link slots, and the name of the
+/// channel declaration it was built from.
 struct Edge {
   uint32_t procA, slotA, procB, slotB;
+  std::string name;
 };
 
 /// One processor in the network: the entry proc it runs and how many channels
@@ -3734,7 +4022,8 @@ inline Network analyseNetwork(Program &program, ParStatement &par) {
                                      "and one reader",
                                      name));
     }
-    net.edges.push_back({eps[0].proc, eps[0].slot, eps[1].proc, eps[1].slot});
+    net.edges.push_back(
+        {eps[0].proc, eps[0].slot, eps[1].proc, eps[1].slot, name});
   }
   return net;
 }
@@ -3760,6 +4049,12 @@ class Driver {
   Lexer lexer;
   Parser parser;
   std::ostream &outStream;
+  // Lower operators to the optional extended OPR instructions.
+  bool extendedOprs = false;
+  // Lower stack accesses to the optional SP-indexed SPI instructions.
+  bool spIndexed = false;
+  // Compress the code of the images in a network container.
+  bool compress = false;
 
   /// Read a whole file into a string.
   static std::string readFileToString(const std::string &filename) {
@@ -3800,7 +4095,7 @@ class Driver {
     tree->accept(&constProp);
     OptimiseExpr optimiseExpr;
     tree->accept(&optimiseExpr);
-    CodeGen codeGen(symbolTable);
+    CodeGen codeGen(symbolTable, extendedOprs, spIndexed);
     tree->accept(&codeGen);
     LowerDirectives lowerDirectives(symbolTable, codeGen);
     OptimiseDirectives optimiseDirectives(symbolTable,
@@ -3811,40 +4106,46 @@ class Driver {
     return out.str();
   }
 
-  /// Emit a network container: magic, processor count, edges, then each
-  /// processor's image (size-prefixed standard single-image binary).
+  /// Emit a network container of each processor's image, the edges, and the
+  /// channel name of each edge. A processor's image depends only on its entry
+  /// proc and channel count, so each distinct one is compiled once, and the
+  /// container stores it once.
   void emitNetworkContainer(const std::string &source,
                             const network::Network &net,
                             const std::string &filename) {
-    std::vector<std::string> images;
+    hexcontainer::Container container;
+    container.isNetwork = true;
+    container.compressed = compress;
+    std::map<std::pair<std::string, unsigned>, std::vector<char>> compiled;
     for (auto &proc : net.processors) {
-      images.push_back(compileProcessorImage(source, proc));
-    }
-    std::ofstream out(filename, std::ios::binary);
-    if (!out) {
-      throw std::runtime_error("could not open output file: " + filename);
+      auto key = std::make_pair(proc.entryProc, proc.numChannels);
+      auto it = compiled.find(key);
+      if (it == compiled.end()) {
+        auto image = compileProcessorImage(source, proc);
+        std::vector<char> bytes(image.begin(), image.end());
+        it = compiled.emplace(key, std::move(bytes)).first;
+      }
+      container.images.push_back(it->second);
     }
-    auto writeU32 = [&](uint32_t value) {
-      out.write(reinterpret_cast<const char *>(&value), sizeof(uint32_t));
-    };
-    writeU32(network::CONTAINER_MAGIC);
-    writeU32(static_cast<uint32_t>(images.size()));
-    writeU32(static_cast<uint32_t>(net.edges.size()));
     for (auto &e : net.edges) {
-      writeU32(e.procA);
-      writeU32(e.slotA);
-      writeU32(e.procB);
-      writeU32(e.slotB);
-    }
-    for (auto &image : images) {
-      writeU32(static_cast<uint32_t>(image.size()));
-      out.write(image.data(), image.size());
+      container.edges.push_back({e.procA, e.slotA, e.procB, e.slotB});
+      container.channelNames.push_back(e.name);
     }
+    hexcontainer::write(filename, container);
   }
 
 public:
   Driver(std::ostream &outStream) : parser(lexer), outStream(outStream) {}
 
+  /// Target the extended OPR instructions (MUL, DIV, shifts and bitwise ops).
+  void setExtendedOprs(bool value) { extendedOprs = value; }
+
+  /// Target the SP-indexed load and store instructions (LDAS, LDBS, STAS).
+  void setSpIndexed(bool value) { spIndexed = value; }
+
+  /// Compress the code of the images of an emitted network container.
+  void setCompress(bool value) { compress = value; }
+
   int run(DriverAction action, const std::string &input, bool inputIsFilename,
           const std::string outputBinaryFilename = "a.out",
           bool reportMemoryInfo = false) {
@@ -3904,7 +4205,7 @@ public:
     }
 
     // Perform code generation.
-    CodeGen codeGen(symbolTable);
+    CodeGen codeGen(symbolTable, extendedOprs, spIndexed);
     tree->accept(&codeGen);
 
     // Emit the generated intermediate instructions only.
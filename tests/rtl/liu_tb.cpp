@@ -8,6 +8,28 @@
 // One clock edge.
 static void tick(Vlink_interface *d) { d->i_clk = 0; d->eval(); d->i_clk = 1; d->eval(); }
 
+// Evaluate with a memory model serving the block-transfer data port.
+static void settle(Vlink_interface *d, uint32_t *mem) {
+    d->eval();
+    if (d->o_mem_valid) {
+        d->i_mem_data = mem[d->o_mem_addr];
+        d->eval();
+    }
+}
+
+// One clock edge, committing any memory write on the edge.
+static void tick_mem(Vlink_interface *d, uint32_t *mem) {
+    d->i_clk = 0;
+    settle(d, mem);
+    bool we = d->o_mem_valid && d->o_mem_we;
+    uint32_t addr = d->o_mem_addr;
+    uint32_t data = d->o_mem_data;
+    d->i_clk = 1;
+    d->eval();
+    if (we) mem[addr] = data;
+    settle(d, mem);
+}
+
 int main() {
     Vlink_interface *d = new Vlink_interface;
 
@@ -22,8 +44,12 @@ int main() {
         d->i_core_id       = 0;
         d->i_op_out        = 0;
         d->i_op_in         = 0;
+        d->i_op_outn       = 0;
+        d->i_op_inn        = 0;
         d->i_slot          = 0;
         d->i_areg          = 0;
+        d->i_sp_data       = 0;
+        d->i_mem_data      = 0;
         d->i_cfg_we        = 0;
         d->i_dnet_in_ready = 0;
         d->i_dnet_valid    = 0;
@@ -177,6 +203,121 @@ int main() {
         printf("Test 3 (per-slot independence): PASS\n");
     }
 
+    // -----------------------------------------------------------------------
+    // Test 4: OUTN — read the block arguments from the stack, stream a
+    // two-word block and complete on the final ACK.
+    // Config: slot 0 -> (dst_core=2, dst_slot=1)
+    // -----------------------------------------------------------------------
+    {
+        uint32_t mem[32] = {0};
+        mem[6] = 8;     // mem[SP+2]: block address.
+        mem[7] = 2;     // mem[SP+3]: word count.
+        mem[8] = 0x11;
+        mem[9] = 0x22;
+
+        // Fresh reset.
+        d->i_rst           = 1;
+        d->i_op_in         = 0;
+        d->i_dnet_valid    = 0;
+        d->i_anet_valid    = 0;
+        d->i_anet_in_ready = 0;
+        tick(d); tick(d);
+        d->i_rst = 0;
+
+        d->i_cfg_we        = 1;
+        d->i_cfg_slot      = 0;
+        d->i_cfg_dst_core  = 2;
+        d->i_cfg_dst_slot  = 1;
+        tick(d);
+        d->i_cfg_we = 0;
+
+        d->i_op_outn       = 1;
+        d->i_slot          = 0;
+        d->i_sp_data       = 4;
+        d->i_dnet_in_ready = 1;
+        tick_mem(d, mem);  // IDLE->BLK_ADDR
+        tick_mem(d, mem);  // BLK_ADDR->BLK_COUNT
+        tick_mem(d, mem);  // BLK_COUNT->BOUT_SEND
+
+        assert(d->o_dnet_valid && "Test4: first word should be sent");
+        assert(flit_dst_slot(d->o_dnet_flit) == 1 && "Test4: dst_slot should be 1");
+        assert(flit_word(d->o_dnet_flit) == 0x11 && "Test4: first word should be 0x11");
+        tick_mem(d, mem);  // BOUT_SEND->BOUT_WAIT
+        assert(!d->o_dnet_valid && "Test4: wait for the first ACK");
+
+        d->i_anet_valid = 1;
+        settle(d, mem);
+        assert(!d->o_done && "Test4: not done after the first ACK");
+        tick_mem(d, mem);  // BOUT_WAIT->BOUT_SEND
+        d->i_anet_valid = 0;
+        settle(d, mem);
+        assert(d->o_busy && "Test4: busy while streaming");
+        assert(flit_word(d->o_dnet_flit) == 0x22 && "Test4: second word should be 0x22");
+        tick_mem(d, mem);  // BOUT_SEND->BOUT_WAIT
+
+        d->i_anet_valid = 1;
+        settle(d, mem);
+        assert(d->o_done  && "Test4: o_done on the final ACK");
+        assert(!d->o_busy && "Test4: o_busy should drop with o_done");
+        tick_mem(d, mem);  // BOUT_WAIT->IDLE
+        d->i_anet_valid    = 0;
+        d->i_op_outn       = 0;
+        d->i_dnet_in_ready = 0;
+        printf("Test 4 (OUTN block stream + ACKs): PASS\n");
+    }
+
+    // -----------------------------------------------------------------------
+    // Test 5: INN — write a two-word block into memory, ACKing the first and
+    // last words.
+    // -----------------------------------------------------------------------
+    {
+        uint32_t mem[32] = {0};
+        mem[6] = 16;    // mem[SP+2]: block address.
+        mem[7] = 2;     // mem[SP+3]: word count.
+
+        // Fresh reset.
+        d->i_rst = 1;
+        tick(d); tick(d);
+        d->i_rst = 0;
+
+        d->i_op_inn  = 1;
+        d->i_slot    = 3;
+        d->i_sp_data = 4;
+        d->i_dnet_valid = 1;
+        d->i_dnet_flit  = make_dnet_flit(/*dst_core=*/0, /*dst_slot=*/3,
+                                          /*src_core=*/1, /*word=*/0xA1);
+        tick_mem(d, mem);  // IDLE->BLK_ADDR, first word buffered
+        d->i_dnet_valid = 0;
+        tick_mem(d, mem);  // BLK_ADDR->BLK_COUNT
+        tick_mem(d, mem);  // BLK_COUNT->BIN_RECV
+
+        assert(d->o_mem_we && "Test5: first word should be written");
+        tick_mem(d, mem);  // BIN_RECV->BIN_ACK
+        assert(mem[16] == 0xA1 && "Test5: first word stored");
+        assert(d->o_anet_valid && d->o_anet_dst == 1 && "Test5: ACK the first word");
+        d->i_anet_in_ready = 1;
+        settle(d, mem);
+        assert(!d->o_done && "Test5: not done after the first word");
+        tick_mem(d, mem);  // BIN_ACK->BIN_RECV
+        d->i_anet_in_ready = 0;
+
+        d->i_dnet_valid = 1;
+        d->i_dnet_flit  = make_dnet_flit(/*dst_core=*/0, /*dst_slot=*/3,
+                                          /*src_core=*/1, /*word=*/0xA2);
+        tick_mem(d, mem);  // Second word buffered.
+        d->i_dnet_valid = 0;
+        tick_mem(d, mem);  // BIN_RECV->BIN_ACK
+        assert(mem[17] == 0xA2 && "Test5: second word stored");
+
+        d->i_anet_in_ready = 1;
+        settle(d, mem);
+        assert(d->o_done && "Test5: o_done on the final ACK");
+        tick_mem(d, mem);  // BIN_ACK->IDLE
+        d->i_anet_in_ready = 0;
+        d->i_op_inn        = 0;
+        printf("Test 5 (INN block receive + ACKs): PASS\n");
+    }
+
     printf("liu_tb PASS\n");
     delete d;
     return 0;
@@ -9,6 +9,8 @@ SIM_BINARY = os.path.join(defs.INSTALL_PREFIX, "hexsim")
 VTB_BINARY = os.path.join(defs.INSTALL_PREFIX, "hextb")
 CMP_BINARY = os.path.join(defs.INSTALL_PREFIX, "xcmp")
 RUN_BINARY = os.path.join(defs.INSTALL_PREFIX, "xrun")
+H2C_BINARY = os.path.join(defs.INSTALL_PREFIX, "hex2c")
+BENCH_BINARY = os.path.join(defs.INSTALL_PREFIX, "hexbench")
 
 
 class Tests(unittest.TestCase):
@@ -80,7 +82,7 @@ class Tests(unittest.TestCase):
             )
             self.assertTrue(
                 output.stdout.decode("utf-8")
-                == "tree size: 18631\nprogram size: 17101\nsize: 177105\n"
+                == "tree size: 18477\nprogram size: 16977\nsize: 176981\n"
             )
 
     def test_x_compiler_verilator(self):
@@ -92,7 +94,7 @@ class Tests(unittest.TestCase):
                 )
                 self.assertTrue(
                     output.stdout.decode("utf-8").endswith(
-                        "tree size: 18631\nprogram size: 17101\nsize: 177105\n"
+                        "tree size: 18477\nprogram size: 16977\nsize: 176981\n"
                     )
                 )
         else:
@@ -106,6 +108,12 @@ class Tests(unittest.TestCase):
         subprocess.run([CMP_BINARY, src, "-o", "net.bin"])
         sim = subprocess.run([SIM_BINARY, "net.bin"], capture_output=True)
         self.assertTrue(sim.stdout.decode("utf-8") == expected)
+        # Multiplexing the processors onto a pool of worker threads must give
+        # the same output.
+        sim = subprocess.run(
+            [SIM_BINARY, "--parallel", "net.bin"], capture_output=True
+        )
+        self.assertTrue(sim.stdout.decode("utf-8") == expected)
         if defs.USE_VERILATOR:
             tb = subprocess.run([VTB_BINARY, "net.bin"], capture_output=True)
             self.assertTrue(tb.stdout.decode("utf-8").endswith(expected))
@@ -143,6 +151,106 @@ class Tests(unittest.TestCase):
     def test_message_passing_horner(self):
         self.run_message_passing("horner.x", "26\n")
 
+    def test_message_passing_blockpipe(self):
+        self.run_message_passing("blockpipe.x", "72\n")
+
+    def test_hexbench_large_ring(self):
+        # Deadlock detection must not walk the whole chain of blocked
+        # processors each time one blocks: on a ring that is almost the whole
+        # network, which takes tens of seconds here rather than one.
+        bench = subprocess.run(
+            [
+                BENCH_BINARY,
+                "--topology",
+                "ring",
+                "--procs",
+                "16000",
+                "--messages",
+                "2",
+                "--csv",
+            ],
+            capture_output=True,
+            timeout=15,
+        )
+        self.assertEqual(bench.returncode, 0)
+        self.assertTrue(bench.stdout.decode("utf-8").startswith("topology,"))
+
+    def run_hex2c(self, filename, input_bytes=b"", cmp_args=()):
+        # Translate a compiled program to C++, build it natively and check it
+        # behaves exactly like the simulator.
+        src = os.path.join(defs.X_TEST_SRC_PREFIX, filename)
+        subprocess.run([CMP_BINARY, *cmp_args, src, "-o", "h2c.bin"])
+        subprocess.run([H2C_BINARY, "h2c.bin", "-o", "h2c.cpp"])
+        build = subprocess.run(
+            [
+                defs.CXX_COMPILER,
+                "-std=c++20",
+                "-O1",
+                "-I",
+                defs.SRC_PREFIX,
+                "h2c.cpp",
+                "-o",
+                "h2c",
+            ]
+        )
+        self.assertEqual(build.returncode, 0)
+        sim = subprocess.run(
+            [SIM_BINARY, "h2c.bin"], input=input_bytes, capture_output=True
+        )
+        native = subprocess.run(["./h2c"], input=input_bytes, capture_output=True)
+        self.assertEqual(native.stdout, sim.stdout)
+        self.assertEqual(native.returncode, sim.returncode)
+
+    def test_hex2c_sequential(self):
+        self.run_hex2c("fib.x", bytes([10]))
+        self.run_hex2c("bubblesort.x")
+
+    def test_hex2c_network(self):
+        self.run_hex2c("sieve.x")
+        self.run_hex2c("farm.x")
+        self.run_hex2c("blockpipe.x")
+
+    def test_hex2c_extended_opr(self):
+        self.run_hex2c("printn_ext.x", bytes([7]), ["--ext-opr"])
+
+    def test_x_extended_opr(self):
+        # The extended OPR instructions, compiled with xcmp --ext-opr.
+        src = os.path.join(defs.X_TEST_SRC_PREFIX, "printn_ext.x")
+        subprocess.run([CMP_BINARY, "--ext-opr", src, "-o", "ext.bin"])
+        sim = subprocess.run(
+            [SIM_BINARY, "ext.bin"], input=bytes([7]), capture_output=True
+        )
+        self.assertEqual(sim.stdout.decode("utf-8"), "343\n7340032\n")
+        if defs.USE_VERILATOR:
+            tb = subprocess.run(
+                [VTB_BINARY, "ext.bin"], input=bytes([7]), capture_output=True
+            )
+            self.assertTrue(tb.stdout.decode("utf-8").endswith("343\n7340032\n"))
+
+    def test_hex2c_sp_indexed(self):
+        self.run_hex2c("fib.x", bytes([10]), ["--ext-spi"])
+        self.run_hex2c("farm.x", b"", ["--ext-spi"])
+
+    def test_x_compiler_sp_indexed(self):
+        # Compile xhexb.x using the SP-indexed instructions, then use it to
+        # compile xhexb.x itself (matching the sizes reported by an xcmp build).
+        src = os.path.join(defs.X_TEST_SRC_PREFIX, "xhexb.x")
+        subprocess.run([CMP_BINARY, "--ext-spi", src, "-o", "xhexb_spi.bin"])
+        expected = "tree size: 18477\nprogram size: 16969\nsize: 176973\n"
+        with open(src, "rb") as infile:
+            output = subprocess.run(
+                [SIM_BINARY, "xhexb_spi.bin"], input=infile.read(), capture_output=True
+            )
+            self.assertTrue(output.stdout.decode("utf-8").endswith(expected))
+        if defs.USE_VERILATOR:
+            with open(src, "rb") as infile:
+                output = subprocess.run(
+                    [VTB_BINARY, "xhexb_spi.bin"],
+                    input=infile.read(),
+                    capture_output=True,
+                )
+                self.assertTrue(output.stdout.decode("utf-8").endswith(expected))
+
 
 if __name__ == "__main__":
     unittest.main()
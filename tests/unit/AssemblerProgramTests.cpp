@@ -33,10 +33,10 @@ TEST_CASE("Xhexb xhexb hello prints", "[asm_programs]") {
   ctx.runHexProgramFile(ctx.getAsmTestPath("xhexb.S"), xhexbContents);
   // Simulate the compiled program (compile xhexb using hexasm:xhexb.S binary).
   ctx.simXBinary("simout2", xhexbContents);
-  REQUIRE(ctx.simOutBuffer.str() == R"(error near line 3054: illegal character
-tree size: 18631
-program size: 17093
-size: 177097
+  REQUIRE(ctx.simOutBuffer.str() == R"(error near line 3030: illegal character
+tree size: 18477
+program size: 16969
+size: 176973
 )");
   // Simulate the compiled program (compile hello_prints using xhexb.S:xhexb.x
   // binary).
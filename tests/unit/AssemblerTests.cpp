@@ -81,6 +81,62 @@ TEST_CASE("Hello procedure run", "[asm_features]") {
   REQUIRE(ctx.simOutBuffer.str() == "hello\n");
 }
 
+/// Return the exit code of a program that applies an OPR to two constants.
+static int runOpr(TestContext &ctx, const std::string &opr, int a, int b) {
+  return ctx.runHexProgramSrc("BR start\n"
+                              "DATA 16383\n"
+                              "start\n"
+                              "LDAC " +
+                              std::to_string(a) +
+                              "\n"
+                              "LDBC " +
+                              std::to_string(b) + "\n" + "OPR " + opr +
+                              "\n"
+                              "LDBM 1\n"
+                              "STAI 2\n"
+                              "LDAC 0\n"
+                              "OPR SVC\n");
+}
+
+TEST_CASE("Extended opr run", "[asm_features]") {
+  TestContext ctx;
+  REQUIRE(runOpr(ctx, "MUL", 6, 7) == 42);
+  REQUIRE(runOpr(ctx, "MUL", -6, 7) == -42);
+  REQUIRE(runOpr(ctx, "DIV", 42, 5) == 8);
+  REQUIRE(runOpr(ctx, "DIV", -42, 5) == -8);
+  REQUIRE(runOpr(ctx, "DIV", 42, 0) == 0);
+  REQUIRE(runOpr(ctx, "LSH", 3, 4) == 48);
+  REQUIRE(runOpr(ctx, "LSH", 3, 32) == 0);
+  REQUIRE(runOpr(ctx, "RSH", 48, 4) == 3);
+  REQUIRE(runOpr(ctx, "RSH", -1, 28) == 15);
+  REQUIRE(runOpr(ctx, "AND", 12, 10) == 8);
+  REQUIRE(runOpr(ctx, "OR", 12, 10) == 14);
+  REQUIRE(runOpr(ctx, "XOR", 12, 10) == 6);
+}
+
+TEST_CASE("SP indexed run", "[asm_features]") {
+  TestContext ctx;
+  auto program = R"(BR start
+DATA 16383
+start
+LDAC 5
+STAS 3
+LDAC 9
+STAS -1
+LDAC 11
+STAS 20
+LDBS 3
+LDAS -1
+OPR ADD
+LDBS 20
+OPR ADD
+STAS 2
+LDAC 0
+OPR SVC
+)";
+  REQUIRE(ctx.runHexProgramSrc(program) == 25);
+}
+
 //===---------------------------------------------------------------------===//
 // Error handling.
 //===---------------------------------------------------------------------===//
@@ -79,6 +79,28 @@ TEST_CASE("Opr sub instructions", "[dis_features]") {
   REQUIRE(output.find("SVC") != std::string::npos);
 }
 
+TEST_CASE("Extended opr sub instructions", "[dis_features]") {
+  std::vector<uint8_t> program = {0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC};
+  hexdis::DebugInfo debugInfo;
+  std::ostringstream out;
+  hexdis::disassemble(program, out, debugInfo, false);
+  REQUIRE(out.str() == "  0x0000  d6  MUL\n  0x0001  d7  DIV\n"
+                       "  0x0002  d8  LSH\n  0x0003  d9  RSH\n"
+                       "  0x0004  da  AND\n  0x0005  db  OR\n"
+                       "  0x0006  dc  XOR\n");
+}
+
+TEST_CASE("SP indexed instructions", "[dis_features]") {
+  std::vector<uint8_t> program = {0xC0, 0xC5, 0xC6, 0xE1, 0xC0, 0xFF, 0xCE};
+  hexdis::DebugInfo debugInfo;
+  std::ostringstream out;
+  hexdis::disassemble(program, out, debugInfo, false);
+  REQUIRE(out.str() == "  0x0000  c0  LDAS 0\n  0x0001  c5  LDBS 1\n"
+                       "  0x0002  c6  STAS 1\n  0x0003  e1  PFIX 1\n"
+                       "  0x0004  c0  LDAS 4\n  0x0005  ff  NFIX 15\n"
+                       "  0x0006  ce  STAS -1\n");
+}
+
 TEST_CASE("In out opcodes", "[dis_features]") {
   std::vector<uint8_t> program = {0xD4, 0xD5};
   hexdis::DebugInfo debugInfo;
@@ -87,6 +109,14 @@ TEST_CASE("In out opcodes", "[dis_features]") {
   REQUIRE(out.str() == "  0x0000  d4  IN\n  0x0001  d5  OUT\n");
 }
 
+TEST_CASE("Block in out opcodes", "[dis_features]") {
+  std::vector<uint8_t> program = {0xDD, 0xDE};
+  hexdis::DebugInfo debugInfo;
+  std::ostringstream out;
+  hexdis::disassemble(program, out, debugInfo, false);
+  REQUIRE(out.str() == "  0x0000  dd  OUTN\n  0x0001  de  INN\n");
+}
+
 TEST_CASE("In out assemble roundtrip", "[dis_features]") {
   TestContext ctx;
   auto output = assembleAndDisassemble(ctx, "OPR IN\n"
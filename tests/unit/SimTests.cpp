@@ -127,6 +127,179 @@ TEST_CASE("Single image fallback", "[sim_features]") {
   REQUIRE(system.run() == 0);
 }
 
+TEST_CASE("Mapped container validation", "[sim_features]") {
+  // The images of a mapped container are views of the file, and a container
+  // that is truncated or wires a missing processor or slot is rejected.
+  auto sender = assembleToBytes(senderProgram(65), "sim_sender_map.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver_map.bin");
+  auto file =
+      writeContainer({sender, receiver}, {{0, 0, 1, 0}}, "sim_map.bin");
+  auto mapped = hexcontainer::map(file);
+  REQUIRE(mapped.isNetwork);
+  REQUIRE(mapped.version == 1);
+  REQUIRE(mapped.images.size() == 2);
+  REQUIRE(hexcontainer::joinImage(mapped.images[1]) == receiver);
+  auto read = hexcontainer::read(file);
+  REQUIRE(read.images == std::vector<std::vector<char>>{sender, receiver});
+  // Cut the file short inside the second image.
+  hexcontainer::MappedFile whole(file);
+  auto bytes = whole.bytes();
+  fs::path truncated(CURRENT_BINARY_DIRECTORY);
+  truncated /= "sim_map_truncated.bin";
+  std::ofstream(truncated.string(), std::ios::binary)
+      .write(bytes.data(), bytes.size() - 8);
+  REQUIRE_THROWS(hexcontainer::map(truncated.string()));
+  auto unwired =
+      writeContainer({sender, receiver}, {{0, 0, 2, 0}}, "sim_map_bad.bin");
+  std::istringstream in;
+  std::ostringstream out;
+  hexsim::System system(in, out);
+  REQUIRE_THROWS(system.loadNetwork(unwired.c_str()));
+  auto badSlot = writeContainer({sender, receiver}, {{0, 0, 1, 9}},
+                                "sim_map_slot.bin");
+  hexsim::System slotSystem(in, out);
+  REQUIRE_THROWS(slotSystem.loadNetwork(badSlot.c_str()));
+}
+
+TEST_CASE("Container version 2 shares images", "[sim_features]") {
+  // A container is written with a section table, storing each distinct image
+  // once with its code page-aligned, and reads back as the images it was
+  // written from.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(69), "sim_sender_v2.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver_v2.bin");
+  auto v1 = writeContainer({sender, receiver, receiver},
+                           {{0, 0, 1, 0}, {0, 1, 2, 0}}, "sim_v1.bin");
+  auto container = hexcontainer::read(v1);
+  fs::path v2(CURRENT_BINARY_DIRECTORY);
+  v2 /= "sim_v2.bin";
+  hexcontainer::write(v2.string(), container);
+  auto mapped = hexcontainer::map(v2.string());
+  REQUIRE(mapped.version == 2);
+  REQUIRE(mapped.numProcessors() == 3);
+  REQUIRE(mapped.images.size() == 2);
+  REQUIRE(mapped.imageOf == std::vector<uint32_t>{0, 1, 1});
+  for (const auto &image : mapped.images) {
+    auto offset = image.code.data() - mapped.file->bytes().data();
+    REQUIRE(offset % hexcontainer::CODE_ALIGN == 0);
+  }
+  auto readBack = hexcontainer::read(v2.string());
+  REQUIRE(readBack.images == container.images);
+  REQUIRE(readBack.edges.size() == 2);
+  REQUIRE(readBack.edges[1].procB == 2);
+}
+
+TEST_CASE("Compressed code round trip", "[sim_features]") {
+  // Zero runs, repeats, overlapping repeats and literals decompress to the
+  // bytes they were compressed from, and a damaged stream is rejected.
+  std::string bytes(4000, '\0');
+  for (size_t i = 0; i < 1000; i++) {
+    bytes[i] = static_cast<char>(i * 7 + i / 13);
+  }
+  bytes.replace(2000, 600, bytes.substr(100, 600));
+  bytes.replace(3000, 100, std::string(100, 'x'));
+  bytes += "tail";
+  for (auto input : {std::string(), std::string("abc"), bytes}) {
+    auto compressed = hexcompress::compress(input);
+    REQUIRE(hexcompress::uncompressedSize(compressed) == input.size());
+    REQUIRE(hexcompress::decompress(compressed) == input);
+  }
+  auto compressed = hexcompress::compress(bytes);
+  REQUIRE(compressed.size() < bytes.size() / 3);
+  std::string memory(bytes.size() - 1, '\0');
+  REQUIRE_THROWS(hexcompress::decompress(compressed, memory.data(),
+                                         memory.size()));
+  REQUIRE_THROWS(hexcompress::decompress(
+      compressed.substr(0, compressed.size() - 1)));
+  REQUIRE_THROWS(hexcompress::decompress(compressed + "x"));
+}
+
+TEST_CASE("Compressed container", "[sim_features]") {
+  // A container with compressed code reads back as the images it was written
+  // from, and its network runs.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(70), "sim_sender_cz.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver_cz.bin");
+  auto file =
+      writeContainer({sender, receiver}, {{0, 0, 1, 0}}, "sim_cz_v1.bin");
+  auto container = hexcontainer::read(file);
+  REQUIRE(!container.compressed);
+  container.compressed = true;
+  fs::path compressed(CURRENT_BINARY_DIRECTORY);
+  compressed /= "sim_cz.bin";
+  hexcontainer::write(compressed.string(), container);
+  auto mapped = hexcontainer::map(compressed.string());
+  REQUIRE(mapped.compressed);
+  REQUIRE(mapped.images[0].compressed);
+  auto readBack = hexcontainer::read(compressed.string());
+  REQUIRE(readBack.compressed);
+  REQUIRE(readBack.images == container.images);
+  std::istringstream in;
+  std::ostringstream out;
+  hexsim::System system(in, out);
+  system.loadNetwork(compressed.c_str());
+  REQUIRE(system.run() == 0);
+  REQUIRE(out.str() == "F");
+}
+
+TEST_CASE("Symbol index", "[sim_features]") {
+  // Symbols are indexed by offset with their names pooled, a PC is found in
+  // place, and a block written without the index is still read.
+  std::vector<heximage::Symbol> symbols = {
+      {"main", 8}, {"f", 40}, {"g", 20}, {"f", 60}};
+  auto block = heximage::encodeSymbols(symbols);
+  REQUIRE(block.size() == 12 + 4 * 8 + std::string("main f g ").size());
+  heximage::SymbolIndex index(block);
+  REQUIRE(index.size() == 4);
+  REQUIRE(index.name(1) == "g");
+  REQUIRE(index.offset(2) == 40);
+  REQUIRE(index.find(7) == -1);
+  REQUIRE(index.find(8) == 0);
+  REQUIRE(index.find(39) == 1);
+  REQUIRE(index.find(1000) == 3);
+  REQUIRE(index.name(index.find(61)) == "f");
+  std::ostringstream unindexed;
+  auto put = [&](uint32_t value) {
+    unindexed.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  put(2);
+  unindexed.write("a\0b\0", 4);
+  put(2);
+  put(1);
+  put(12);
+  put(0);
+  put(4);
+  auto read = heximage::readSymbols(unindexed.str());
+  REQUIRE(read.size() == 2);
+  REQUIRE(read[0].name == "a");
+  REQUIRE(read[1].name == "b");
+  REQUIRE(read[1].offset == 12);
+  // A truncated block holds the symbols before its end.
+  REQUIRE(heximage::SymbolIndex(block.substr(0, 12 + 2 * 8)).size() == 2);
+  REQUIRE(heximage::SymbolIndex(block.substr(0, 8)).empty());
+}
+
+TEST_CASE("Line table", "[sim_features]") {
+  // A line table follows the symbols of the debug-info block, delta-encoded,
+  // and a block without one has no lines.
+  std::vector<heximage::Line> lines = {
+      {14, 4}, {20, 5}, {44, 4}, {50, 7}, {300, 1000}, {302, 9}};
+  auto block = heximage::encodeSymbols({{"main", 14}});
+  REQUIRE(heximage::readLines(block).empty());
+  auto table = heximage::encodeLines(lines);
+  REQUIRE(table.size() == 12 + 4 * 2 + (2 + 2) + (1 + 2));
+  auto read = heximage::readLines(block + table);
+  REQUIRE(read.size() == lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    REQUIRE(read[i].offset == lines[i].offset);
+    REQUIRE(read[i].line == lines[i].line);
+  }
+  // The symbols are read as before, and a truncated table holds the lines
+  // before its end.
+  REQUIRE(heximage::readSymbols(block + table).size() == 1);
+  REQUIRE(heximage::readLines(block + table.substr(0, 12 + 5)).size() == 2);
+}
+
 TEST_CASE("Rendezvous writer first", "[sim_features]") {
   // Processor order means the writer (proc 0) is stepped before the reader.
   TestContext ctx;
@@ -155,6 +328,150 @@ TEST_CASE("Rendezvous reader first", "[sim_features]") {
   REQUIRE(out.str() == "B");
 }
 
+TEST_CASE("Network stats without channel names", "[sim_features]") {
+  // A container without the names section names its channels by index.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(67), "sim_sender3.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver3.bin");
+  auto file = writeContainer({sender, receiver}, {{0, 0, 1, 0}}, "sim_ns.bin");
+  std::istringstream in;
+  std::ostringstream out;
+  hexsim::System system(in, out);
+  system.setNetworkStats(true);
+  system.loadNetwork(file.c_str());
+  REQUIRE(system.run() == 0);
+  REQUIRE(out.str() == "C");
+  auto stats = system.getNetworkStats();
+  REQUIRE(stats.channels.size() == 1);
+  auto &c = stats.channels[0];
+  REQUIRE(c.name == "c0");
+  REQUIRE(c.messages == 1);
+  REQUIRE(c.words == 1);
+  REQUIRE(c.a.sent == 1);
+  REQUIRE(c.b.received == 1);
+  REQUIRE(c.writerWaitTicks + c.readerWaitTicks ==
+          stats.processors[0].blockedTicks + stats.processors[1].blockedTicks);
+  for (auto &p : stats.processors) {
+    REQUIRE(p.busyTicks + p.blockedTicks + p.haltedTicks == stats.ticks);
+  }
+}
+
+TEST_CASE("JSON reports escape names", "[sim_features]") {
+  // A channel name is escaped in the network statistics and the timeline,
+  // whatever characters it holds.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(68), "sim_sender_json.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver_json.bin");
+  auto v1 = writeContainer({sender, receiver}, {{0, 0, 1, 0}}, "sim_json1.bin");
+  auto container = hexcontainer::read(v1);
+  container.channelNames = {"a\"b\\c\n"};
+  fs::path file(CURRENT_BINARY_DIRECTORY);
+  file /= "sim_json2.bin";
+  hexcontainer::write(file.string(), container);
+  std::istringstream in;
+  std::ostringstream out;
+  hexsim::System system(in, out);
+  system.setNetworkStats(true);
+  system.setTimeline(true);
+  system.loadNetwork(file.c_str());
+  REQUIRE(system.run() == 0);
+  REQUIRE(system.getNetworkStats().channels[0].name == "a\"b\\c\n");
+  std::ostringstream json;
+  hexsim::writeNetworkStatsJson(json, system.getNetworkStats());
+  REQUIRE(json.str().find("\"name\": \"a\\\"b\\\\c\\n\"") !=
+          std::string::npos);
+  std::ostringstream timeline;
+  system.writeTimeline(timeline);
+  REQUIRE(timeline.str().find("\"name\": \"send a\\\"b\\\\c\\n\"") !=
+          std::string::npos);
+  REQUIRE(timeline.str().find("\"channel\": \"a\\\"b\\\\c\\n\"") !=
+          std::string::npos);
+}
+
+TEST_CASE("Placement hops and routes", "[sim_features]") {
+  auto mesh = hexplace::Topology::parse("4x4", false);
+  auto torus = hexplace::Topology::parse("4x4", true);
+  REQUIRE(mesh.hops(0, 15) == 6);
+  REQUIRE(torus.hops(0, 15) == 2);
+  REQUIRE(torus.hops(1, 13) == 1);
+  for (auto &t : {mesh, torus}) {
+    for (unsigned a = 0; a < t.size(); a++) {
+      for (unsigned b = 0; b < t.size(); b++) {
+        unsigned links = 0;
+        t.route(a, b, [&](unsigned) { links++; });
+        REQUIRE(links == t.hops(a, b));
+      }
+    }
+  }
+  // Across the wrap-around link, leaving node 0 in the -X direction.
+  std::vector<unsigned> route;
+  torus.route(0, 3, [&](unsigned link) { route.push_back(link); });
+  REQUIRE(route == std::vector<unsigned>{1});
+  REQUIRE_THROWS(hexplace::Topology::parse("4", false));
+}
+
+TEST_CASE("Placement optimiser", "[sim_features]") {
+  // A four-stage pipeline placed in the corners of a mesh.
+  auto mesh = hexplace::Topology::parse("4x4", false);
+  std::vector<hexplace::Flow> flows = {{0, 1, 10}, {1, 2, 10}, {2, 3, 10}};
+  std::vector<unsigned> corners = {0, 15, 3, 12};
+  auto hops = hexplace::Objective::HOPS;
+  auto load = hexplace::Objective::LINK_LOAD;
+  REQUIRE(hexplace::cost(mesh, corners, flows, hops) == 150);
+  auto best = hexplace::optimise(mesh, 4, flows, hops);
+  hexplace::validate(mesh, best, 4);
+  REQUIRE(hexplace::cost(mesh, best, flows, hops) == 30);
+  auto annealed = hexplace::anneal(mesh, corners, flows, hops, 20000, 1);
+  REQUIRE(hexplace::cost(mesh, annealed, flows, hops) == 30);
+  best = hexplace::optimise(mesh, 4, flows, load);
+  REQUIRE(hexplace::cost(mesh, best, flows, load) == 10);
+  REQUIRE_THROWS(hexplace::optimise(mesh, 17, flows, hops));
+  REQUIRE_THROWS(hexplace::validate(mesh, {0, 0, 1, 2}, 4));
+}
+
+TEST_CASE("Placement in a container", "[sim_features]") {
+  // A placement written to a container is read back, and sets the hops, and
+  // so the PDES time, of its channels.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(68), "sim_sender4.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver4.bin");
+  auto file = writeContainer({sender, receiver}, {{0, 0, 1, 0}}, "sim_pl.bin");
+  auto container = hexcontainer::read(file);
+  REQUIRE(container.placement.width == 0);
+  container.placement = {4, 4, false, {0, 15}};
+  fs::path placed(CURRENT_BINARY_DIRECTORY);
+  placed /= "sim_pl_placed.bin";
+  hexcontainer::write(placed.string(), container);
+  auto readBack = hexcontainer::read(placed.string());
+  REQUIRE(readBack.placement.width == 4);
+  REQUIRE(readBack.placement.height == 4);
+  REQUIRE(!readBack.placement.torus);
+  REQUIRE(readBack.placement.nodes == std::vector<uint32_t>{0, 15});
+  REQUIRE(readBack.images == container.images);
+  auto pdesTime = [](const std::string &file,
+                     const hexplace::Topology &topology,
+                     const std::vector<unsigned> &placement) {
+    std::istringstream in;
+    std::ostringstream out;
+    hexsim::System system(in, out);
+    system.setPdes(true);
+    system.setLinkLatency(10);
+    if (!topology.empty()) {
+      system.setTopology(topology);
+      system.setPlacement(placement);
+    }
+    system.loadNetwork(file.c_str());
+    REQUIRE(system.run() == 0);
+    REQUIRE(out.str() == "D");
+    return system.getPdesStats().time;
+  };
+  auto mesh = hexplace::Topology::parse("4x4", false);
+  auto far = pdesTime(placed.string(), {}, {});
+  REQUIRE(far == pdesTime(file, mesh, {0, 15}));
+  REQUIRE(far > pdesTime(file, mesh, {0, 1}));
+  REQUIRE(pdesTime(file, {}, {}) == pdesTime(file, mesh, {5, 6}));
+}
+
 TEST_CASE("Deadlock detected", "[sim_features]") {
   // Two processors that both try to read: neither can ever proceed.
   TestContext ctx;
@@ -169,6 +486,27 @@ TEST_CASE("Deadlock detected", "[sim_features]") {
                       Catch::Matchers::ContainsSubstring("deadlock"));
 }
 
+TEST_CASE("Parallel same-direction channel error", "[sim_features]") {
+  // Two readers or two writers on one channel in a parallel run: the second
+  // finds the first waiting on the channel, and reports a mismatch rather
+  // than taking it for its partner.
+  TestContext ctx;
+  auto r = assembleToBytes(readerOnlyProgram(), "sim_pr.bin");
+  auto w = assembleToBytes(senderProgram(1), "sim_pw.bin");
+  auto readers = writeContainer({r, r}, {{0, 0, 1, 0}}, "sim_prr.bin");
+  auto writers = writeContainer({w, w}, {{0, 0, 1, 0}}, "sim_pww.bin");
+  for (auto &file : {readers, writers}) {
+    std::istringstream in;
+    std::ostringstream out;
+    hexsim::System system(in, out);
+    system.setParallel(true);
+    system.setWorkers(2);
+    system.loadNetwork(file.c_str());
+    REQUIRE_THROWS_WITH(system.run(), Catch::Matchers::ContainsSubstring(
+                                          "mismatched channel transfer"));
+  }
+}
+
 TEST_CASE("Unwired slot runtime error", "[sim_features]") {
   // A sender wired with no channel on slot 0 raises a runtime error.
   TestContext ctx;
@@ -181,3 +519,58 @@ TEST_CASE("Unwired slot runtime error", "[sim_features]") {
   REQUIRE_THROWS_WITH(system.run(),
                       Catch::Matchers::ContainsSubstring("unwired channel"));
 }
+
+TEST_CASE("Partitioned run error", "[sim_features]") {
+  // An error in a worker process of a partitioned run is raised by the run.
+  TestContext ctx;
+  auto sender = assembleToBytes(senderProgram(1), "sim_unwired2.bin");
+  auto receiver = assembleToBytes(receiverProgram(), "sim_receiver5.bin");
+  auto file =
+      writeContainer({receiver, sender}, {}, "sim_unwired_partitioned.bin");
+  std::istringstream in;
+  std::ostringstream out;
+  hexsim::System system(in, out);
+  system.setPartitions(2);
+  system.loadNetwork(file.c_str());
+  REQUIRE_THROWS_WITH(system.run(),
+                      Catch::Matchers::ContainsSubstring(
+                          "processor 0: unwired channel slot 0"));
+}
+
+TEST_CASE("IO hub merges output in time order", "[sim_features]") {
+  // Output is written in (time, port) order as the times are flushed, and a
+  // read writes the output before it.
+  std::istringstream in("ab");
+  std::ostringstream out;
+  hex::IOHub hub(in, out);
+  hub.output(1, 0, 0, 'b');
+  hub.output(0, 1, 0, 'c');
+  hub.output(2, 0, 0, 'x');
+  hub.output(0, 2, 0, 'd');
+  REQUIRE(out.str().empty());
+  hub.flush(1);
+  REQUIRE(out.str() == "bx");
+  REQUIRE(hub.input(0) == 'a');
+  REQUIRE(out.str() == "bxcd");
+  REQUIRE(hub.input(0) == 'b');
+  REQUIRE(hub.input(0) == EOF);
+}
+
+TEST_CASE("IO hub tagged output", "[sim_features]") {
+  // Each port's lines are written whole, tagged, in the order they end.
+  std::istringstream in;
+  std::ostringstream out;
+  hex::IOHub hub(in, out);
+  hub.setTagged();
+  for (char c : std::string("one\ntw")) {
+    hub.output(1, 0, 0, c);
+  }
+  for (char c : std::string("three\n")) {
+    hub.output(0, 1, 0, c);
+  }
+  hub.output(1, 2, 0, 'o');
+  hub.flush();
+  REQUIRE(out.str() == "[core1] one\n[core0] three\n");
+  hub.finish();
+  REQUIRE(out.str() == "[core1] one\n[core0] three\n[core1] two");
+}
@@ -2,6 +2,8 @@
 #define TEST_CONTEXT_HPP
 
 #include <filesystem>
+#include <functional>
+#include <map>
 
 #include "hexasm.hpp"
 #include "hexsim.hpp"
@@ -11,6 +13,56 @@ namespace fs = std::filesystem;
 
 struct TestContext {
   std::ostringstream simOutBuffer;
+  // Compile X programs for the extended OPR instructions.
+  bool extendedOprs = false;
+  // Compile X programs for the SP-indexed load/store instructions.
+  bool spIndexed = false;
+  // Run networks on a pool of threads, and the number of them (0 for one per
+  // host core).
+  bool parallel = false;
+  unsigned workers = 0;
+  // Instructions per processor per round-robin tick, and the statistics of
+  // the last network run.
+  unsigned quantum = 1;
+  hexsim::ScheduleStats scheduleStats;
+  // Run networks on the coroutine back-end, with an optional hook reporting
+  // whether input is available.
+  bool coroutines = false;
+  std::function<bool(int)> inputReady;
+  // Run networks as a PDES with the given latency per hop, and the
+  // statistics of the last PDES run.
+  bool pdes = false;
+  unsigned linkLatency = 1;
+  hexsim::PdesStats pdesStats;
+  // Split PDES runs across this many worker processes.
+  unsigned partitions = 1;
+  // Record per-channel and per-processor statistics of network runs, and
+  // those of the last run.
+  bool channelStats = false;
+  hexsim::NetworkStats networkStats;
+  // Find the critical path of network runs, and that of the last run.
+  bool findCriticalPath = false;
+  hexsim::CriticalPath criticalPath;
+  // Count the instructions of network runs on each source line, and the line
+  // profile of the last run.
+  bool profileLines = false;
+  hexsim::LineProfile lineProfile;
+  // Record a timeline of network runs, sampled every timelineInterval ticks,
+  // and the Chrome trace JSON of the last run.
+  bool recordTimeline = false;
+  unsigned timelineInterval = 1;
+  std::string timeline;
+  // Give network channels FIFOs of a depth, with overrides by name, and the
+  // FIFOs of the last run.
+  unsigned channelDepth = 0;
+  std::map<std::string, unsigned> channelDepths;
+  std::vector<hexsim::ChannelBuffer> channelBuffers;
+  // Report deadlocks to a hook as they form, rather than stopping the run.
+  std::function<void(const std::string &)> deadlockHook;
+  // Tag each line of output with the core that wrote it.
+  bool taggedOutput = false;
+  // The instructions the processors of the last run executed.
+  uint64_t instructions = 0;
 
   TestContext() {}
 
@@ -175,6 +227,8 @@ struct TestContext {
                      bool trace = false) {
     // Compile and assemble the program.
     xcmp::Driver driver(std::cout);
+    driver.setExtendedOprs(extendedOprs);
+    driver.setSpIndexed(spIndexed);
     fs::path path(CURRENT_BINARY_DIRECTORY);
     path /= fs::path("a.bin");
     driver.run(xcmp::DriverAction::EMIT_BINARY, program, false, path.c_str());
@@ -186,8 +240,39 @@ struct TestContext {
     hexsim::System system(simInBuffer, simOutBuffer);
     system.setTracing(trace);
     system.setTruncateInputs(false);
+    if (taggedOutput) {
+      system.setTaggedOutput();
+    }
+    system.setParallel(parallel);
+    system.setWorkers(workers);
+    system.setQuantum(quantum);
+    system.setCoroutines(coroutines);
+    system.setPdes(pdes);
+    system.setLinkLatency(linkLatency);
+    system.setPartitions(partitions);
+    system.setInputReady(inputReady);
+    system.setNetworkStats(channelStats);
+    system.setCriticalPath(findCriticalPath);
+    system.setLineProfile(profileLines);
+    system.setTimeline(recordTimeline, timelineInterval);
+    system.setDeadlockHook(deadlockHook);
+    system.setChannelDepth(channelDepth);
+    for (auto &[name, depth] : channelDepths) {
+      system.setChannelDepth(name, depth);
+    }
     system.loadNetwork(path.c_str());
-    return system.run();
+    auto exitCode = system.run();
+    scheduleStats = system.getScheduleStats();
+    pdesStats = system.getPdesStats();
+    networkStats = system.getNetworkStats();
+    criticalPath = system.getCriticalPath();
+    lineProfile = system.getLineProfile();
+    std::ostringstream timelineJson;
+    system.writeTimeline(timelineJson);
+    timeline = timelineJson.str();
+    channelBuffers = system.getChannelBuffers();
+    instructions = system.getInstructions();
+    return exitCode;
   }
 
   /// Run an X program from a file.
@@ -1,9 +1,11 @@
 #include "TestContext.hpp"
+#include "hexbench.hpp"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 #include <fmt/format.h>
 #include <iostream>
 #include <ostream>
+#include <set>
 
 //===---------------------------------------------------------------------===//
 // Unit tests for X language features.
@@ -154,10 +156,97 @@ proc main () is {
   REQUIRE(ctx.simOutBuffer.str() == "abc");
 }
 
-TEST_CASE("Syscall invalid 3", "[x_features]") {
+TEST_CASE("Syscall writes string", "[x_features]") {
   TestContext ctx;
 
-  auto program = "proc main() is 3(0)";
+  auto program =
+      "val writes=3; proc main() is writes(\"hello world\\n\", 0)";
+  ctx.runXProgramSrc(program);
+  REQUIRE(ctx.simOutBuffer.str() == "hello world\n");
+}
+
+TEST_CASE("Syscall writes empty string", "[x_features]") {
+  TestContext ctx;
+
+  auto program = "val writes=3; proc main() is writes(\"\", 0)";
+  ctx.runXProgramSrc(program);
+  REQUIRE(ctx.simOutBuffer.str() == "");
+}
+
+TEST_CASE("Syscall reads string", "[x_features]") {
+  TestContext ctx;
+
+  auto program = R"(
+val exit = 0;
+val writes = 3;
+val reads = 4;
+array s[64];
+proc main () is
+  var n;
+{ n := reads(s, 255, 0);
+  writes(s, 0);
+  writes(s, 0);
+  exit(n)
+})";
+  REQUIRE(ctx.runXProgramSrc(program, "abcdefg\nxyz") == 7);
+  REQUIRE(ctx.simOutBuffer.str() == "abcdefgabcdefg");
+}
+
+TEST_CASE("Syscall reads string max length", "[x_features]") {
+  TestContext ctx;
+
+  auto program = R"(
+val exit = 0;
+val writes = 3;
+val reads = 4;
+array s[64];
+proc main () is
+  var n;
+{ n := reads(s, 3, 0);
+  writes(s, 0);
+  exit(n)
+})";
+  REQUIRE(ctx.runXProgramSrc(program, "abcdefg") == 3);
+  REQUIRE(ctx.simOutBuffer.str() == "abc");
+}
+
+TEST_CASE("Syscall writen readn words", "[x_features]") {
+  TestContext ctx;
+
+  auto program = R"(
+val exit = 0;
+val writen = 5;
+val readn = 6;
+array a[8];
+proc main () is
+  var n;
+{ n := readn(a, 8, 0);
+  writen(a, n, 0);
+  exit(n)
+})";
+  REQUIRE(ctx.runXProgramSrc(program, "abcd") == 4);
+  REQUIRE(ctx.simOutBuffer.str() == "abcd");
+}
+
+TEST_CASE("Syscall block out of bounds", "[x_features]") {
+  // The address and count come from memory, so a block syscall that overruns
+  // it raises an error rather than reading or writing past the end.
+  TestContext ctx;
+  for (auto program :
+       {"val writen = 5; proc main() is writen(100000000, 1000000, 0)",
+        "val writen = 5; proc main() is writen(0, 1000000, 0)",
+        "val readn = 6; proc main() is 0(readn(199999, 2, 0))",
+        "val writes = 3; proc main() is writes(100000000, 0)",
+        "val reads = 4; proc main() is 0(reads(199999, 255, 0))"}) {
+    REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program, "abcd"),
+                        Catch::Matchers::ContainsSubstring("out of bounds"));
+  }
+}
+
+TEST_CASE("Syscall invalid 7", "[x_features]") {
+  TestContext ctx;
+
+  auto program = "proc main() is 7(0)";
   REQUIRE_THROWS_AS(ctx.runXProgramSrc(program), xcmp::InvalidSyscallError);
 }
 
@@ -168,13 +257,144 @@ TEST_CASE("Syscall invalid val minus 1", "[x_features]") {
   REQUIRE_THROWS_AS(ctx.runXProgramSrc(program), xcmp::InvalidSyscallError);
 }
 
-TEST_CASE("Syscall invalid val 3", "[x_features]") {
+TEST_CASE("Syscall invalid val 7", "[x_features]") {
   TestContext ctx;
 
-  auto program = "val x=3; proc main() is x(0)";
+  auto program = "val x=7; proc main() is x(0)";
   REQUIRE_THROWS_AS(ctx.runXProgramSrc(program), xcmp::InvalidSyscallError);
 }
 
+//===---------------------------------------------------------------------===//
+// Extended OPR operators
+//===---------------------------------------------------------------------===//
+
+TEST_CASE("Extended op mul", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  auto program = "val get=2; proc main() is 0(get(0) * get(0))";
+  REQUIRE(ctx.runXProgramSrc(program, {3, 13}) == 39);
+  REQUIRE(ctx.runXProgramSrc(program, {-3, 13}) == -39);
+}
+
+TEST_CASE("Extended op mul chain", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  auto program = "val get=2; proc main() is 0(get(0) * get(0) * get(0))";
+  REQUIRE(ctx.runXProgramSrc(program, {2, 3, 5}) == 30);
+}
+
+TEST_CASE("Extended op div", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  auto program = R"(
+val get = 2;
+proc main() is
+  var x;
+  var y;
+{ x := get(0);
+  y := get(0);
+  0(x / y)
+})";
+  REQUIRE(ctx.runXProgramSrc(program, {13, 3}) == 4);
+  REQUIRE(ctx.runXProgramSrc(program, {3, 13}) == 0);
+  REQUIRE(ctx.runXProgramSrc(program, {-13, 3}) == -4);
+  REQUIRE(ctx.runXProgramSrc(program, {13, 0}) == 0);
+}
+
+TEST_CASE("Extended op shifts", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  REQUIRE(ctx.runXProgramSrc("val get=2; proc main() is 0(get(0) << 4)",
+                             {3}) == 48);
+  REQUIRE(ctx.runXProgramSrc("val get=2; proc main() is 0(get(0) >> 2)",
+                             {100}) == 25);
+}
+
+TEST_CASE("Extended op bitwise", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  auto program = R"(
+val get = 2;
+proc main() is
+  var x;
+{ x := get(0);
+  0(((x bitand 12) bitor 1) bitxor 3)
+})";
+  REQUIRE(ctx.runXProgramSrc(program, {7}) == 6);
+}
+
+TEST_CASE("Extended op nested operands", "[x_features]") {
+  TestContext ctx;
+  ctx.extendedOprs = true;
+
+  auto program = R"(
+val get = 2;
+func sq(val x) is return x * x
+proc main() is 0((sq(get(0)) + 1) / sq(2)))";
+  REQUIRE(ctx.runXProgramSrc(program, {5}) == 6);
+}
+
+TEST_CASE("Extended op constant folding", "[x_features]") {
+  TestContext ctx;
+
+  // Constant expressions are folded, so need no target support.
+  auto program = "val x = (6 * 7) / (1 << 1); proc main() is 0(x bitxor 1)";
+  REQUIRE(ctx.runXProgramSrc(program) == 20);
+}
+
+TEST_CASE("Extended op unsupported", "[x_features]") {
+  TestContext ctx;
+
+  auto program = "val get=2; proc main() is 0(get(0) * 2)";
+  REQUIRE_THROWS_AS(ctx.runXProgramSrc(program, {3}), xcmp::ExtendedOpError);
+}
+
+//===---------------------------------------------------------------------===//
+// SP-indexed stack accesses
+//===---------------------------------------------------------------------===//
+
+TEST_CASE("SP indexed locals and calls", "[x_features]") {
+  TestContext ctx;
+  ctx.spIndexed = true;
+
+  auto program = R"(
+val get = 2;
+func add(val a, val b) is
+  var c;
+{ c := a + b;
+  return c
+}
+proc main() is
+  var x;
+  var y;
+{ x := get(0);
+  y := get(0);
+  0(add(x, add(y, 1)) - add(add(x, y), x))
+})";
+  REQUIRE(ctx.runXProgramSrc(program, {7, 3}) == -6);
+}
+
+TEST_CASE("SP indexed array assignment", "[x_features]") {
+  TestContext ctx;
+  ctx.spIndexed = true;
+
+  auto program = R"(
+val get = 2;
+array a[4];
+proc main() is
+  var i;
+{ i := get(0);
+  a[i] := get(0);
+  0(a[i] - (get(0) - a[i]))
+})";
+  REQUIRE(ctx.runXProgramSrc(program, {2, 10, 3}) == 17);
+}
+
 //===---------------------------------------------------------------------===//
 // Hello world
 //===---------------------------------------------------------------------===//
@@ -1521,6 +1741,26 @@ TEST_CASE("In statement array target tree", "[x_features]") {
   REQUIRE(output.find("arraysubscript a") != std::string::npos);
 }
 
+TEST_CASE("Block out and in statement tree", "[x_features]") {
+  TestContext ctx;
+  auto output = ctx.treeXProgramSrc("array a[4];\n"
+                                    "proc writer(chan c) is c ! a[1] for 3\n"
+                                    "proc reader(chan c) is c ? a[0] for 2\n"
+                                    "proc main() is skip")
+                    .str();
+  REQUIRE(output.find("outstmt block") != std::string::npos);
+  REQUIRE(output.find("instmt block") != std::string::npos);
+  REQUIRE(output.find("number 3") != std::string::npos);
+}
+
+TEST_CASE("Block transfer requires an array element", "[x_features]") {
+  TestContext ctx;
+  REQUIRE_THROWS_AS(ctx.treeXProgramSrc("proc writer(chan c) is var v; "
+                                        "c ! v for 3\n"
+                                        "proc main() is skip"),
+                    xcmp::ParserTokenError);
+}
+
 TEST_CASE("Message passing ring tree", "[x_features]") {
   TestContext ctx;
   // A reused worker proc placed on a two-processor ring exercises chan
@@ -1557,6 +1797,58 @@ TEST_CASE("In statement codegen", "[x_features]") {
   REQUIRE(asmText.find("OPR IN") != std::string::npos);
 }
 
+TEST_CASE("Block out and in statement codegen", "[x_features]") {
+  TestContext ctx;
+  auto asmText = ctx.asmXProgramSrc("array a[4];\n"
+                                    "proc writer(chan c) is c ! a[1] for 3\n"
+                                    "proc reader(chan c) is c ? a[0] for 2\n"
+                                    "proc main() is skip",
+                                    true)
+                     .str();
+  REQUIRE(asmText.find("OPR OUTN") != std::string::npos);
+  REQUIRE(asmText.find("OPR INN") != std::string::npos);
+}
+
+TEST_CASE("Message passing run block transfer", "[x_features]") {
+  TestContext ctx;
+  // The block start and count are computed, the count through a call.
+  auto program = "val put = 1;\n"
+                 "array a[4];\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "func three() is return 3\n"
+                 "proc source(chan out) is "
+                 "{ a[1] := 'x'; a[2] := 'y'; a[3] := 'z'; "
+                 "out ! a[1] for three() }\n"
+                 "proc sink(chan in) is var i; "
+                 "{ i := 0; in ? a[i] for 1 + 2; "
+                 "putval(a[0]); putval(a[1]); putval(a[2]) }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  REQUIRE(ctx.runXProgramSrc(program) == 0);
+  REQUIRE(ctx.simOutBuffer.str() == "xyz");
+}
+
+TEST_CASE("Message passing block count mismatch", "[x_features]") {
+  TestContext ctx;
+  auto program = "array a[4];\n"
+                 "proc source(chan out) is out ! a[0] for 3\n"
+                 "proc sink(chan in) is in ? a[0] for 2\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  REQUIRE_THROWS_WITH(
+      ctx.runXProgramSrc(program),
+      Catch::Matchers::ContainsSubstring("mismatched channel transfer"));
+}
+
+TEST_CASE("Message passing block and word mismatch", "[x_features]") {
+  TestContext ctx;
+  auto program = "array a[4];\n"
+                 "proc source(chan out) is out ! a[0] for 1\n"
+                 "proc sink(chan in) is var v; in ? v\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  REQUIRE_THROWS_WITH(
+      ctx.runXProgramSrc(program),
+      Catch::Matchers::ContainsSubstring("mismatched channel transfer"));
+}
+
 TEST_CASE("Message passing run pipeline", "[x_features]") {
   TestContext ctx;
   // source sends 'A' to sink over channel c; sink writes it to simout.
@@ -1595,6 +1887,73 @@ TEST_CASE("Message passing run deadlock", "[x_features]") {
                       Catch::Matchers::ContainsSubstring("deadlock"));
 }
 
+TEST_CASE("Message passing partial deadlock", "[x_features]") {
+  // Two workers deadlock while a third process computes: the deadlock is
+  // reported as soon as it forms, before the third process prints.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc spin() is var i; "
+                 "{ i := 0; while i < 100000 do i := i + 1; putval('S') }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a); spin() }";
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.coroutines = coroutines;
+    REQUIRE_THROWS_WITH(
+        ctx.runXProgramSrc(program),
+        Catch::Matchers::ContainsSubstring(
+            "processor 1 (reading slot 0 in worker) -> "
+            "processor 0 (reading slot 0 in worker) -> processor 1"));
+    REQUIRE(ctx.simOutBuffer.str().empty());
+  }
+}
+
+TEST_CASE("Message passing deadlock on a halted partner", "[x_features]") {
+  // The reader halts without reading, leaving the writer waiting forever.
+  TestContext ctx;
+  auto program = "proc early(chan in) is var v; "
+                 "if 0 = 1 then in ? v else skip\n"
+                 "proc late(chan out) is out ! 1\n"
+                 "proc main() is chan c; par { early(c); late(c) }";
+  REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring(
+                          "processor 1 (writing slot 0 in late) -> "
+                          "processor 0 (halted)"));
+}
+
+TEST_CASE("Message passing deadlock reports", "[x_features]") {
+  // With a hook, each deadlock is reported as it forms and the other
+  // processes run on, until the whole network deadlocks.
+  TestContext ctx;
+  std::vector<std::string> reports;
+  ctx.deadlockHook = [&](const std::string &msg) { reports.push_back(msg); };
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc spin() is var i; "
+                 "{ i := 0; while i < 1000 do i := i + 1; putval('S') }\n"
+                 "proc early(chan in) is var v; "
+                 "if 0 = 1 then in ? v else skip\n"
+                 "proc late(chan out) is out ! 1\n"
+                 "proc main() is chan a; chan b; chan c; "
+                 "par { worker(a, b); worker(b, a); spin(); early(c); "
+                 "late(c) }";
+  REQUIRE_THROWS_WITH(
+      ctx.runXProgramSrc(program),
+      Catch::Matchers::ContainsSubstring(
+          "processor 0 (reading slot 0 in worker) -> "
+          "processor 1 (reading slot 0 in worker) -> processor 0; "
+          "processor 4 (writing slot 0 in late) -> processor 3 (halted)"));
+  REQUIRE(ctx.simOutBuffer.str() == "S");
+  REQUIRE(reports.size() == 2);
+  REQUIRE(reports[0].find("-> processor 0 (reading slot 0 in worker) -> "
+                          "processor 1") != std::string::npos);
+  REQUIRE(reports[1].find("processor 3 (halted)") != std::string::npos);
+}
+
 TEST_CASE("Message passing channel endpoint error", "[x_features]") {
   TestContext ctx;
   // Channel a is used by only one process.
@@ -1671,8 +2030,639 @@ TEST_CASE("Message passing run scan x file", "[x_features]") {
   REQUIRE(ctx.simOutBuffer.str() == "1\n3\n6\n10\n");
 }
 
+TEST_CASE("Message passing run blockpipe x file", "[x_features]") {
+  TestContext ctx;
+  REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("blockpipe.x")) == 0);
+  REQUIRE(ctx.simOutBuffer.str() == "72\n");
+}
+
 TEST_CASE("Message passing run horner x file", "[x_features]") {
   TestContext ctx;
   REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("horner.x")) == 0);
   REQUIRE(ctx.simOutBuffer.str() == "26\n");
 }
+
+TEST_CASE("Message passing parallel run x files", "[x_features]") {
+  // A pool of threads gives the same output as the round-robin schedule,
+  // including with fewer threads than processors.
+  for (unsigned workers : {0U, 2U}) {
+    for (auto [filename, expected] :
+         std::vector<std::pair<std::string, std::string>>{
+             {"sieve.x", "2\n3\n5\n"},
+             {"farm.x", "200\n"},
+             {"stencil.x", "3\n6\n9\n7\n"},
+             {"mergesort.x", "1\n2\n3\n4\n"},
+             {"blockpipe.x", "72\n"}}) {
+      TestContext ctx;
+      ctx.parallel = true;
+      ctx.workers = workers;
+      REQUIRE(ctx.runXProgramFile(ctx.getXTestPath(filename)) == 0);
+      REQUIRE(ctx.simOutBuffer.str() == expected);
+    }
+  }
+}
+
+TEST_CASE("Message passing run long pipeline", "[x_features]") {
+  // A 48-stage pipeline in which most stages are blocked at any time, run
+  // round-robin and on 3 workers, so processors share and steal threads.
+  const int stages = 48;
+  std::string program = "val put = 1;\n"
+                        "proc putval(val c) is put(c, 0)\n"
+                        "proc source(chan out) is var i; "
+                        "{ i := 0; while i < 8 do { out ! i; i := i + 1 } }\n"
+                        "proc relay(chan in, chan out) is var i; var v; "
+                        "{ i := 0; while i < 8 do "
+                        "{ in ? v; out ! v + 1; i := i + 1 } }\n"
+                        "proc sink(chan in) is var i; var v; "
+                        "{ i := 0; while i < 8 do "
+                        "{ in ? v; putval(v); i := i + 1 } }\n"
+                        "proc main() is\n";
+  for (int i = 0; i <= stages; i++) {
+    program += fmt::format("  chan c{};\n", i);
+  }
+  program += "  par { source(c0)";
+  for (int i = 0; i < stages; i++) {
+    program += fmt::format("; relay(c{}, c{})", i, i + 1);
+  }
+  program += fmt::format("; sink(c{}) }}", stages);
+  for (bool parallel : {false, true}) {
+    TestContext ctx;
+    ctx.parallel = parallel;
+    ctx.workers = 3;
+    REQUIRE(ctx.runXProgramSrc(program) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == "01234567");
+  }
+}
+
+TEST_CASE("Message passing run ready queue schedule", "[x_features]") {
+  // The ready queues step the runnable processors in id order once a round,
+  // and a blocked processor woken by a rendezvous resumes in the same round if
+  // its id is still to come, otherwise in the next. The ticks and instructions
+  // are those of stepping every processor each round.
+  struct Expected {
+    const char *filename;
+    uint64_t ticks;
+    uint64_t instructions;
+  };
+  for (auto [filename, ticks, instructions] :
+       {Expected{"pingpong.x", 79, 127}, Expected{"sieve.x", 6594, 9719},
+        Expected{"farm.x", 3238, 3416}}) {
+    TestContext ctx;
+    ctx.runXProgramFile(ctx.getXTestPath(filename));
+    REQUIRE(ctx.scheduleStats.ticks == ticks);
+    REQUIRE(ctx.scheduleStats.instructions == instructions);
+  }
+  // The reader blocks first, and the writer's rendezvous wakes it: with a
+  // higher id it resumes in the same round, and with a lower id in the next.
+  std::string processes = "proc w(chan c) is var i; "
+                          "{ i := 0; while i < 20 do i := i + 1; c ! i }\n"
+                          "proc r(chan c) is var v; c ? v\n";
+  TestContext higher, lower;
+  REQUIRE(higher.runXProgramSrc(
+              processes + "proc main() is chan c; par { w(c); r(c) }") == 0);
+  REQUIRE(lower.runXProgramSrc(
+              processes + "proc main() is chan c; par { r(c); w(c) }") == 0);
+  REQUIRE(higher.scheduleStats.ticks == 376);
+  REQUIRE(lower.scheduleStats.ticks == 377);
+  REQUIRE(higher.scheduleStats.instructions == 418);
+  REQUIRE(lower.scheduleStats.instructions == 418);
+}
+
+TEST_CASE("Message passing run quantum", "[x_features]") {
+  // Larger quanta give the same results in fewer ticks.
+  uint64_t ticks = 0;
+  for (unsigned quantum : {1U, 16U, 1000U}) {
+    TestContext ctx;
+    ctx.quantum = quantum;
+    REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("stencil.x")) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == "3\n6\n9\n7\n");
+    REQUIRE(ctx.scheduleStats.quantum == quantum);
+    REQUIRE(ctx.scheduleStats.outputs == 8);
+    REQUIRE(ctx.scheduleStats.firstOutputTick <=
+            ctx.scheduleStats.lastOutputTick);
+    REQUIRE(ctx.scheduleStats.lastOutputTick <
+            static_cast<int64_t>(ctx.scheduleStats.ticks));
+    if (ticks > 0) {
+      REQUIRE(ctx.scheduleStats.ticks < ticks);
+    }
+    ticks = ctx.scheduleStats.ticks;
+  }
+}
+
+TEST_CASE("Message passing run quantum deterministic", "[x_features]") {
+  // Two processors print independently, so the interleaving depends on the
+  // quantum, but not on anything else.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc count(chan c) is var i; "
+                 "{ i := 0; while i < 6 do { putval('a' + i); i := i + 1 }; "
+                 "c ! 0 }\n"
+                 "proc wait(chan c) is var i; var v; "
+                 "{ i := 0; while i < 6 do { putval('A' + i); i := i + 1 }; "
+                 "c ? v }\n"
+                 "proc main() is chan c; par { count(c); wait(c) }";
+  TestContext first, second;
+  first.quantum = second.quantum = 7;
+  REQUIRE(first.runXProgramSrc(program) == 0);
+  REQUIRE(second.runXProgramSrc(program) == 0);
+  REQUIRE(first.simOutBuffer.str() == second.simOutBuffer.str());
+  REQUIRE(first.scheduleStats.ticks == second.scheduleStats.ticks);
+  REQUIRE(first.simOutBuffer.str().size() == 12);
+}
+
+TEST_CASE("Message passing coroutine run x files", "[x_features]") {
+  // Coroutines follow the same schedule as stepping, for any quantum.
+  for (unsigned quantum : {1U, 16U}) {
+    for (auto filename :
+         {"pingpong.x", "sieve.x", "farm.x", "stencil.x", "blockpipe.x"}) {
+      TestContext stepped, ctx;
+      stepped.quantum = ctx.quantum = quantum;
+      ctx.coroutines = true;
+      REQUIRE(stepped.runXProgramFile(ctx.getXTestPath(filename)) ==
+              ctx.runXProgramFile(ctx.getXTestPath(filename)));
+      REQUIRE(ctx.simOutBuffer.str() == stepped.simOutBuffer.str());
+      REQUIRE(ctx.scheduleStats.ticks == stepped.scheduleStats.ticks);
+      REQUIRE(ctx.scheduleStats.instructions ==
+              stepped.scheduleStats.instructions);
+    }
+  }
+}
+
+TEST_CASE("Message passing coroutine run deadlock", "[x_features]") {
+  TestContext ctx;
+  ctx.coroutines = true;
+  auto program = "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a) }";
+  REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring("deadlock"));
+}
+
+TEST_CASE("Message passing coroutine run parallel", "[x_features]") {
+  // The coroutine back-end is round-robin, so a parallel run rejects it.
+  TestContext ctx;
+  ctx.coroutines = true;
+  ctx.parallel = true;
+  auto program = "proc worker(chan c) is c ! 0\n"
+                 "proc sink(chan c) is var v; c ? v\n"
+                 "proc main() is chan c; par { worker(c); sink(c) }";
+  REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring(
+                          "coroutines are not supported in parallel mode"));
+}
+
+TEST_CASE("Message passing coroutine run async input", "[x_features]") {
+  // Input only becomes available once the writer has printed, so the reader
+  // suspends while the writer runs, instead of the whole network blocking.
+  auto program = "val put = 1;\n"
+                 "val get = 2;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc reader(chan c) is var v; "
+                 "{ v := get(0); putval(v); c ! 0 }\n"
+                 "proc writer(chan c) is var i; var v; "
+                 "{ i := 0; while i < 4 do { putval('a' + i); i := i + 1 }; "
+                 "c ? v }\n"
+                 "proc main() is chan c; par { reader(c); writer(c) }";
+  TestContext stepped;
+  REQUIRE(stepped.runXProgramSrc(program, "X") == 0);
+  REQUIRE(stepped.simOutBuffer.str() == "Xabcd");
+  TestContext ctx;
+  ctx.coroutines = true;
+  ctx.inputReady = [&ctx](int) { return ctx.simOutBuffer.str().size() >= 4; };
+  REQUIRE(ctx.runXProgramSrc(program, "X") == 0);
+  REQUIRE(ctx.simOutBuffer.str() == "abcdX");
+}
+
+TEST_CASE("Message passing pdes run x files", "[x_features]") {
+  // Timed channels give the same results, in a simulated time that grows
+  // with the link latency and does not depend on the number of threads.
+  for (auto [filename, expected] :
+       std::vector<std::pair<std::string, std::string>>{
+           {"pingpong.x", "X"},
+           {"sieve.x", "2\n3\n5\n"},
+           {"farm.x", "200\n"},
+           {"stencil.x", "3\n6\n9\n7\n"},
+           {"blockpipe.x", "72\n"}}) {
+    uint64_t time = 0;
+    for (unsigned latency : {1U, 8U}) {
+      TestContext single, ctx;
+      single.pdes = ctx.pdes = true;
+      single.linkLatency = ctx.linkLatency = latency;
+      single.workers = 1;
+      ctx.workers = 3;
+      REQUIRE(single.runXProgramFile(ctx.getXTestPath(filename)) == 0);
+      REQUIRE(ctx.runXProgramFile(ctx.getXTestPath(filename)) == 0);
+      REQUIRE(ctx.simOutBuffer.str() == expected);
+      REQUIRE(single.simOutBuffer.str() == expected);
+      REQUIRE(ctx.pdesStats.time == single.pdesStats.time);
+      REQUIRE(ctx.pdesStats.windows == single.pdesStats.windows);
+      REQUIRE(ctx.pdesStats.time > time);
+      time = ctx.pdesStats.time;
+    }
+  }
+}
+
+TEST_CASE("Message passing pdes run timing", "[x_features]") {
+  // The round trip of a word transfer is two link latencies.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc source(chan out) is out ! 65\n"
+                 "proc sink(chan in) is var v; { in ? v; putval(v) }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  TestContext fast, slow;
+  fast.pdes = slow.pdes = true;
+  fast.linkLatency = 100;
+  slow.linkLatency = 200;
+  REQUIRE(fast.runXProgramSrc(program) == 0);
+  REQUIRE(slow.runXProgramSrc(program) == 0);
+  REQUIRE(fast.simOutBuffer.str() == "A");
+  REQUIRE(slow.simOutBuffer.str() == "A");
+  REQUIRE(slow.pdesStats.time - fast.pdesStats.time == 200);
+}
+
+TEST_CASE("Message passing pdes run deadlock", "[x_features]") {
+  TestContext ctx;
+  ctx.pdes = true;
+  auto program = "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a) }";
+  REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring("deadlock"));
+}
+
+TEST_CASE("Message passing pdes run quantum", "[x_features]") {
+  // Processors advance in their own simulated time in PDES mode, so it
+  // rejects a quantum, split across processes or not.
+  auto program = "proc worker(chan c) is c ! 0\n"
+                 "proc sink(chan c) is var v; c ? v\n"
+                 "proc main() is chan c; par { worker(c); sink(c) }";
+  for (unsigned partitions : {1, 2}) {
+    TestContext ctx;
+    ctx.pdes = true;
+    ctx.partitions = partitions;
+    ctx.quantum = 4;
+    REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                        Catch::Matchers::ContainsSubstring(
+                            "a quantum is not supported in PDES mode"));
+  }
+}
+
+TEST_CASE("Message passing partitioned run x files", "[x_features]") {
+  // Splitting a PDES run across worker processes gives the same results and
+  // statistics as running it in one.
+  for (auto [filename, expected] :
+       std::vector<std::pair<std::string, std::string>>{
+           {"pingpong.x", "X"},
+           {"sieve.x", "2\n3\n5\n"},
+           {"farm.x", "200\n"},
+           {"stencil.x", "3\n6\n9\n7\n"},
+           {"blockpipe.x", "72\n"}}) {
+    TestContext single;
+    single.pdes = true;
+    single.linkLatency = 4;
+    REQUIRE(single.runXProgramFile(single.getXTestPath(filename)) == 0);
+    REQUIRE(single.simOutBuffer.str() == expected);
+    for (unsigned partitions : {2U, 4U}) {
+      TestContext ctx;
+      ctx.pdes = true;
+      ctx.linkLatency = 4;
+      ctx.partitions = partitions;
+      REQUIRE(ctx.runXProgramFile(ctx.getXTestPath(filename)) == 0);
+      REQUIRE(ctx.simOutBuffer.str() == expected);
+      REQUIRE(ctx.pdesStats.time == single.pdesStats.time);
+      REQUIRE(ctx.pdesStats.windows == single.pdesStats.windows);
+      REQUIRE(ctx.pdesStats.phases == single.pdesStats.phases);
+    }
+  }
+}
+
+TEST_CASE("Message passing partitioned run input", "[x_features]") {
+  // The coordinator serves the workers' input, one character at a time.
+  auto program = "val put = 1;\n"
+                 "val get = 2;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc reader(chan out) is var c; "
+                 "{ c := get(0); while c ~= 10 do { out ! c; c := get(0) }; "
+                 "out ! 0 }\n"
+                 "proc upper(chan in, chan out) is var c; "
+                 "{ in ? c; while c ~= 0 do { out ! c - 32; in ? c }; "
+                 "out ! 0 }\n"
+                 "proc writer(chan in) is var c; "
+                 "{ in ? c; while c ~= 0 do { putval(c); in ? c }; "
+                 "putval(10) }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { reader(a); upper(a, b); writer(b) }";
+  TestContext ctx;
+  ctx.pdes = true;
+  ctx.partitions = 3;
+  REQUIRE(ctx.runXProgramSrc(program, "hex\n") == 0);
+  REQUIRE(ctx.simOutBuffer.str() == "HEX\n");
+}
+
+TEST_CASE("Message passing partitioned run deadlock", "[x_features]") {
+  // The workers detect the deadlock of processors in different partitions.
+  TestContext ctx;
+  ctx.pdes = true;
+  ctx.partitions = 2;
+  auto program = "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a) }";
+  REQUIRE_THROWS_WITH(
+      ctx.runXProgramSrc(program),
+      Catch::Matchers::ContainsSubstring(
+          "processor 0 (reading slot 0 in worker) -> "
+          "processor 1 (reading slot 0 in worker) -> processor 0"));
+}
+
+TEST_CASE("Message passing parallel run output order", "[x_features]") {
+  // Every processor prints, so the interleaving and the exit code must follow
+  // the round-robin schedule.
+  auto program = "val put = 1;\n"
+                 "val exit = 0;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc source(chan out) is var i; "
+                 "{ i := 0; while i < 4 do { putval('a' + i); out ! i; "
+                 "i := i + 1 }; exit(3) }\n"
+                 "proc sink(chan in) is var i; var v; "
+                 "{ i := 0; while i < 4 do { in ? v; putval('A' + v); "
+                 "i := i + 1 }; exit(5) }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  TestContext sequential;
+  auto exitCode = sequential.runXProgramSrc(program);
+  TestContext ctx;
+  ctx.parallel = true;
+  REQUIRE(ctx.runXProgramSrc(program) == exitCode);
+  REQUIRE(ctx.simOutBuffer.str() == sequential.simOutBuffer.str());
+}
+
+TEST_CASE("Message passing parallel run deadlock", "[x_features]") {
+  TestContext ctx;
+  ctx.parallel = true;
+  auto program = "proc worker(chan in, chan out) is var v; "
+                 "{ in ? v; out ! v }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a) }";
+  REQUIRE_THROWS_WITH(ctx.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring("deadlock"));
+}
+
+TEST_CASE("Message passing run channel stats", "[x_features]") {
+  // The source sends one block on a, and the doubler two on b (the empty
+  // block between them completes without a rendezvous), each reader waiting
+  // for its writer.
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.channelStats = true;
+    ctx.coroutines = coroutines;
+    REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("blockpipe.x")) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == "72\n");
+    auto &stats = ctx.networkStats;
+    REQUIRE(stats.ticks == ctx.scheduleStats.ticks);
+    REQUIRE(stats.processors.size() == 3);
+    for (auto &p : stats.processors) {
+      REQUIRE(p.busyTicks + p.blockedTicks + p.haltedTicks == stats.ticks);
+    }
+    REQUIRE(stats.processors[0].blockedTicks == 0);
+    REQUIRE(stats.processors[2].haltedTicks == 0);
+    REQUIRE(stats.channels.size() == 2);
+    auto &a = stats.channels[0];
+    auto &b = stats.channels[1];
+    REQUIRE(a.name == "a");
+    REQUIRE(b.name == "b");
+    REQUIRE(a.messages == 1);
+    REQUIRE(a.words == 8);
+    REQUIRE(a.firstTick == a.lastTick);
+    REQUIRE(a.a.sent == 1);
+    REQUIRE(a.b.received == 1);
+    REQUIRE(b.messages == 2);
+    REQUIRE(b.words == 8);
+    REQUIRE(b.firstTick < b.lastTick);
+    REQUIRE(a.lastTick < b.firstTick);
+    REQUIRE(a.writerWaitTicks == 0);
+    REQUIRE(a.readerWaitTicks == stats.processors[1].blockedTicks);
+    REQUIRE(b.readerWaitTicks == stats.processors[2].blockedTicks);
+  }
+}
+
+TEST_CASE("Message passing run critical path", "[x_features]") {
+  // The sink waits for the busy source, so the path runs through the
+  // source's loop, the rendezvous and then the sink's output.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc source(chan out) is var i; "
+                 "{ i := 0; while i < 50 do i := i + 1; out ! i }\n"
+                 "proc sink(chan in) is var v; { in ? v; putval(v) }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.findCriticalPath = true;
+    ctx.coroutines = coroutines;
+    REQUIRE(ctx.runXProgramSrc(program) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == "2");
+    auto &path = ctx.criticalPath;
+    REQUIRE(path.rendezvous == 1);
+    REQUIRE(path.processors.size() == 2);
+    auto &source = path.processors[0];
+    auto &sink = path.processors[1];
+    REQUIRE(path.length ==
+            source.criticalInstructions + sink.criticalInstructions);
+    REQUIRE(source.criticalInstructions < source.instructions);
+    REQUIRE(sink.criticalInstructions < sink.instructions);
+    REQUIRE(sink.slack == 0);
+    REQUIRE(path.procedures[0].processor == 0);
+    REQUIRE(path.procedures[0].procedure == "source");
+    uint64_t total = 0;
+    for (auto &entry : path.procedures) {
+      total += entry.instructions;
+    }
+    REQUIRE(total == path.length);
+  }
+}
+
+TEST_CASE("Line profile", "[x_features]") {
+  // The loop's lines run a hundred times, and the code of each statement is
+  // counted on its own line, with the startup code on none.
+  auto program = "proc main() is var i; var s;\n"  // 1
+                 "{ i := 0;\n"                      // 2
+                 "  s := 0;\n"                      // 3
+                 "  while i < 100 do\n"             // 4
+                 "  { s := s + i;\n"                // 5
+                 "    i := i + 1 }\n"               // 6
+                 "}";
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.profileLines = true;
+    ctx.coroutines = coroutines;
+    REQUIRE(ctx.runXProgramSrc(program) == 0);
+    auto &profile = ctx.lineProfile;
+    REQUIRE(profile.instructions == ctx.instructions);
+    REQUIRE(profile.lines.size() == 6);
+    std::set<uint32_t> hot;
+    uint64_t onLines = 0;
+    for (size_t i = 0; i < profile.lines.size(); i++) {
+      if (i < 3) {
+        hot.insert(profile.lines[i].line);
+        REQUIRE(profile.lines[i].instructions >= 100);
+      } else {
+        REQUIRE(profile.lines[i].instructions < 100);
+      }
+      onLines += profile.lines[i].instructions;
+    }
+    REQUIRE(hot == std::set<uint32_t>{4, 5, 6});
+    REQUIRE(onLines < profile.instructions);
+  }
+  // A parallel run does not count lines.
+  TestContext ctx;
+  ctx.profileLines = true;
+  ctx.parallel = true;
+  REQUIRE_THROWS(ctx.runXProgramSrc(program));
+}
+
+TEST_CASE("Message passing tagged output", "[x_features]") {
+  // Both processors write a line at the same ticks. Merged, the characters
+  // interleave in processor order, and tagged, each line is kept whole.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc line(val c) is { putval(c); putval(c); putval(10) }\n"
+                 "proc a() is line('a')\n"
+                 "proc b() is line('b')\n"
+                 "proc main() is par { a(); b() }";
+  TestContext merged;
+  REQUIRE(merged.runXProgramSrc(program) == 0);
+  REQUIRE(merged.simOutBuffer.str() == "abab\n\n");
+  for (unsigned partitions : {1, 2}) {
+    for (bool pdes : {false, true}) {
+      TestContext ctx;
+      ctx.taggedOutput = true;
+      ctx.pdes = pdes;
+      ctx.partitions = partitions;
+      REQUIRE(ctx.runXProgramSrc(program) == 0);
+      REQUIRE(ctx.simOutBuffer.str() == "[core0] aa\n[core1] bb\n");
+    }
+  }
+}
+
+TEST_CASE("Message passing timeline", "[x_features]") {
+  // The sink blocks reading until the busy source sends, and the arrow of
+  // the one rendezvous joins their transfers.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc source(chan out) is var i; "
+                 "{ i := 0; while i < 50 do i := i + 1; out ! i }\n"
+                 "proc sink(chan in) is var v; { in ? v; putval(v) }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  auto count = [](const std::string &text, const std::string &pattern) {
+    size_t n = 0;
+    for (auto at = text.find(pattern); at != std::string::npos;
+         at = text.find(pattern, at + 1)) {
+      n++;
+    }
+    return n;
+  };
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.recordTimeline = true;
+    ctx.coroutines = coroutines;
+    REQUIRE(ctx.runXProgramSrc(program) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == "2");
+    auto &json = ctx.timeline;
+    REQUIRE(json.find("\"name\": \"processor 1\"") != std::string::npos);
+    REQUIRE(json.find("\"name\": \"source\", \"cat\": \"call\"") !=
+            std::string::npos);
+    REQUIRE(json.find("\"name\": \"putval\", \"cat\": \"call\"") !=
+            std::string::npos);
+    REQUIRE(json.find("\"name\": \"blocked reading slot 0\"") !=
+            std::string::npos);
+    REQUIRE(json.find("\"name\": \"blocked writing") == std::string::npos);
+    REQUIRE(count(json, "\"bind_id\": 1, \"flow_out\": true") == 1);
+    REQUIRE(count(json, "\"bind_id\": 1, \"flow_in\": true") == 1);
+    REQUIRE(count(json, "\"name\": \"WRITE\"") == 1);
+    REQUIRE(count(json, "\"name\": \"halt\"") == 2);
+    // Sampling merges the calls into fewer slices.
+    TestContext sampled;
+    sampled.recordTimeline = true;
+    sampled.timelineInterval = 20;
+    sampled.coroutines = coroutines;
+    REQUIRE(sampled.runXProgramSrc(program) == 0);
+    REQUIRE(sampled.timeline.find("\"name\": \"source\", \"cat\": "
+                                  "\"sample\"") != std::string::npos);
+    REQUIRE(sampled.timeline.find("\"cat\": \"call\"") ==
+            std::string::npos);
+    REQUIRE(sampled.timeline.size() < json.size());
+  }
+}
+
+TEST_CASE("Benchmark networks", "[x_features]") {
+  // Each generated network prints its checksum, and executes the same
+  // instructions under each scheduling policy.
+  for (auto topology : hexbench::allTopologies()) {
+    for (unsigned procs : {2, 3, 5, 8}) {
+      hexbench::Params params{topology, procs, 3, 2};
+      auto program = hexbench::generate(params);
+      TestContext ctx;
+      REQUIRE(ctx.runXProgramSrc(program) == 0);
+      REQUIRE(ctx.simOutBuffer.str() == hexbench::expectedOutput(params));
+      REQUIRE(ctx.instructions > 0);
+      TestContext pdes;
+      pdes.pdes = true;
+      pdes.partitions = 2;
+      REQUIRE(pdes.runXProgramSrc(program) == 0);
+      REQUIRE(pdes.simOutBuffer.str() == hexbench::expectedOutput(params));
+      REQUIRE(pdes.instructions == ctx.instructions);
+    }
+  }
+}
+
+TEST_CASE("Message passing buffered channels", "[x_features]") {
+  // The source sends a burst and then computes, and the sink computes and
+  // then reads the burst. With a FIFO for the burst, the two computations
+  // overlap.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc spin() is var i; "
+                 "{ i := 0; while i < 100 do i := i + 1 }\n"
+                 "proc source(chan out) is var i; "
+                 "{ i := 0; while i < 4 do { out ! i; i := i + 1 }; spin() }\n"
+                 "proc sink(chan in) is var i; var v; "
+                 "{ spin(); i := 0; "
+                 "while i < 4 do { in ? v; putval('0' + v); i := i + 1 } }\n"
+                 "proc main() is chan c; par { source(c); sink(c) }";
+  TestContext synchronous;
+  REQUIRE(synchronous.runXProgramSrc(program) == 0);
+  for (bool coroutines : {false, true}) {
+    TestContext ctx;
+    ctx.coroutines = coroutines;
+    ctx.channelDepths["c"] = 4;
+    REQUIRE(ctx.runXProgramSrc(program) == 0);
+    REQUIRE(ctx.simOutBuffer.str() == synchronous.simOutBuffer.str());
+    REQUIRE(ctx.scheduleStats.ticks < synchronous.scheduleStats.ticks);
+    REQUIRE(ctx.channelBuffers.size() == 1);
+    REQUIRE(ctx.channelBuffers[0].depth == 4);
+    REQUIRE(ctx.channelBuffers[0].peak == 4);
+  }
+}
+
+TEST_CASE("Message passing buffered channels avoid deadlock",
+          "[x_features]") {
+  // Both processes write before reading, which needs a FIFO on each channel.
+  auto program = "val put = 1;\n"
+                 "proc putval(val c) is put(c, 0)\n"
+                 "proc worker(chan out, chan in) is var v; "
+                 "{ out ! 1; in ? v; putval('0' + v) }\n"
+                 "proc main() is chan a; chan b; "
+                 "par { worker(a, b); worker(b, a) }";
+  TestContext synchronous;
+  REQUIRE_THROWS_WITH(synchronous.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring("deadlock"));
+  TestContext ctx;
+  ctx.channelDepth = 1;
+  REQUIRE(ctx.runXProgramSrc(program) == 0);
+  REQUIRE(ctx.simOutBuffer.str() == "11");
+  TestContext unknown;
+  unknown.channelDepths["z"] = 1;
+  REQUIRE_THROWS_WITH(unknown.runXProgramSrc(program),
+                      Catch::Matchers::ContainsSubstring("no channel named z"));
+}
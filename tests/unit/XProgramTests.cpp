@@ -189,6 +189,18 @@ TEST_CASE("Hanoi", "[x_programs]") {
           "A -> C\nA -> B\nC -> B\nA -> C\nB -> A\nB -> C\nA -> C\n");
 }
 
+TEST_CASE("SP indexed programs", "[x_programs]") {
+  TestContext ctx;
+  ctx.spIndexed = true;
+
+  REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("fac.x"), {5}) == 120);
+  REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("ackermann.x"), {3, 3}) == 61);
+  REQUIRE(ctx.runXProgramFile(ctx.getXTestPath("bubblesort.x")) == 0);
+  ctx.runXProgramFile(ctx.getXTestPath("hanoi.x"), {3});
+  REQUIRE(ctx.simOutBuffer.str() ==
+          "A -> C\nA -> B\nC -> B\nA -> C\nB -> A\nB -> C\nA -> C\n");
+}
+
 TEST_CASE("Xhexb tree", "[x_programs]") {
   TestContext ctx;
 
@@ -228,10 +240,10 @@ TEST_CASE("Xhexb xhexb hello prints", "[x_programs]") {
   // Simulate the compiled program (compile xhexb using xcmp.cpp:xhexb.x
   // binary).
   ctx.simXBinary("simout2", xhexbContents);
-  REQUIRE(ctx.simOutBuffer.str() == R"(error near line 3054: illegal character
-tree size: 18631
-program size: 17093
-size: 177097
+  REQUIRE(ctx.simOutBuffer.str() == R"(error near line 3030: illegal character
+tree size: 18477
+program size: 16969
+size: 176973
 )");
   // Simulate the compiled program (compile hello_prints using xhexb.x:xhexb.x
   // binary).
@@ -0,0 +1,70 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "hex2c.hpp"
+#include "hexcontainer.hpp"
+
+//===---------------------------------------------------------------------===//
+// Driver
+//===---------------------------------------------------------------------===//
+
+static void help(const char *argv[]) {
+  std::cout << "Hex to C++ translator\n\n";
+  std::cout << "Usage: " << argv[0] << " file\n\n";
+  std::cout << "Positional arguments:\n";
+  std::cout << "  file              A binary file or network container to "
+               "translate\n\n";
+  std::cout << "Optional arguments:\n";
+  std::cout << "  -h,--help         Display this message\n";
+  std::cout << "  -o,--output file  Specify a file for C++ output (default "
+               "a.cpp)\n\n";
+  std::cout << "Compile the output with the hex2crt.hpp runtime, eg:\n";
+  std::cout << "  c++ -std=c++20 -O2 -I<hex-processor>/src a.cpp\n";
+}
+
+int main(int argc, const char *argv[]) {
+  try {
+    const char *filename = nullptr;
+    const char *outputFilename = "a.cpp";
+    for (int i = 1; i < argc; ++i) {
+      if (std::strcmp(argv[i], "-h") == 0 ||
+          std::strcmp(argv[i], "--help") == 0) {
+        help(argv);
+        return 0;
+      } else if (std::strcmp(argv[i], "--output") == 0 ||
+                 std::strcmp(argv[i], "-o") == 0) {
+        outputFilename = argv[++i];
+      } else if (argv[i][0] == '-') {
+        throw std::runtime_error(std::string("unrecognised argument: ") +
+                                 argv[i]);
+      } else {
+        if (!filename) {
+          filename = argv[i];
+        } else {
+          throw std::runtime_error("cannot specify more than one file");
+        }
+      }
+    }
+
+    // A file must be specified.
+    if (!filename) {
+      help(argv);
+      return 1;
+    }
+
+    // Translate.
+    hex2c::Translator translator(hexcontainer::read(filename));
+    std::ofstream outputFile(outputFilename);
+    if (!outputFile) {
+      throw std::runtime_error(std::string("could not open file: ") +
+                               outputFilename);
+    }
+    translator.emit(outputFile);
+
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "hexasm.hpp"
+#include "hexbench.hpp"
+#include "hexsim.hpp"
+#include "xcmp.hpp"
+
+//===---------------------------------------------------------------------===//
+// Driver
+//===---------------------------------------------------------------------===//
+
+static void help(const char *argv[]) {
+  std::cout << "Hex network scaling benchmark\n\n";
+  std::cout << "Usage: " << argv[0] << " [options]\n\n";
+  std::cout << "Optional arguments:\n";
+  std::cout << "  -h,--help       Display this message\n";
+  std::cout << "  --topology NAME Benchmark ring, pipeline, tree, farm or "
+               "stencil networks\n"
+               "                  (default: all)\n";
+  std::cout << "  --procs LIST    Comma-separated processor counts "
+               "(default: 2,4,8,16,32,64)\n";
+  std::cout << "  --messages M    Messages per processor (default: 100)\n";
+  std::cout << "  --compute C     Iterations of work per message "
+               "(default: 10)\n";
+  std::cout << "  --emit DIR      Write the X source and binary of each "
+               "network to DIR\n"
+               "                  instead of running them\n";
+  std::cout << "  --compress      Compress the images of each network\n";
+  std::cout << "  --repeat R      Time the best of R runs (default: 1)\n";
+  std::cout << "  --csv           Report as CSV\n";
+  std::cout << "  --max-cycles N  Limit the number of simulation cycles "
+               "(default: 0)\n";
+  std::cout << "  --quantum K     Run each processor for up to K instructions "
+               "per tick (default: 1)\n";
+  std::cout << "  --coroutines    Run each processor as a coroutine\n";
+  std::cout << "  --pdes          Simulate timed channels on a pool of "
+               "threads\n";
+  std::cout << "  --partitions N  Run --pdes across N worker processes\n";
+  std::cout << "  --parallel      Run the processors on a pool of threads\n";
+  std::cout << "  --workers N     Number of threads for --parallel or --pdes "
+               "(default: one\n"
+               "                  per core)\n";
+}
+
+/// Parse a comma-separated list of processor counts.
+static std::vector<unsigned> parseProcs(const std::string &list) {
+  std::vector<unsigned> procs;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    procs.push_back(std::stoul(item));
+  }
+  return procs;
+}
+
+int main(int argc, const char *argv[]) {
+  try {
+    std::vector<hexbench::Topology> topologies = hexbench::allTopologies();
+    std::vector<unsigned> procCounts = {2, 4, 8, 16, 32, 64};
+    unsigned messages = 100;
+    unsigned compute = 10;
+    const char *emitDir = nullptr;
+    bool compress = false;
+    unsigned repeat = 1;
+    bool csv = false;
+    size_t maxCycles = 0;
+    unsigned quantum = 1;
+    bool coroutines = false;
+    bool pdes = false;
+    unsigned partitions = 1;
+    bool parallel = false;
+    unsigned workers = 0;
+    for (int i = 1; i < argc; ++i) {
+      if (std::strcmp(argv[i], "--topology") == 0) {
+        topologies = {hexbench::parseTopology(argv[++i])};
+      } else if (std::strcmp(argv[i], "--procs") == 0) {
+        procCounts = parseProcs(argv[++i]);
+      } else if (std::strcmp(argv[i], "--messages") == 0) {
+        messages = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--compute") == 0) {
+        compute = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--emit") == 0) {
+        emitDir = argv[++i];
+      } else if (std::strcmp(argv[i], "--compress") == 0) {
+        compress = true;
+      } else if (std::strcmp(argv[i], "--repeat") == 0) {
+        repeat = std::max(1UL, std::stoul(argv[++i]));
+      } else if (std::strcmp(argv[i], "--csv") == 0) {
+        csv = true;
+      } else if (std::strcmp(argv[i], "--max-cycles") == 0) {
+        maxCycles = std::stoull(argv[++i]);
+      } else if (std::strcmp(argv[i], "--quantum") == 0) {
+        quantum = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--coroutines") == 0) {
+        coroutines = true;
+      } else if (std::strcmp(argv[i], "--pdes") == 0) {
+        pdes = true;
+      } else if (std::strcmp(argv[i], "--partitions") == 0) {
+        partitions = std::stoul(argv[++i]);
+        pdes = true;
+      } else if (std::strcmp(argv[i], "--parallel") == 0) {
+        parallel = true;
+      } else if (std::strcmp(argv[i], "--workers") == 0) {
+        workers = std::stoul(argv[++i]);
+        parallel = parallel || !pdes;
+      } else if (std::strcmp(argv[i], "-h") == 0 ||
+                 std::strcmp(argv[i], "--help") == 0) {
+        help(argv);
+        return 1;
+      } else {
+        throw std::runtime_error(std::string("unrecognised argument: ") +
+                                 argv[i]);
+      }
+    }
+    if (pdes) {
+      parallel = false;
+    }
+    auto dir = emitDir ? std::filesystem::path(emitDir)
+                       : std::filesystem::temp_directory_path();
+    if (emitDir) {
+      std::filesystem::create_directories(dir);
+    }
+    if (!emitDir) {
+      std::cout << (csv ? "topology,procs,bytes,load,instructions,time,"
+                          "seconds,mips\n"
+                        : fmt::format("{:<9} {:>6} {:>8} {:>10} {:>14} {:>12} "
+                                      "{:>10} {:>10}\n",
+                                      "topology", "procs", "bytes", "load",
+                                      "instructions", pdes ? "cycles" : "ticks",
+                                      "seconds", "MIPS"));
+    }
+    for (auto topology : topologies) {
+      for (auto procs : procCounts) {
+        hexbench::Params params{topology, procs, messages, compute};
+        auto name = fmt::format("{}-{}", hexbench::topologyName(topology),
+                                procs);
+        auto binary = (dir / (emitDir ? name + ".bin"
+                                      : fmt::format("hexbench-{}.bin",
+                                                    getpid())))
+                          .string();
+        auto source = hexbench::generate(params);
+        if (emitDir) {
+          std::ofstream x(dir / (name + ".x"));
+          x << source;
+        }
+        std::ostringstream messagesOut;
+        xcmp::Driver driver(messagesOut);
+        driver.setCompress(compress);
+        if (driver.runCatchExceptions(xcmp::DriverAction::EMIT_BINARY, source,
+                                      false, binary) != 0) {
+          throw std::runtime_error(fmt::format("could not compile {}:\n{}",
+                                               name, messagesOut.str()));
+        }
+        if (emitDir) {
+          std::cout << fmt::format("wrote {0}.x and {0}.bin\n",
+                                   (dir / name).string());
+          continue;
+        }
+        // Time the best of the loads and runs, checking each run prints its
+        // checksum.
+        auto bytes = std::filesystem::file_size(binary);
+        double loadSeconds = std::numeric_limits<double>::max();
+        double seconds = std::numeric_limits<double>::max();
+        uint64_t instructions = 0;
+        std::string time = "-";
+        for (unsigned r = 0; r < repeat; r++) {
+          std::istringstream in;
+          std::ostringstream out;
+          hexsim::System system(in, out, maxCycles);
+          system.setParallel(parallel);
+          system.setWorkers(workers);
+          system.setQuantum(quantum);
+          system.setCoroutines(coroutines);
+          system.setPdes(pdes);
+          system.setPartitions(partitions);
+          auto loadStart = std::chrono::steady_clock::now();
+          system.loadNetwork(binary.c_str());
+          auto start = std::chrono::steady_clock::now();
+          system.run();
+          std::chrono::duration<double> loadElapsed = start - loadStart;
+          std::chrono::duration<double> elapsed =
+              std::chrono::steady_clock::now() - start;
+          if (out.str() != hexbench::expectedOutput(params)) {
+            throw std::runtime_error(
+                fmt::format("{} printed '{}', expected '{}'", name, out.str(),
+                            hexbench::expectedOutput(params)));
+          }
+          loadSeconds = std::min(loadSeconds, loadElapsed.count());
+          seconds = std::min(seconds, elapsed.count());
+          instructions = system.getInstructions();
+          // A parallel run has no simulated time.
+          if (pdes) {
+            time = std::to_string(system.getPdesStats().time);
+          } else if (!parallel) {
+            time = std::to_string(system.getScheduleStats().ticks);
+          }
+        }
+        std::filesystem::remove(binary);
+        double mips = instructions / seconds / 1e6;
+        std::cout << (csv ? fmt::format("{},{},{},{:.6f},{},{},{:.6f},{:.3f}\n",
+                                        hexbench::topologyName(topology),
+                                        procs, bytes, loadSeconds,
+                                        instructions, time, seconds, mips)
+                          : fmt::format("{:<9} {:>6} {:>8} {:>10.6f} {:>14} "
+                                        "{:>12} {:>10.4f} {:>10.2f}\n",
+                                        hexbench::topologyName(topology),
+                                        procs, bytes, loadSeconds,
+                                        instructions, time, seconds, mips));
+        std::cout.flush();
+      }
+    }
+    return 0;
+  } catch (std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
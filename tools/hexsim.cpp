@@ -2,7 +2,13 @@
 #include <cstdio>
 #include <cstring>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "hexsim.hpp"
 #include "hexsimio.hpp"
@@ -11,6 +17,54 @@
 // Driver
 //===---------------------------------------------------------------------===//
 
+/// A stream buffer that reads from another and records what it reads, so the
+/// input of one run can be replayed to another.
+class RecordingBuffer : public std::streambuf {
+  std::streambuf *source;
+  std::string recorded;
+  char current;
+
+protected:
+  int_type underflow() override {
+    auto c = source->sbumpc();
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return c;
+    }
+    current = traits_type::to_char_type(c);
+    recorded.push_back(current);
+    setg(&current, &current, &current + 1);
+    return c;
+  }
+
+public:
+  RecordingBuffer(std::streambuf *source) : source(source) {}
+  const std::string &getRecorded() const { return recorded; }
+};
+
+/// Run a network as a PDES with the processors placed on a topology, on a
+/// copy of its input, and return its simulated cycles (none if it fails).
+static std::optional<uint64_t>
+pdesCycles(const char *filename, const std::string &input,
+           const hexplace::Topology &topology,
+           const std::vector<unsigned> &placement, unsigned linkLatency,
+           unsigned workers, size_t maxCycles) {
+  std::istringstream in(input);
+  std::ostringstream out;
+  hexsim::System system(in, out, maxCycles);
+  system.setPdes(true);
+  system.setLinkLatency(linkLatency);
+  system.setWorkers(workers);
+  system.setTopology(topology);
+  system.setPlacement(placement);
+  system.loadNetwork(filename);
+  try {
+    system.run();
+    return system.getPdesStats().time;
+  } catch (std::exception &) {
+    return std::nullopt;
+  }
+}
+
 static void help(const char *argv[]) {
   std::cout << "Hex processor simulator\n\n";
   std::cout << "Usage: " << argv[0] << " file\n\n";
@@ -22,6 +76,55 @@ static void help(const char *argv[]) {
   std::cout << "  -t,--trace      Enable instruction tracing\n";
   std::cout << "  --max-cycles N  Limit the number of simulation cycles "
                "(default: 0)\n";
+  std::cout << "  --tag-output    Prefix each line of output with the core "
+               "that wrote it\n";
+  std::cout << "  --split-output PREFIX  Write the output of core N to the "
+               "file PREFIXN\n";
+  std::cout << "  --quantum K     Run each processor for up to K instructions "
+               "per tick (default: 1)\n";
+  std::cout << "  --sched-stats   Report the ticks and output timing of a "
+               "run\n";
+  std::cout << "  --channel-stats Report the traffic and blocking of each "
+               "channel and processor\n";
+  std::cout << "  --channel-stats-json FILE  Write the --channel-stats report "
+               "as JSON to FILE\n";
+  std::cout << "  --critical-path Report the critical path through the "
+               "processors\n";
+  std::cout << "  --profile-lines Report the instructions run on each source "
+               "line\n";
+  std::cout << "  --source FILE   Show the lines of source FILE in the "
+               "--profile-lines report\n";
+  std::cout << "  --timeline FILE Write a timeline of the run as Chrome trace "
+               "JSON to FILE\n";
+  std::cout << "  --timeline-interval N  Sample the timeline every N ticks "
+               "(default: 1)\n";
+  std::cout << "  --report-deadlocks  Report deadlocks of some processors as "
+               "they form and\n"
+               "                  keep running the others\n";
+  std::cout << "  --coroutines    Run each processor as a coroutine\n";
+  std::cout << "  --pdes          Simulate timed channels on a pool of "
+               "threads\n";
+  std::cout << "  --link-latency N  Cycles per router hop for --pdes "
+               "(default: 1)\n";
+  std::cout << "  --partitions N  Run --pdes across N worker processes\n";
+  std::cout << "  --buffer-depth N  Give each channel a FIFO of N messages and "
+               "compare\n"
+               "                  with synchronous channels (what-if mode)\n";
+  std::cout << "  --buffer NAME=N Set the FIFO depth of channel NAME\n";
+  std::cout << "  --mesh WxH      Place the processors on a WxH mesh, so "
+               "channel latency\n"
+               "                  follows the hops between them\n";
+  std::cout << "  --torus WxH     Place the processors on a WxH torus\n";
+  std::cout << "  --place FILE    Optimise the placement for the traffic of a "
+               "run and write\n"
+               "                  the container with it to FILE\n";
+  std::cout << "  --place-objective hops|load  Minimise the traffic-weighted "
+               "hops (default)\n"
+               "                  or the traffic over the busiest link\n";
+  std::cout << "  --parallel      Run the processors on a pool of threads\n";
+  std::cout << "  --workers N     Number of threads for --parallel "
+               "(default: one per core)\n";
+  std::cout << "  --worker-stats  Report the utilisation of each thread\n";
 }
 
 int main(int argc, const char *argv[]) {
@@ -29,6 +132,30 @@ int main(int argc, const char *argv[]) {
     const char *filename = nullptr;
     bool dumpBinary = false;
     bool trace = false;
+    bool parallel = false;
+    bool workerStats = false;
+    bool schedStats = false;
+    bool channelStats = false;
+    const char *channelStatsJson = nullptr;
+    bool criticalPath = false;
+    bool profileLines = false;
+    const char *sourceFile = nullptr;
+    bool tagOutput = false;
+    const char *splitOutput = nullptr;
+    const char *timelineFile = nullptr;
+    unsigned timelineInterval = 1;
+    bool reportDeadlocks = false;
+    unsigned bufferDepth = 0;
+    std::map<std::string, unsigned> bufferDepths;
+    hexplace::Topology topology;
+    const char *placeFile = nullptr;
+    auto objective = hexplace::Objective::HOPS;
+    bool coroutines = false;
+    bool pdes = false;
+    unsigned linkLatency = 1;
+    unsigned partitions = 1;
+    unsigned quantum = 1;
+    unsigned workers = 0;
     size_t maxCycles = 0;
     for (int i = 1; i < argc; ++i) {
       if (std::strcmp(argv[i], "-d") == 0 ||
@@ -39,6 +166,70 @@ int main(int argc, const char *argv[]) {
         trace = true;
       } else if (std::strcmp(argv[i], "--max-cycles") == 0) {
         maxCycles = std::stoull(argv[++i]);
+      } else if (std::strcmp(argv[i], "--tag-output") == 0) {
+        tagOutput = true;
+      } else if (std::strcmp(argv[i], "--split-output") == 0) {
+        splitOutput = argv[++i];
+      } else if (std::strcmp(argv[i], "--quantum") == 0) {
+        quantum = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--sched-stats") == 0) {
+        schedStats = true;
+      } else if (std::strcmp(argv[i], "--channel-stats") == 0) {
+        channelStats = true;
+      } else if (std::strcmp(argv[i], "--channel-stats-json") == 0) {
+        channelStatsJson = argv[++i];
+      } else if (std::strcmp(argv[i], "--critical-path") == 0) {
+        criticalPath = true;
+      } else if (std::strcmp(argv[i], "--profile-lines") == 0) {
+        profileLines = true;
+      } else if (std::strcmp(argv[i], "--source") == 0) {
+        sourceFile = argv[++i];
+      } else if (std::strcmp(argv[i], "--timeline") == 0) {
+        timelineFile = argv[++i];
+      } else if (std::strcmp(argv[i], "--timeline-interval") == 0) {
+        timelineInterval = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--report-deadlocks") == 0) {
+        reportDeadlocks = true;
+      } else if (std::strcmp(argv[i], "--coroutines") == 0) {
+        coroutines = true;
+      } else if (std::strcmp(argv[i], "--pdes") == 0) {
+        pdes = true;
+      } else if (std::strcmp(argv[i], "--link-latency") == 0) {
+        linkLatency = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--partitions") == 0) {
+        partitions = std::stoul(argv[++i]);
+        pdes = true;
+      } else if (std::strcmp(argv[i], "--buffer-depth") == 0) {
+        bufferDepth = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--buffer") == 0) {
+        std::string spec(argv[++i]);
+        auto eq = spec.find('=');
+        if (eq == std::string::npos) {
+          throw std::runtime_error("--buffer expects NAME=N: " + spec);
+        }
+        bufferDepths[spec.substr(0, eq)] = std::stoul(spec.substr(eq + 1));
+      } else if (std::strcmp(argv[i], "--mesh") == 0 ||
+                 std::strcmp(argv[i], "--torus") == 0) {
+        bool torus = std::strcmp(argv[i], "--torus") == 0;
+        topology = hexplace::Topology::parse(argv[++i], torus);
+      } else if (std::strcmp(argv[i], "--place") == 0) {
+        placeFile = argv[++i];
+      } else if (std::strcmp(argv[i], "--place-objective") == 0) {
+        std::string name(argv[++i]);
+        if (name == "hops") {
+          objective = hexplace::Objective::HOPS;
+        } else if (name == "load") {
+          objective = hexplace::Objective::LINK_LOAD;
+        } else {
+          throw std::runtime_error("unknown placement objective: " + name);
+        }
+      } else if (std::strcmp(argv[i], "--parallel") == 0) {
+        parallel = true;
+      } else if (std::strcmp(argv[i], "--workers") == 0) {
+        parallel = true;
+        workers = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--worker-stats") == 0) {
+        workerStats = true;
       } else if (std::strcmp(argv[i], "-h") == 0 ||
                  std::strcmp(argv[i], "--help") == 0) {
         help(argv);
@@ -62,10 +253,153 @@ int main(int argc, const char *argv[]) {
       p.load(filename, true);
       return 0;
     }
-    hexsim::System system(std::cin, std::cout, maxCycles);
+    // In the buffered what-if mode and when placing, record the input to
+    // replay it to the runs that follow.
+    bool buffered = bufferDepth > 0 || !bufferDepths.empty();
+    RecordingBuffer recording(std::cin.rdbuf());
+    std::istream recordedIn(&recording);
+    hexsim::System system(buffered || placeFile ? recordedIn : std::cin,
+                          std::cout, maxCycles);
     system.setTracing(trace);
+    if (tagOutput) {
+      system.setTaggedOutput();
+    }
+    if (splitOutput) {
+      system.setSplitOutput(splitOutput);
+    }
+    system.setParallel(parallel);
+    system.setWorkers(workers);
+    system.setQuantum(quantum);
+    system.setCoroutines(coroutines);
+    system.setPdes(pdes);
+    system.setPartitions(partitions);
+    system.setLinkLatency(linkLatency);
+    system.setNetworkStats(channelStats || channelStatsJson || placeFile);
+    system.setCriticalPath(criticalPath);
+    system.setLineProfile(profileLines);
+    system.setTimeline(timelineFile != nullptr, timelineInterval);
+    if (reportDeadlocks) {
+      system.setDeadlockHook(
+          [](const std::string &msg) { std::cerr << msg << "\n"; });
+    }
+    system.setChannelDepth(bufferDepth);
+    for (auto &[name, depth] : bufferDepths) {
+      system.setChannelDepth(name, depth);
+    }
+    if (!topology.empty()) {
+      system.setTopology(topology);
+    }
     system.loadNetwork(filename);
-    return system.run();
+    // Write the timeline at exit, including that of a run stopped by an
+    // error or a deadlock.
+    auto writeTimeline = [&] {
+      std::ofstream json(timelineFile);
+      if (!json) {
+        throw std::runtime_error(std::string("could not open file: ") +
+                                 timelineFile);
+      }
+      system.writeTimeline(json);
+    };
+    int exitCode = 0;
+    try {
+      exitCode = system.run();
+    } catch (std::exception &) {
+      if (timelineFile) {
+        writeTimeline();
+      }
+      throw;
+    }
+    if (timelineFile) {
+      writeTimeline();
+    }
+    if (schedStats && pdes) {
+      hexsim::printPdesStats(std::cerr, system.getPdesStats());
+    } else if (schedStats && !parallel) {
+      hexsim::printScheduleStats(std::cerr, system.getScheduleStats());
+    }
+    if (workerStats) {
+      hexsim::printWorkerStats(std::cerr, system.getWorkerStats());
+    }
+    if (channelStats) {
+      hexsim::printNetworkStats(std::cerr, system.getNetworkStats());
+    }
+    if (channelStatsJson) {
+      std::ofstream json(channelStatsJson);
+      if (!json) {
+        throw std::runtime_error(std::string("could not open file: ") +
+                                 channelStatsJson);
+      }
+      hexsim::writeNetworkStatsJson(json, system.getNetworkStats());
+    }
+    if (criticalPath) {
+      hexsim::printCriticalPath(std::cerr, system.getCriticalPath());
+    }
+    if (profileLines) {
+      std::vector<std::string> source;
+      if (sourceFile) {
+        std::ifstream file(sourceFile);
+        if (!file) {
+          throw std::runtime_error(std::string("could not open file: ") +
+                                   sourceFile);
+        }
+        for (std::string line; std::getline(file, line);) {
+          source.push_back(line);
+        }
+      }
+      hexsim::printLineProfile(std::cerr, system.getLineProfile(), source);
+    }
+    if (buffered) {
+      std::istringstream baselineIn(recording.getRecorded());
+      std::ostringstream baselineOut;
+      hexsim::System baseline(baselineIn, baselineOut, maxCycles);
+      baseline.setQuantum(quantum);
+      baseline.setCoroutines(coroutines);
+      baseline.loadNetwork(filename);
+      std::optional<uint64_t> baselineTicks;
+      try {
+        baseline.run();
+        baselineTicks = baseline.getScheduleStats().ticks;
+      } catch (std::exception &) {
+        // A network that deadlocks with synchronous channels may not with
+        // buffered ones.
+      }
+      hexsim::printBufferReport(std::cerr, baselineTicks,
+                                system.getScheduleStats().ticks,
+                                system.getChannelBuffers());
+    }
+    if (placeFile) {
+      // Place the processors for the traffic of the run, compare the
+      // simulated cycles of the initial and optimised placements, and write
+      // the container with the optimised one.
+      auto &t = system.getTopology();
+      if (t.empty()) {
+        throw std::runtime_error("--place needs a --mesh or --torus");
+      }
+      auto initial = system.getPlacement();
+      auto flows =
+          system.getFlows(objective == hexplace::Objective::LINK_LOAD);
+      auto best = hexplace::optimise(t, initial.size(), flows, objective);
+      std::cerr << fmt::format(
+          "placement on a {}x{} {}, minimising {}:\n", t.width, t.height,
+          t.torus ? "torus" : "mesh",
+          objective == hexplace::Objective::HOPS ? "traffic-weighted hops"
+                                                 : "the busiest link's load");
+      for (auto *placement : {&initial, &best}) {
+        auto cycles = pdesCycles(filename, recording.getRecorded(), t,
+                                 *placement, linkLatency, workers, maxCycles);
+        std::cerr << fmt::format(
+            "{}: cost {}, {}\n",
+            placement == &initial ? "initial" : "optimised",
+            hexplace::cost(t, *placement, flows, objective),
+            cycles ? fmt::format("{} cycles", *cycles) : "did not complete");
+      }
+      hexplace::printPlacement(std::cerr, t, best);
+      auto container = hexcontainer::read(filename);
+      container.placement = {t.width, t.height, t.torus,
+                             std::vector<uint32_t>(best.begin(), best.end())};
+      hexcontainer::write(placeFile, container);
+    }
+    return exitCode;
   } catch (std::exception &e) {
     std::cerr << "Error: " << e.what() << "\n";
     return 1;
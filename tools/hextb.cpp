@@ -26,6 +26,9 @@ static_assert(NUM_CORES == 4,
               "coreOf() enumerates exactly 4 cores by their generate-loop "
               "names; extend it if NUM_CORES changes.");
 
+// Must match hex_pkg::MEM_DEPTH, the words of each core's memory.
+constexpr size_t MEM_DEPTH = size_t(1) << 19;
+
 // A two-instruction loop (NFIX F; BR E) that spins in place forever (BR E adds
 // -2, returning to the NFIX) without any syscall or channel op, keeping cores
 // with no image quiescent.
@@ -48,11 +51,16 @@ static IData *memOf(const std::unique_ptr<Vntb> &top, unsigned k) {
   return coreOf(top, k)->u_memory->memory_q.data();
 }
 
+static size_t memSizeOf(const std::unique_ptr<Vntb> &top, unsigned k) {
+  return coreOf(top, k)->u_memory->memory_q.size();
+}
+
 // Service one core's syscall, reading arguments from its own memory.
 static void handleSyscall(unsigned k, hex::Syscall syscall,
                           const std::unique_ptr<Vntb> &top, int &exitValue,
                           bool &exited) {
   IData *mem = memOf(top, k);
+  size_t size = memSizeOf(top, k);
   unsigned sp = mem[1];
   switch (syscall) {
   case hex::Syscall::EXIT:
@@ -65,21 +73,56 @@ static void handleSyscall(unsigned k, hex::Syscall syscall,
   case hex::Syscall::READ:
     mem[sp + 1] = io.input(mem[sp + 2]) & 0xFF;
     break;
+  case hex::Syscall::WRITES:
+    io.outputString(mem, size, mem[sp + 2], static_cast<int>(mem[sp + 3]));
+    break;
+  case hex::Syscall::READS:
+    mem[sp + 1] = io.inputString(mem, size, mem[sp + 2], mem[sp + 3],
+                                 static_cast<int>(mem[sp + 4]));
+    break;
+  case hex::Syscall::WRITEN:
+    io.outputWords(mem, size, mem[sp + 2], mem[sp + 3],
+                   static_cast<int>(mem[sp + 4]));
+    break;
+  case hex::Syscall::READN:
+    mem[sp + 1] = io.inputWords(mem, size, mem[sp + 2], mem[sp + 3],
+                                static_cast<int>(mem[sp + 4]));
+    break;
   default:
     throw std::runtime_error("invalid syscall");
   }
 }
 
-// Read the container, fill every core with the halt loop, and load the images
-// into the active cores. Returns the parsed container (its edges are used to
-// program the route tables).
-static hexcontainer::Container load(const char *filename,
-                                    const std::unique_ptr<Vntb> &top) {
-  auto container = hexcontainer::read(filename);
-  unsigned numActive = container.images.size();
+// Return the core each processor of a container runs on: its node in the
+// container's placement, if it has one, or otherwise its own index. The
+// network is a crossbar, so a placement only chooses the cores.
+static std::vector<unsigned>
+coresOf(const hexcontainer::MappedContainer &container) {
+  unsigned numActive = container.numProcessors();
   if (numActive > NUM_CORES) {
     throw std::runtime_error("container has more processors than NUM_CORES");
   }
+  std::vector<unsigned> cores(numActive);
+  std::vector<bool> used(NUM_CORES, false);
+  for (unsigned i = 0; i < numActive; i++) {
+    cores[i] = container.placement.width > 0 ? container.placement.nodes[i] : i;
+    if (cores[i] >= NUM_CORES || used[cores[i]]) {
+      throw std::runtime_error(
+          fmt::format("cannot place processor {} on core {}", i, cores[i]));
+    }
+    used[cores[i]] = true;
+  }
+  return cores;
+}
+
+// Map the container, fill every core with the halt loop, and load the images
+// into the active cores. Returns the mapped container (its edges are used to
+// program the route tables).
+static hexcontainer::MappedContainer load(const char *filename,
+                                          const std::unique_ptr<Vntb> &top) {
+  auto container = hexcontainer::map(filename);
+  unsigned numActive = container.numProcessors();
+  auto cores = coresOf(container);
 
   // Quiescent default for every core.
   for (unsigned k = 0; k < NUM_CORES; k++) {
@@ -88,10 +131,9 @@ static hexcontainer::Container load(const char *filename,
 
   // Load each image's code into its core's memory.
   for (unsigned i = 0; i < numActive; i++) {
-    auto &image = container.images[i];
-    uint32_t programSizeWords;
-    std::memcpy(&programSizeWords, image.data(), 4);
-    std::memcpy(memOf(top, i), image.data() + 4, programSizeWords << 2);
+    const auto &image = container.imageOfProcessor(i);
+    auto *memory = reinterpret_cast<char *>(memOf(top, cores[i]));
+    hexcontainer::loadCode(image, memory, MEM_DEPTH * 4);
   }
   std::cout << fmt::format("Loaded {} processor image(s)\n", numActive);
   return container;
@@ -121,7 +163,8 @@ int run(const std::unique_ptr<VerilatedContext> &ctx,
   top->eval();
 
   auto container = load(filename, top);
-  unsigned numActive = container.images.size();
+  unsigned numActive = container.numProcessors();
+  auto cores = coresOf(container);
 
   // Hold reset for a few cycles, then program the routing tables (config writes
   // are independent of reset).
@@ -130,8 +173,8 @@ int run(const std::unique_ptr<VerilatedContext> &ctx,
     ctx->timeInc(1); top->i_clk = 1; top->eval();
   }
   for (auto &e : container.edges) {
-    writeRoute(ctx, top, e.procA, e.slotA, e.procB, e.slotB);
-    writeRoute(ctx, top, e.procB, e.slotB, e.procA, e.slotA);
+    writeRoute(ctx, top, cores[e.procA], e.slotA, cores[e.procB], e.slotB);
+    writeRoute(ctx, top, cores[e.procB], e.slotB, cores[e.procA], e.slotA);
   }
   top->i_rst = 0;
 
@@ -159,11 +202,12 @@ int run(const std::unique_ptr<VerilatedContext> &ctx,
         continue;
       }
       // Syscalls.
-      if ((top->o_syscall_valid >> k) & 1) {
+      unsigned core = cores[k];
+      if ((top->o_syscall_valid >> core) & 1) {
         bool justExited = false;
         int exitValue = 0;
-        handleSyscall(k, static_cast<hex::Syscall>(top->o_syscall[k]), top,
-                      exitValue, justExited);
+        handleSyscall(core, static_cast<hex::Syscall>(top->o_syscall[core]),
+                      top, exitValue, justExited);
         progressed = true;
         if (justExited) {
           exited[k] = true;
@@ -174,14 +218,21 @@ int run(const std::unique_ptr<VerilatedContext> &ctx,
           }
         }
       }
+      // An undefined SPI access, which the simulator rejects.
+      if (coreOf(top, core)->u_processor->spi_invalid) {
+        top->final();
+        throw std::runtime_error(
+            fmt::format("core {}: invalid SPI at pc {}", core,
+                        coreOf(top, core)->u_processor->pc_q));
+      }
       // Progress detection for deadlock.
-      unsigned pc = coreOf(top, k)->u_processor->pc_q;
+      unsigned pc = coreOf(top, core)->u_processor->pc_q;
       if (pc != prevPc[k]) {
         progressed = true;
       }
       prevPc[k] = pc;
       if (trace) {
-        std::cout << fmt::format("[{:6}] core{} pc={}\n", cycles, k, pc);
+        std::cout << fmt::format("[{:6}] core{} pc={}\n", cycles, core, pc);
       }
     }
 
@@ -190,7 +241,7 @@ int run(const std::unique_ptr<VerilatedContext> &ctx,
       std::string msg = "deadlock: cores blocked:";
       for (unsigned k = 0; k < numActive; k++) {
         if (!exited[k]) {
-          msg += fmt::format(" {}", k);
+          msg += fmt::format(" {}", cores[k]);
         }
       }
       top->final();
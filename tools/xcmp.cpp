@@ -34,6 +34,10 @@ static void help(const char *argv[]) {
   std::cout << "  --insts-optimised Display the lowered optimised instructions "
                "only\n";
   std::cout << "  --memory-info     Report memory information\n";
+  std::cout << "  --ext-opr         Use the extended OPR instructions\n";
+  std::cout
+      << "  --ext-spi         Use the SP-indexed load/store instructions\n";
+  std::cout << "  --compress        Compress the code of a network container\n";
   std::cout << "  -S                Emit the assembly program\n";
   std::cout << "  --insts-asm       Display the assembled instructions only\n";
   std::cout
@@ -72,6 +76,12 @@ int main(int argc, const char *argv[]) {
         driverAction = xcmp::DriverAction::EMIT_ASM;
       } else if (std::strcmp(argv[i], "--memory-info") == 0) {
         reportMemoryInfo = true;
+      } else if (std::strcmp(argv[i], "--ext-opr") == 0) {
+        driver.setExtendedOprs(true);
+      } else if (std::strcmp(argv[i], "--ext-spi") == 0) {
+        driver.setSpIndexed(true);
+      } else if (std::strcmp(argv[i], "--compress") == 0) {
+        driver.setCompress(true);
       } else if (std::strcmp(argv[i], "--output") == 0 ||
                  std::strcmp(argv[i], "-o") == 0) {
         if (++i >= argc) {
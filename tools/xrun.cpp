@@ -1,4 +1,5 @@
 #include <fmt/format.h>
+#include <fstream>
 #include <iostream>
 
 #include "hexasm.hpp"
@@ -20,11 +21,43 @@ static void help(char *argv[]) {
   std::cout << "  -t,--trace      Enable instruction tracing\n";
   std::cout << "  --max-cycles N  Limit the number of simulation cycles "
                "(default: 0)\n";
+  std::cout << "  --ext-opr       Use the extended OPR instructions\n";
+  std::cout << "  --ext-spi       Use the SP-indexed load/store instructions\n";
+  std::cout << "  --quantum K     Run each processor for up to K instructions "
+               "per tick (default: 1)\n";
+  std::cout << "  --sched-stats   Report the ticks and output timing of a "
+               "run\n";
+  std::cout << "  --channel-stats Report the traffic and blocking of each "
+               "channel and processor\n";
+  std::cout << "  --channel-stats-json FILE  Write the --channel-stats report "
+               "as JSON to FILE\n";
+  std::cout << "  --critical-path Report the critical path through the "
+               "processors\n";
+  std::cout << "  --coroutines    Run each processor as a coroutine\n";
+  std::cout << "  --pdes          Simulate timed channels on a pool of "
+               "threads\n";
+  std::cout << "  --link-latency N  Cycles per router hop for --pdes "
+               "(default: 1)\n";
+  std::cout << "  --parallel      Run the processors on a pool of threads\n";
+  std::cout << "  --workers N     Number of threads for --parallel "
+               "(default: one per core)\n";
+  std::cout << "  --worker-stats  Report the utilisation of each thread\n";
 }
 
 int main(int argc, char *argv[]) {
   char *inputFilename = nullptr;
   bool trace = false;
+  bool parallel = false;
+  bool workerStats = false;
+  bool schedStats = false;
+  bool channelStats = false;
+  const char *channelStatsJson = nullptr;
+  bool criticalPath = false;
+  bool coroutines = false;
+  bool pdes = false;
+  unsigned linkLatency = 1;
+  unsigned quantum = 1;
+  unsigned workers = 0;
   size_t maxCycles = 0;
   xcmp::Driver driver(std::cout);
   try {
@@ -38,6 +71,33 @@ int main(int argc, char *argv[]) {
         trace = true;
       } else if (std::strcmp(argv[i], "--max-cycles") == 0) {
         maxCycles = std::stoull(argv[++i]);
+      } else if (std::strcmp(argv[i], "--ext-opr") == 0) {
+        driver.setExtendedOprs(true);
+      } else if (std::strcmp(argv[i], "--ext-spi") == 0) {
+        driver.setSpIndexed(true);
+      } else if (std::strcmp(argv[i], "--quantum") == 0) {
+        quantum = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--sched-stats") == 0) {
+        schedStats = true;
+      } else if (std::strcmp(argv[i], "--channel-stats") == 0) {
+        channelStats = true;
+      } else if (std::strcmp(argv[i], "--channel-stats-json") == 0) {
+        channelStatsJson = argv[++i];
+      } else if (std::strcmp(argv[i], "--critical-path") == 0) {
+        criticalPath = true;
+      } else if (std::strcmp(argv[i], "--coroutines") == 0) {
+        coroutines = true;
+      } else if (std::strcmp(argv[i], "--pdes") == 0) {
+        pdes = true;
+      } else if (std::strcmp(argv[i], "--link-latency") == 0) {
+        linkLatency = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--parallel") == 0) {
+        parallel = true;
+      } else if (std::strcmp(argv[i], "--workers") == 0) {
+        parallel = true;
+        workers = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--worker-stats") == 0) {
+        workerStats = true;
       } else if (argv[i][0] == '-') {
         throw std::runtime_error(std::string("unrecognised argument: ") +
                                  argv[i]);
@@ -53,8 +113,39 @@ int main(int argc, char *argv[]) {
                                   inputFilename, true, "a.bin", false) == 0) {
       hexsim::System system(std::cin, std::cout, maxCycles);
       system.setTracing(trace);
+      system.setParallel(parallel);
+      system.setWorkers(workers);
+      system.setQuantum(quantum);
+      system.setCoroutines(coroutines);
+      system.setPdes(pdes);
+      system.setLinkLatency(linkLatency);
+      system.setNetworkStats(channelStats || channelStatsJson);
+      system.setCriticalPath(criticalPath);
       system.loadNetwork("a.bin");
-      return system.run();
+      auto exitCode = system.run();
+      if (schedStats && pdes) {
+        hexsim::printPdesStats(std::cerr, system.getPdesStats());
+      } else if (schedStats && !parallel) {
+        hexsim::printScheduleStats(std::cerr, system.getScheduleStats());
+      }
+      if (workerStats) {
+        hexsim::printWorkerStats(std::cerr, system.getWorkerStats());
+      }
+      if (channelStats) {
+        hexsim::printNetworkStats(std::cerr, system.getNetworkStats());
+      }
+      if (channelStatsJson) {
+        std::ofstream json(channelStatsJson);
+        if (!json) {
+          throw std::runtime_error(std::string("could not open file: ") +
+                                   channelStatsJson);
+        }
+        hexsim::writeNetworkStatsJson(json, system.getNetworkStats());
+      }
+      if (criticalPath) {
+        hexsim::printCriticalPath(std::cerr, system.getCriticalPath());
+      }
+      return exitCode;
     }
   } catch (const std::exception &e) {
     std::cerr << fmt::format("Error: {}\n", e.what());